@@ -0,0 +1,373 @@
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "batch.h"
+#include "rt.h"
+#include "ppmrw.h"
+
+// Budget for texture pixmaps shared between jobs.
+#define BATCH_TEXTURE_CACHE_MB 512
+
+typedef struct {
+
+    char *scene_file;
+    int width;
+    int height;
+    char *output_file;
+
+} batch_job;
+
+typedef struct {
+
+    batch_job *jobs;
+    int num_jobs;
+    atomic_int next_job;
+
+    rt_texture_cache *textures;
+
+    // Serializes the per-job report lines.
+    pthread_mutex_t report_lock;
+    int num_failed;
+
+} batch_run;
+
+typedef struct {
+
+    batch_run *run;
+    int worker_index;
+
+    // Kept across jobs: the context, a pixmap sized for the largest job so
+    // far, and the last scene in case the next job renders it again.
+    rt_context *context;
+    uint8_t *pixmap;
+    size_t pixmap_capacity;
+    rt_scene *last_scene;
+    char *last_scene_file;
+
+} batch_worker;
+
+
+// Reads the jobs in manifest_file into run. Returns false if the file can't
+// be read or a line is malformed.
+bool read_manifest(const char *manifest_file, batch_run *run){
+
+    FILE *fp = fopen(manifest_file, "r");
+
+    if(fp == NULL){
+
+        printf("Error: Could not open the manifest %s.\n", manifest_file);
+
+        return false;
+    }
+
+    int capacity = 0;
+    int line_number = 0;
+    char line[8192];
+
+    while(fgets(line, sizeof(line), fp) != NULL){
+
+        line_number++;
+
+        char scene_file[4096];
+        char output_file[4096];
+        batch_job new_job;
+        char first;
+
+        // Skip blank lines and comments.
+        if(sscanf(line, " %c", &first) != 1 || first == '#'){
+
+            continue;
+        }
+
+        if(sscanf(line, "%4095s %d %d %4095s", scene_file, &new_job.width, &new_job.height,
+                  output_file) != 4 || new_job.width <= 0 || new_job.height <= 0){
+
+            printf("Error: Line %d of the manifest should be SCENE WIDTH HEIGHT OUTPUT.\n", line_number);
+            fclose(fp);
+
+            return false;
+        }
+
+        if(run->num_jobs == capacity){
+
+            capacity = capacity == 0 ? 64 : capacity * 2;
+
+            batch_job *jobs = realloc(run->jobs, sizeof(batch_job) * capacity);
+
+            if(jobs == NULL){
+
+                printf("Error: Memory allocation for the manifest has failed!\n");
+                fclose(fp);
+
+                return false;
+            }
+
+            run->jobs = jobs;
+        }
+
+        new_job.scene_file = strdup(scene_file);
+        new_job.output_file = strdup(output_file);
+
+        run->jobs[run->num_jobs] = new_job;
+        run->num_jobs++;
+
+        if(new_job.scene_file == NULL || new_job.output_file == NULL){
+
+            printf("Error: Memory allocation for the manifest has failed!\n");
+            fclose(fp);
+
+            return false;
+        }
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+// Runs one job on worker. Returns its status and fills in the phase times;
+// error holds the message when the status isn't RT_OK.
+rt_status run_job(batch_worker *worker, batch_job *job, phase_times *times, rt_error *error){
+
+    double phase_start = stats_now_ms();
+
+    if(worker->last_scene_file == NULL || strcmp(worker->last_scene_file, job->scene_file) != 0){
+
+        rt_scene_free(worker->last_scene);
+        free(worker->last_scene_file);
+
+        worker->last_scene = NULL;
+        worker->last_scene_file = NULL;
+
+        // Parallelism comes from running jobs side by side, as for rendering.
+        rt_load_options load_options = {.textures = worker->run->textures, .num_threads = 1};
+
+        rt_status status = rt_scene_load_file(&worker->last_scene, job->scene_file, &load_options, error);
+
+        if(status != RT_OK){
+
+            return status;
+        }
+
+        worker->last_scene_file = strdup(job->scene_file);
+    }
+
+    times->parse_ms = stats_now_ms() - phase_start;
+
+    size_t length = (size_t) job->width * job->height * 3;
+
+    if(length > worker->pixmap_capacity){
+
+        uint8_t *pixmap = realloc(worker->pixmap, length);
+
+        if(pixmap == NULL){
+
+            snprintf(error->message, sizeof(error->message), "Memory allocation for pixmap has failed!");
+
+            return RT_ERROR_NO_MEMORY;
+        }
+
+        worker->pixmap = pixmap;
+        worker->pixmap_capacity = length;
+    }
+
+    rt_render_options options;
+    rt_render_options_init(&options, job->width, job->height);
+
+    // Parallelism comes from running jobs side by side.
+    options.num_threads = 1;
+
+    phase_start = stats_now_ms();
+
+    rt_status status = rt_render(worker->context, worker->last_scene, &options, worker->pixmap);
+
+    if(status != RT_OK){
+
+        snprintf(error->message, sizeof(error->message), "%s", rt_context_error(worker->context));
+
+        return status;
+    }
+
+    times->render_ms = stats_now_ms() - phase_start;
+
+    phase_start = stats_now_ms();
+
+    FILE *outfile = fopen(job->output_file, "w");
+
+    if(outfile == NULL){
+
+        snprintf(error->message, sizeof(error->message), "Could not open the output file.");
+
+        return RT_ERROR_IO;
+    }
+
+    write_p6(outfile, worker->pixmap, job->width, job->height, 255);
+
+    fclose(outfile);
+
+    times->encode_ms = stats_now_ms() - phase_start;
+
+    return RT_OK;
+}
+
+void *batch_worker_main(void *arg){
+
+    batch_worker *worker = arg;
+    batch_run *run = worker->run;
+
+    int job_index = atomic_fetch_add(&run->next_job, 1);
+
+    while(job_index < run->num_jobs){
+
+        batch_job *job = &run->jobs[job_index];
+
+        phase_times times = {0, 0, 0, 0};
+        rt_error error;
+
+        rt_status status = run_job(worker, job, &times, &error);
+
+        pthread_mutex_lock(&run->report_lock);
+
+        if(status == RT_OK){
+
+            render_stats *stats = rt_context_stats(worker->context);
+
+            printf("{\"job\": %d, \"scene\": \"%s\", \"width\": %d, \"height\": %d, \"output\": \"%s\", "
+                   "\"worker\": %d, \"load_ms\": %.3f, \"render_ms\": %.3f, \"encode_ms\": %.3f, "
+                   "\"rays\": %ld}\n", job_index, job->scene_file, job->width, job->height,
+                   job->output_file, worker->worker_index, times.parse_ms, times.render_ms,
+                   times.encode_ms, stats->primary_rays + stats->reflection_rays + stats->shadow_rays);
+
+        } else {
+
+            run->num_failed++;
+
+            // Messages may quote scene entries.
+            for(char *quote = strchr(error.message, '"'); quote != NULL; quote = strchr(quote, '"')){
+
+                *quote = '\'';
+            }
+
+            printf("{\"job\": %d, \"scene\": \"%s\", \"output\": \"%s\", \"worker\": %d, "
+                   "\"error\": \"%s\"}\n", job_index, job->scene_file, job->output_file,
+                   worker->worker_index, error.message);
+        }
+
+        fflush(stdout);
+
+        pthread_mutex_unlock(&run->report_lock);
+
+        job_index = atomic_fetch_add(&run->next_job, 1);
+    }
+
+    return NULL;
+}
+
+int run_batch(const char *manifest_file, int num_workers){
+
+    batch_run run = {0};
+
+    if(!read_manifest(manifest_file, &run)){
+
+        for(int job_index = 0; job_index < run.num_jobs; job_index++){
+
+            free(run.jobs[job_index].scene_file);
+            free(run.jobs[job_index].output_file);
+        }
+
+        free(run.jobs);
+
+        return -1;
+    }
+
+    double batch_start = stats_now_ms();
+
+    atomic_init(&run.next_job, 0);
+    pthread_mutex_init(&run.report_lock, NULL);
+
+    // Textures no job is using are dropped past this.
+    run.textures = rt_texture_cache_create((size_t) BATCH_TEXTURE_CACHE_MB * 1024 * 1024);
+
+    if(num_workers > run.num_jobs){
+
+        num_workers = run.num_jobs > 0 ? run.num_jobs : 1;
+    }
+
+    batch_worker *workers = malloc(sizeof(batch_worker) * num_workers);
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_workers);
+
+    if(workers == NULL || threads == NULL){
+
+        printf("Error: Memory allocation for the batch has failed!\n");
+        exit(1);
+    }
+
+    for(int worker_index = 0; worker_index < num_workers; worker_index++){
+
+        batch_worker *worker = &workers[worker_index];
+
+        memset(worker, 0, sizeof(batch_worker));
+
+        worker->run = &run;
+        worker->worker_index = worker_index;
+        worker->context = rt_context_create();
+
+        if(run.textures == NULL || worker->context == NULL){
+
+            printf("Error: Memory allocation for the batch has failed!\n");
+            exit(1);
+        }
+    }
+
+    // Worker 0 runs on the calling thread. If a thread can't be started the
+    // ones already running pick up its jobs.
+    int num_started = 1;
+
+    while(num_started < num_workers &&
+          pthread_create(&threads[num_started], NULL, batch_worker_main, &workers[num_started]) == 0){
+
+        num_started++;
+    }
+
+    batch_worker_main(&workers[0]);
+
+    for(int worker_index = 1; worker_index < num_started; worker_index++){
+
+        pthread_join(threads[worker_index], NULL);
+    }
+
+    double batch_ms = stats_now_ms() - batch_start;
+
+    rt_texture_cache_stats texture_stats;
+    rt_texture_cache_get_stats(run.textures, &texture_stats);
+
+    printf("{\"jobs\": %d, \"failed\": %d, \"workers\": %d, \"total_ms\": %.3f, \"jobs_per_sec\": %.1f, "
+           "\"texture_hits\": %ld, \"texture_misses\": %ld}\n", run.num_jobs, run.num_failed,
+           num_started, batch_ms, run.num_jobs / (batch_ms / 1e3), texture_stats.hits,
+           texture_stats.misses);
+
+    // Scenes hold borrowed textures, so they go before the cache.
+    for(int worker_index = 0; worker_index < num_workers; worker_index++){
+
+        rt_scene_free(workers[worker_index].last_scene);
+        free(workers[worker_index].last_scene_file);
+        free(workers[worker_index].pixmap);
+        rt_context_free(workers[worker_index].context);
+    }
+
+    free(workers);
+    free(threads);
+
+    rt_texture_cache_free(run.textures);
+    pthread_mutex_destroy(&run.report_lock);
+
+    for(int job_index = 0; job_index < run.num_jobs; job_index++){
+
+        free(run.jobs[job_index].scene_file);
+        free(run.jobs[job_index].output_file);
+    }
+
+    free(run.jobs);
+
+    return run.num_failed;
+}
@@ -0,0 +1,15 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Renders every job in a manifest, one job per line:
+//
+//   SCENE WIDTH HEIGHT OUTPUT.ppm
+//
+// Blank lines and lines starting with # are skipped. Jobs are spread over
+// num_workers threads, each rendering one job at a time, and share their
+// textures. A JSON line with the timing of each job is printed as it
+// finishes, then a summary. Returns the number of jobs that failed, or -1
+// if the manifest could not be read.
+int run_batch(const char *manifest_file, int num_workers);
+
+#endif
@@ -0,0 +1,502 @@
+#include <time.h>
+
+#include "scene.h"
+#include "render.h"
+
+// Microbenchmarks for the intersection, vector math, texture and PPM I/O
+// kernels. Prints one JSON object per line so runs can be diffed or loaded
+// into a spreadsheet to track regressions.
+
+#define BENCH_SAMPLES 15
+#define BENCH_INPUTS 1024
+
+// Consumes benchmark results so the compiler can't drop the work.
+volatile float bench_sink;
+
+typedef struct {
+
+    float rd[BENCH_INPUTS][3];
+    float ro[BENCH_INPUTS][3];
+    float point[BENCH_INPUTS][3];
+
+    object sphere;
+    object plane;
+    texture texture;
+    pattern checker;
+    pattern noise;
+    light_batch lights;
+    shade_surface surface;
+
+    uint8_t *pixmap;
+    int width;
+    int height;
+    FILE *p3_file;
+    FILE *p6_file;
+    FILE *scratch_file;
+
+} bench_state;
+
+typedef void (*bench_body)(bench_state *state, long iterations);
+
+
+// xorshift32 so every run sees the same inputs.
+uint32_t bench_seed = 2463534242u;
+
+float bench_random(float min, float max){
+
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+
+    return min + (max - min) * (bench_seed / 4294967296.0f);
+}
+
+double bench_now_ns(){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Runs body once to warm caches and branch predictors, then times
+// BENCH_SAMPLES runs of the given number of iterations. bytes_per_op is 0 for
+// compute kernels and the payload size for I/O.
+void run_bench(const char *name, bench_body body, bench_state *state, long iterations,
+               double bytes_per_op){
+
+    double samples[BENCH_SAMPLES];
+    double mean = 0;
+    double variance = 0;
+    double best = INFINITY;
+
+    body(state, iterations);
+
+    for(int sample = 0; sample < BENCH_SAMPLES; sample++){
+
+        double start = bench_now_ns();
+        body(state, iterations);
+        samples[sample] = (bench_now_ns() - start) / iterations;
+
+        mean += samples[sample];
+
+        if(samples[sample] < best){
+
+            best = samples[sample];
+        }
+    }
+
+    mean /= BENCH_SAMPLES;
+
+    for(int sample = 0; sample < BENCH_SAMPLES; sample++){
+
+        variance += (samples[sample] - mean) * (samples[sample] - mean);
+    }
+
+    variance /= BENCH_SAMPLES - 1;
+
+    printf("{\"name\": \"%s\", \"iterations\": %ld, \"samples\": %d, \"ns_per_op\": %.3f, "
+           "\"min_ns_per_op\": %.3f, \"stddev_ns\": %.3f, \"ops_per_sec\": %.1f",
+           name, iterations, BENCH_SAMPLES, mean, best, sqrt(variance), 1e9 / mean);
+
+    if(bytes_per_op > 0){
+
+        printf(", \"mb_per_sec\": %.2f", bytes_per_op * 1e3 / mean);
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+
+void bench_sphere_intersection(bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        int input = i & (BENCH_INPUTS - 1);
+
+        sum += sphere_intersection(state->rd[input], state->ro[input], state->sphere.center,
+                                   state->sphere.sphere.radius_squared);
+    }
+
+    bench_sink = sum;
+}
+
+void bench_plane_intersection(bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        int input = i & (BENCH_INPUTS - 1);
+
+        sum += plane_intersection(state->rd[input], state->ro[input], state->plane.center,
+                                  state->plane.plane.normal);
+    }
+
+    bench_sink = sum;
+}
+
+void bench_v3_normalize(bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        float result[3];
+        v3_normalize(result, state->point[i & (BENCH_INPUTS - 1)]);
+
+        sum += result[0];
+    }
+
+    bench_sink = sum;
+}
+
+void bench_v3_dot_product(bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        int input = i & (BENCH_INPUTS - 1);
+
+        sum += v3_dot_product(state->rd[input], state->point[input]);
+    }
+
+    bench_sink = sum;
+}
+
+void bench_v3_cross_product(bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        int input = i & (BENCH_INPUTS - 1);
+
+        float result[3];
+        v3_cross_product(result, state->rd[input], state->point[input]);
+
+        sum += result[1];
+    }
+
+    bench_sink = sum;
+}
+
+void bench_v3_reflect(bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        int input = i & (BENCH_INPUTS - 1);
+
+        float result[3];
+        v3_reflect(result, state->point[input], state->rd[input]);
+
+        sum += result[2];
+    }
+
+    bench_sink = sum;
+}
+
+void bench_texture(bench_state *state, object *hit_object, bool fast_math, long iterations){
+
+    int sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        sum += *texture_texel(&state->texture, hit_object, state->point[i & (BENCH_INPUTS - 1)], NULL,
+                              fast_math);
+    }
+
+    bench_sink = sum;
+}
+
+void bench_texture_sphere(bench_state *state, long iterations){
+
+    bench_texture(state, &state->sphere, false, iterations);
+}
+
+void bench_texture_plane(bench_state *state, long iterations){
+
+    bench_texture(state, &state->plane, false, iterations);
+}
+
+void bench_texture_sphere_fast(bench_state *state, long iterations){
+
+    bench_texture(state, &state->sphere, true, iterations);
+}
+
+void bench_texture_plane_fast(bench_state *state, long iterations){
+
+    bench_texture(state, &state->plane, true, iterations);
+}
+
+void bench_pattern(const pattern *texture_pattern, bench_state *state, long iterations){
+
+    float sum = 0;
+
+    for(long i = 0; i < iterations; i++){
+
+        float color[3];
+        pattern_color(texture_pattern, state->point[i & (BENCH_INPUTS - 1)], color);
+
+        sum += color[0];
+    }
+
+    bench_sink = sum;
+}
+
+void bench_pattern_checker(bench_state *state, long iterations){
+
+    bench_pattern(&state->checker, state, iterations);
+}
+
+void bench_pattern_noise(bench_state *state, long iterations){
+
+    bench_pattern(&state->noise, state, iterations);
+}
+
+// One iteration shades a full batch of SHADE_BATCH lights.
+void bench_shade(bench_state *state, shade_kernel shade, long iterations){
+
+    float I[3] = {0, 0, 0};
+
+    for(long i = 0; i < iterations; i++){
+
+        shade(&state->lights, &state->surface, I);
+    }
+
+    bench_sink = I[0] + I[1] + I[2];
+}
+
+void bench_shade_lights(bench_state *state, long iterations){
+
+    bench_shade(state, shade_lights, iterations);
+}
+
+void bench_shade_lights_selected(bench_state *state, long iterations){
+
+    bench_shade(state, select_shade_kernel(), iterations);
+}
+
+void bench_read_p3(bench_state *state, long iterations){
+
+    char header_num[3];
+    int width;
+    int height;
+    int max_val;
+
+    for(long i = 0; i < iterations; i++){
+
+        rewind(state->p3_file);
+
+        if(read_header(state->p3_file, header_num, &width, &height, &max_val) != NULL ||
+           read_p3(state->p3_file, state->pixmap, width * height * 3) != NULL){
+
+            printf("Error: The P3 benchmark image could not be read back.\n");
+            exit(1);
+        }
+    }
+
+    bench_sink = state->pixmap[0];
+}
+
+void bench_read_p6(bench_state *state, long iterations){
+
+    char header_num[3];
+    int width;
+    int height;
+    int max_val;
+
+    for(long i = 0; i < iterations; i++){
+
+        rewind(state->p6_file);
+
+        if(read_header(state->p6_file, header_num, &width, &height, &max_val) != NULL ||
+           read_p6(state->p6_file, state->pixmap, width * height * 3) != NULL){
+
+            printf("Error: The P6 benchmark image could not be read back.\n");
+            exit(1);
+        }
+    }
+
+    bench_sink = state->pixmap[0];
+}
+
+void bench_write_p3(bench_state *state, long iterations){
+
+    for(long i = 0; i < iterations; i++){
+
+        rewind(state->scratch_file);
+        write_p3(state->scratch_file, state->pixmap, state->width, state->height, 255);
+    }
+
+    fflush(state->scratch_file);
+}
+
+void bench_write_p6(bench_state *state, long iterations){
+
+    for(long i = 0; i < iterations; i++){
+
+        rewind(state->scratch_file);
+        write_p6(state->scratch_file, state->pixmap, state->width, state->height, 255);
+    }
+
+    fflush(state->scratch_file);
+}
+
+
+int main(int argc, char *argv[]){
+
+    bench_state state;
+
+    // Scale every iteration count, e.g. 0.1 for a quick smoke run.
+    double scale = 1;
+
+    if(argc > 1){
+
+        scale = atof(argv[1]);
+    }
+
+    for(int input = 0; input < BENCH_INPUTS; input++){
+
+        for(int i = 0; i < 3; i++){
+
+            state.rd[input][i] = bench_random(-1, 1);
+            state.ro[input][i] = bench_random(-2, 2);
+            state.point[input][i] = bench_random(-4, 4);
+        }
+
+        // Aim the rays roughly down -z like primary rays do.
+        state.rd[input][2] = -1;
+        v3_normalize(state.rd[input], state.rd[input]);
+    }
+
+    state.width = 256;
+    state.height = 256;
+    state.pixmap = malloc(state.width * state.height * 3);
+
+    for(int i = 0; i < state.width * state.height * 3; i++){
+
+        state.pixmap[i] = (uint8_t) bench_random(0, 255);
+    }
+
+    object objects[2];
+
+    objects[0].type = Sphere;
+    objects[0].center[0] = 0;
+    objects[0].center[1] = 0;
+    objects[0].center[2] = -5;
+    objects[0].sphere.radius = 2;
+
+    objects[1].type = Plane;
+    objects[1].center[0] = 0;
+    objects[1].center[1] = -1;
+    objects[1].center[2] = 0;
+    objects[1].plane.normal[0] = 0;
+    objects[1].plane.normal[1] = 1;
+    objects[1].plane.normal[2] = 0;
+
+    state.texture.width = state.width;
+    state.texture.height = state.height;
+    state.texture.pixmap = state.pixmap;
+    state.texture.procedural.kind = NoPattern;
+
+    parse_pattern("checker", "0.5", &state.checker, NULL);
+    parse_pattern("noise", "0.5", &state.noise, NULL);
+
+    scene bench_scene = {0};
+
+    bench_scene.object_list = objects;
+    bench_scene.num_objects = 2;
+    bench_scene.texture_list = &state.texture;
+    bench_scene.num_textures = 1;
+
+    bake_scene(&bench_scene);
+
+    state.sphere = objects[0];
+    state.plane = objects[1];
+
+    // Lights around a point on the sphere, shaded with the default
+    // shininess.
+    state.lights.count = SHADE_BATCH;
+
+    for(int lane = 0; lane < SHADE_BATCH; lane++){
+
+        float direction[3] = {bench_random(-1, 1), bench_random(-1, 1), bench_random(-1, 1)};
+        v3_normalize(direction, direction);
+
+        for(int axis = 0; axis < 3; axis++){
+
+            state.lights.direction[axis][lane] = direction[axis];
+            state.lights.color[axis][lane] = bench_random(0, 1);
+            state.lights.radial[axis][lane] = bench_random(0, 0.5f);
+        }
+
+        state.lights.distance[lane] = bench_random(1, 10);
+        state.lights.angular[lane] = 1;
+    }
+
+    state.surface.sphere = true;
+
+    for(int axis = 0; axis < 3; axis++){
+
+        state.surface.center[axis] = state.sphere.center[axis];
+        state.surface.normal[axis] = 0;
+        state.surface.view[axis] = -state.rd[0][axis];
+        state.surface.diffuse[axis] = bench_random(0, 255);
+        state.surface.specular[axis] = bench_random(0, 255);
+    }
+
+    state.surface.shininess = 20;
+    state.surface.specular_power = select_power_kernel(20);
+    state.surface.specular_exponent = integer_power_exponent(20);
+    state.surface.specular_fast = false;
+
+    state.p3_file = tmpfile();
+    state.p6_file = tmpfile();
+    state.scratch_file = tmpfile();
+
+    if(state.p3_file == NULL || state.p6_file == NULL || state.scratch_file == NULL){
+
+        printf("Error: Could not create temporary files for the I/O benchmarks.\n");
+        exit(1);
+    }
+
+    write_p3(state.p3_file, state.pixmap, state.width, state.height, 255);
+    write_p6(state.p6_file, state.pixmap, state.width, state.height, 255);
+    fflush(state.p3_file);
+    fflush(state.p6_file);
+
+    double image_bytes = state.width * state.height * 3;
+
+    run_bench("sphere_intersection", bench_sphere_intersection, &state, 2000000 * scale + 1, 0);
+    run_bench("plane_intersection", bench_plane_intersection, &state, 2000000 * scale + 1, 0);
+    run_bench("v3_normalize", bench_v3_normalize, &state, 2000000 * scale + 1, 0);
+    run_bench("v3_dot_product", bench_v3_dot_product, &state, 2000000 * scale + 1, 0);
+    run_bench("v3_cross_product", bench_v3_cross_product, &state, 2000000 * scale + 1, 0);
+    run_bench("v3_reflect", bench_v3_reflect, &state, 2000000 * scale + 1, 0);
+    run_bench("texture_texel_sphere", bench_texture_sphere, &state, 1000000 * scale + 1, 0);
+    run_bench("texture_texel_plane", bench_texture_plane, &state, 1000000 * scale + 1, 0);
+    run_bench("texture_texel_sphere_fast", bench_texture_sphere_fast, &state, 1000000 * scale + 1, 0);
+    run_bench("texture_texel_plane_fast", bench_texture_plane_fast, &state, 1000000 * scale + 1, 0);
+    run_bench("pattern_checker", bench_pattern_checker, &state, 1000000 * scale + 1, 0);
+    run_bench("pattern_noise", bench_pattern_noise, &state, 1000000 * scale + 1, 0);
+    run_bench("shade_lights", bench_shade_lights, &state, 1000000 * scale + 1, 0);
+    run_bench("shade_lights_selected", bench_shade_lights_selected, &state, 1000000 * scale + 1, 0);
+    run_bench("read_p3", bench_read_p3, &state, 4 * scale + 1, image_bytes);
+    run_bench("read_p6", bench_read_p6, &state, 40 * scale + 1, image_bytes);
+    run_bench("write_p3", bench_write_p3, &state, 4 * scale + 1, image_bytes);
+    run_bench("write_p6", bench_write_p6, &state, 40 * scale + 1, image_bytes);
+
+    fclose(state.p3_file);
+    fclose(state.p6_file);
+    fclose(state.scratch_file);
+    free(state.pixmap);
+
+    return 0;
+}
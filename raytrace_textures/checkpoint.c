@@ -0,0 +1,265 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "hash.h"
+#include "net.h"
+
+// How often appended tiles are forced to disk.
+#define CHECKPOINT_SYNC_MS 2000
+
+static const char CHECKPOINT_MAGIC[8] = "RTJRNL02";
+
+typedef struct {
+
+    char magic[8];
+
+    // rt_render_digest() of the scene and options.
+    uint8_t key[32];
+
+    int32_t width;
+    int32_t height;
+    int32_t region[4];
+    int32_t num_tiles;
+
+    // FNV-1a of everything above.
+    uint64_t checksum;
+
+} checkpoint_header;
+
+// Followed by length bytes of RGB pixels, then the FNV-1a of this header
+// and the pixels as a uint64_t.
+typedef struct {
+
+    uint32_t tile;
+    uint32_t length;
+
+} checkpoint_record;
+
+
+// Copies the rows of bounds between the region pixmap and a packed buffer.
+void copy_tile(checkpoint *journal, const int bounds[4], uint8_t *packed, bool to_pixmap){
+
+    int region_width = journal->region[2] - journal->region[0];
+    size_t row_length = (size_t) (bounds[2] - bounds[0]) * 3;
+
+    for(int row = bounds[1]; row < bounds[3]; row++){
+
+        uint8_t *pixels = &journal->pixmap[((size_t) (row - journal->region[1]) * region_width +
+                                            bounds[0] - journal->region[0]) * 3];
+        uint8_t *packed_row = &packed[(row - bounds[1]) * row_length];
+
+        if(to_pixmap){
+
+            memcpy(pixels, packed_row, row_length);
+
+        } else {
+
+            memcpy(packed_row, pixels, row_length);
+        }
+    }
+}
+
+// Makes room for a record of length pixel bytes.
+bool reserve_record(checkpoint *journal, size_t length){
+
+    size_t needed = sizeof(checkpoint_record) + length + sizeof(uint64_t);
+
+    if(needed <= journal->record_capacity){
+
+        return true;
+    }
+
+    uint8_t *record = realloc(journal->record, needed);
+
+    if(record == NULL){
+
+        return false;
+    }
+
+    journal->record = record;
+    journal->record_capacity = needed;
+
+    return true;
+}
+
+// Reads the records after the header into the pixmap, stopping at the
+// first one that is cut short or fails its checksum. Returns the offset
+// just past the last good record.
+off_t restore_tiles(checkpoint *journal, const rt_render_options *options, uint8_t *done_tiles,
+                    int *num_restored){
+
+    off_t good_offset = sizeof(checkpoint_header);
+    checkpoint_record header;
+
+    while(net_read_full(journal->fd, &header, sizeof(header))){
+
+        if(header.tile >= (uint32_t) journal->num_tiles){
+
+            break;
+        }
+
+        int bounds[4];
+        rt_tile_bounds(options, header.tile, bounds);
+
+        size_t length = (size_t) (bounds[2] - bounds[0]) * (bounds[3] - bounds[1]) * 3;
+        uint64_t checksum;
+
+        if(header.length != length || !reserve_record(journal, length) ||
+           !net_read_full(journal->fd, journal->record, length) ||
+           !net_read_full(journal->fd, &checksum, sizeof(checksum)) ||
+           checksum != fnv1a(journal->record, length, fnv1a(&header, sizeof(header), FNV1A_OFFSET))){
+
+            break;
+        }
+
+        copy_tile(journal, bounds, journal->record, true);
+
+        if(!done_tiles[header.tile]){
+
+            done_tiles[header.tile] = 1;
+            (*num_restored)++;
+        }
+
+        good_offset += sizeof(header) + length + sizeof(checksum);
+    }
+
+    return good_offset;
+}
+
+bool checkpoint_open(checkpoint *journal, const char *path, const uint8_t scene_digest[32],
+                     const rt_render_options *options, uint8_t *pixmap, bool resume,
+                     uint8_t *done_tiles, int *num_restored){
+
+    memset(journal, 0, sizeof(checkpoint));
+
+    journal->pixmap = pixmap;
+    journal->num_tiles = rt_tile_count(options);
+    journal->last_sync_ms = stats_now_ms();
+    *num_restored = 0;
+
+    memcpy(journal->region, options->region, sizeof(journal->region));
+
+    checkpoint_header expected;
+    memset(&expected, 0, sizeof(expected));
+
+    memcpy(expected.magic, CHECKPOINT_MAGIC, sizeof(expected.magic));
+    rt_render_digest(scene_digest, options, expected.key);
+
+    expected.width = options->width;
+    expected.height = options->height;
+    expected.num_tiles = journal->num_tiles;
+
+    for(int i = 0; i < 4; i++){
+
+        expected.region[i] = journal->region[i];
+    }
+
+    expected.checksum = fnv1a(&expected, offsetof(checkpoint_header, checksum), FNV1A_OFFSET);
+
+    journal->fd = open(path, resume ? O_RDWR | O_CREAT : O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(journal->fd < 0){
+
+        printf("Error: Could not open the journal %s.\n", path);
+
+        return false;
+    }
+
+    checkpoint_header found;
+
+    if(resume && net_read_full(journal->fd, &found, sizeof(found))){
+
+        if(memcmp(&found, &expected, sizeof(found)) != 0){
+
+            printf("Error: The journal %s is from a different scene or different render options.\n", path);
+            close(journal->fd);
+
+            return false;
+        }
+
+        off_t good_offset = restore_tiles(journal, options, done_tiles, num_restored);
+
+        // Anything past the last good record is a write the crash cut off.
+        if(ftruncate(journal->fd, good_offset) != 0 || lseek(journal->fd, good_offset, SEEK_SET) < 0){
+
+            printf("Error: Could not trim the journal %s.\n", path);
+            close(journal->fd);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    // A new journal, or one that died before its header was written.
+    if(ftruncate(journal->fd, 0) != 0 || lseek(journal->fd, 0, SEEK_SET) < 0 ||
+       !net_write_full(journal->fd, &expected, sizeof(expected)) || fsync(journal->fd) != 0){
+
+        printf("Error: Could not write the journal %s.\n", path);
+        close(journal->fd);
+
+        return false;
+    }
+
+    return true;
+}
+
+int checkpoint_tile(int tile, const int bounds[4], void *user_data){
+
+    checkpoint *journal = user_data;
+
+    if(journal->failed){
+
+        return 0;
+    }
+
+    size_t length = (size_t) (bounds[2] - bounds[0]) * (bounds[3] - bounds[1]) * 3;
+
+    if(!reserve_record(journal, length)){
+
+        printf("Warning: Memory allocation for the journal has failed; checkpoints stop here.\n");
+        journal->failed = true;
+
+        return 0;
+    }
+
+    checkpoint_record header = {tile, length};
+    uint8_t *pixels = &journal->record[sizeof(header)];
+
+    memcpy(journal->record, &header, sizeof(header));
+    copy_tile(journal, bounds, pixels, false);
+
+    uint64_t checksum = fnv1a(journal->record, sizeof(header) + length, FNV1A_OFFSET);
+    memcpy(&pixels[length], &checksum, sizeof(checksum));
+
+    // One write per record keeps a crash from interleaving half records.
+    bool written = net_write_full(journal->fd, journal->record, sizeof(header) + length + sizeof(checksum));
+
+    if(written && stats_now_ms() - journal->last_sync_ms >= CHECKPOINT_SYNC_MS){
+
+        written = fsync(journal->fd) == 0;
+        journal->last_sync_ms = stats_now_ms();
+    }
+
+    if(!written){
+
+        printf("Warning: Writing the journal has failed; checkpoints stop here.\n");
+        journal->failed = true;
+    }
+
+    return 0;
+}
+
+bool checkpoint_close(checkpoint *journal){
+
+    bool ok = !journal->failed && fsync(journal->fd) == 0;
+
+    close(journal->fd);
+    free(journal->record);
+
+    return ok;
+}
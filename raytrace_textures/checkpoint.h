@@ -0,0 +1,51 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rt.h"
+
+// A journal of finished tiles, so a render that gets killed can pick up
+// where it left off. The file starts with a header holding the
+// rt_render_digest() of the scene and options, which covers textures,
+// meshes and every option that changes the pixels; each tile the renderer
+// finishes is appended with its pixels and a checksum, and the file is
+// fsynced every few seconds. A record cut short by a crash fails its
+// checksum and is dropped on resume.
+typedef struct {
+
+    int fd;
+    uint8_t *pixmap;
+    int region[4];
+    int num_tiles;
+
+    // Holds one record while it is written.
+    uint8_t *record;
+    size_t record_capacity;
+
+    double last_sync_ms;
+    bool failed;
+
+} checkpoint;
+
+// Opens the journal at path for rendering the scene with rt_scene_digest()
+// scene_digest with options, whose region must be filled in, into pixmap.
+// With resume, tiles an earlier run with the same scene and options
+// recorded are copied into pixmap and marked in done_tiles, which has
+// rt_tile_count(options) entries, and *num_restored says how many; a
+// missing journal is started afresh. Prints why and returns false if the
+// journal can't be used.
+bool checkpoint_open(checkpoint *journal, const char *path, const uint8_t scene_digest[32],
+                     const rt_render_options *options, uint8_t *pixmap, bool resume,
+                     uint8_t *done_tiles, int *num_restored);
+
+// An rt_tile_callback that appends the tile to the journal passed as
+// user_data. A failed write is reported once and ends journaling; the
+// render carries on.
+int checkpoint_tile(int tile, const int bounds[4], void *user_data);
+
+// Syncs and closes the journal. Returns false if any write failed.
+bool checkpoint_close(checkpoint *journal);
+
+#endif
@@ -0,0 +1,851 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "encoder.h"
+
+// Bytes buffered before each write to the file, and the most data put in
+// one PNG IDAT chunk.
+#define ENCODER_BUFFER_SIZE 65536
+
+// Deflate looks back up to 32 KB for matches of 3 to 258 bytes; the buffer
+// holds that history plus room for new bytes.
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_BUFFER (4 * DEFLATE_WINDOW)
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 15
+
+// Candidates tried per position; more finds longer matches, slower.
+#define DEFLATE_MAX_CHAIN 32
+
+
+// Buffered writes to the output file. A failed write is remembered and
+// everything after it dropped.
+typedef struct {
+
+    FILE *fp;
+    uint8_t data[ENCODER_BUFFER_SIZE];
+    int length;
+    bool failed;
+
+} byte_sink;
+
+void sink_flush(byte_sink *sink){
+
+    if(sink->length > 0 && !sink->failed && fwrite(sink->data, 1, sink->length, sink->fp) != (size_t) sink->length){
+
+        sink->failed = true;
+    }
+
+    sink->length = 0;
+}
+
+void sink_byte(byte_sink *sink, uint8_t value){
+
+    if(sink->length == ENCODER_BUFFER_SIZE){
+
+        sink_flush(sink);
+    }
+
+    sink->data[sink->length] = value;
+    sink->length++;
+}
+
+void sink_bytes(byte_sink *sink, const void *bytes, int count){
+
+    for(int index = 0; index < count; index++){
+
+        sink_byte(sink, ((const uint8_t *) bytes)[index]);
+    }
+}
+
+void sink_u32(byte_sink *sink, uint32_t value){
+
+    uint8_t bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+
+    sink_bytes(sink, bytes, 4);
+}
+
+
+// QOI, https://qoiformat.org: each pixel is a run of the last one, an
+// index into the 64 most recent colors, a small difference from the last
+// one or, failing all that, the raw color.
+typedef struct {
+
+    byte_sink sink;
+
+    uint8_t index[64][3];
+    uint8_t previous[3];
+    int run;
+
+} qoi_state;
+
+void qoi_start(qoi_state *qoi, int width, int height){
+
+    memset(qoi->index, 0, sizeof(qoi->index));
+    memset(qoi->previous, 0, sizeof(qoi->previous));
+    qoi->run = 0;
+
+    sink_bytes(&qoi->sink, "qoif", 4);
+    sink_u32(&qoi->sink, width);
+    sink_u32(&qoi->sink, height);
+
+    // RGB, sRGB with linear alpha.
+    sink_byte(&qoi->sink, 3);
+    sink_byte(&qoi->sink, 0);
+}
+
+void qoi_pixels(qoi_state *qoi, const uint8_t *pixels, long count){
+
+    for(long pixel = 0; pixel < count; pixel++){
+
+        const uint8_t *color = &pixels[pixel * 3];
+
+        if(memcmp(color, qoi->previous, 3) == 0){
+
+            qoi->run++;
+
+            if(qoi->run == 62){
+
+                sink_byte(&qoi->sink, 0xc0 | (qoi->run - 1));
+                qoi->run = 0;
+            }
+
+            continue;
+        }
+
+        if(qoi->run > 0){
+
+            sink_byte(&qoi->sink, 0xc0 | (qoi->run - 1));
+            qoi->run = 0;
+        }
+
+        // Alpha is always 255.
+        int hash = (color[0] * 3 + color[1] * 5 + color[2] * 7 + 255 * 11) % 64;
+
+        if(memcmp(qoi->index[hash], color, 3) == 0){
+
+            sink_byte(&qoi->sink, hash);
+
+        } else {
+
+            memcpy(qoi->index[hash], color, 3);
+
+            int8_t red = color[0] - qoi->previous[0];
+            int8_t green = color[1] - qoi->previous[1];
+            int8_t blue = color[2] - qoi->previous[2];
+
+            int red_green = red - green;
+            int blue_green = blue - green;
+
+            if(red >= -2 && red <= 1 && green >= -2 && green <= 1 && blue >= -2 && blue <= 1){
+
+                sink_byte(&qoi->sink, 0x40 | (red + 2) << 4 | (green + 2) << 2 | (blue + 2));
+
+            } else if(green >= -32 && green <= 31 && red_green >= -8 && red_green <= 7 &&
+                      blue_green >= -8 && blue_green <= 7){
+
+                sink_byte(&qoi->sink, 0x80 | (green + 32));
+                sink_byte(&qoi->sink, (red_green + 8) << 4 | (blue_green + 8));
+
+            } else {
+
+                sink_byte(&qoi->sink, 0xfe);
+                sink_bytes(&qoi->sink, color, 3);
+            }
+        }
+
+        memcpy(qoi->previous, color, 3);
+    }
+}
+
+void qoi_finish(qoi_state *qoi){
+
+    // The first pixel compares against black, so a QOI pixel run may
+    // start before the image does; QOI decoders expect exactly that.
+    if(qoi->run > 0){
+
+        sink_byte(&qoi->sink, 0xc0 | (qoi->run - 1));
+    }
+
+    const uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+    sink_bytes(&qoi->sink, end, 8);
+    sink_flush(&qoi->sink);
+}
+
+
+// PNG: each row is filtered with whichever of the five PNG filters leaves
+// the smallest bytes, and the rows are compressed as one zlib stream of
+// fixed-Huffman deflate, cut into IDAT chunks.
+typedef struct {
+
+    byte_sink sink;
+    uint32_t crc_table[256];
+
+    int width;
+
+    // The IDAT chunk being filled.
+    uint8_t chunk[ENCODER_BUFFER_SIZE];
+    int chunk_length;
+
+    // Bits not yet making a whole byte, lowest first.
+    uint64_t bits;
+    int num_bits;
+
+    uint32_t adler_a;
+    uint32_t adler_b;
+
+    // Filtered bytes: window_done of them compressed, window_length
+    // buffered; window[0] is byte window_base of the stream.
+    uint8_t window[DEFLATE_BUFFER];
+    int window_length;
+    int window_done;
+    long window_base;
+
+    // Stream offsets of the last position with each hash, and of the one
+    // before with the same hash as each position; -1 for none.
+    long head[1 << DEFLATE_HASH_BITS];
+    long previous[DEFLATE_WINDOW];
+
+    // A row under each of the five filters.
+    uint8_t *filtered[5];
+
+} png_state;
+
+static const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                    67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+                                     5, 5, 5, 5, 0};
+static const int DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+                                      769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+                                       10, 11, 11, 12, 12, 13, 13};
+
+uint32_t png_crc(png_state *png, uint32_t crc, const uint8_t *bytes, int count){
+
+    crc = ~crc;
+
+    for(int index = 0; index < count; index++){
+
+        crc = png->crc_table[(crc ^ bytes[index]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+void png_chunk(png_state *png, const char *type, const uint8_t *data, int length){
+
+    sink_u32(&png->sink, length);
+    sink_bytes(&png->sink, type, 4);
+    sink_bytes(&png->sink, data, length);
+    sink_u32(&png->sink, png_crc(png, png_crc(png, 0, (const uint8_t *) type, 4), data, length));
+}
+
+void png_byte(png_state *png, uint8_t value){
+
+    if(png->chunk_length == ENCODER_BUFFER_SIZE){
+
+        png_chunk(png, "IDAT", png->chunk, png->chunk_length);
+        png->chunk_length = 0;
+    }
+
+    png->chunk[png->chunk_length] = value;
+    png->chunk_length++;
+}
+
+void put_bits(png_state *png, uint32_t value, int count){
+
+    png->bits |= (uint64_t) value << png->num_bits;
+    png->num_bits += count;
+
+    while(png->num_bits >= 8){
+
+        png_byte(png, png->bits & 0xff);
+        png->bits >>= 8;
+        png->num_bits -= 8;
+    }
+}
+
+// Huffman codes go out most significant bit first.
+void put_code(png_state *png, uint32_t code, int length){
+
+    uint32_t reversed = 0;
+
+    for(int bit = 0; bit < length; bit++){
+
+        reversed = (reversed << 1) | ((code >> bit) & 1);
+    }
+
+    put_bits(png, reversed, length);
+}
+
+// A literal/length symbol in the fixed Huffman code.
+void put_symbol(png_state *png, int symbol){
+
+    if(symbol < 144){
+
+        put_code(png, 0x30 + symbol, 8);
+
+    } else if(symbol < 256){
+
+        put_code(png, 0x190 + symbol - 144, 9);
+
+    } else if(symbol < 280){
+
+        put_code(png, symbol - 256, 7);
+
+    } else {
+
+        put_code(png, 0xc0 + symbol - 280, 8);
+    }
+}
+
+void put_match(png_state *png, int length, int distance){
+
+    int code = 28;
+
+    while(LENGTH_BASE[code] > length){
+
+        code--;
+    }
+
+    put_symbol(png, 257 + code);
+    put_bits(png, length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+    code = 29;
+
+    while(DISTANCE_BASE[code] > distance){
+
+        code--;
+    }
+
+    put_code(png, code, 5);
+    put_bits(png, distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+// Records the window position index under the hash of its next 3 bytes,
+// returning the previous position with that hash.
+long insert_position(png_state *png, int index){
+
+    const uint8_t *bytes = &png->window[index];
+    uint32_t hash = ((bytes[0] << 16 | bytes[1] << 8 | bytes[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+
+    long position = png->window_base + index;
+    long candidate = png->head[hash];
+
+    png->previous[position & (DEFLATE_WINDOW - 1)] = candidate;
+    png->head[hash] = position;
+
+    return candidate;
+}
+
+// Compresses the buffered bytes, keeping the last DEFLATE_MAX_MATCH back
+// so matches aren't cut short, unless this is the end of the stream.
+void deflate_window(png_state *png, bool final){
+
+    int end = final ? png->window_length : png->window_length - DEFLATE_MAX_MATCH;
+    int index = png->window_done;
+
+    while(index < end){
+
+        int best_length = 0;
+        int best_distance = 0;
+
+        if(index + DEFLATE_MIN_MATCH <= png->window_length){
+
+            long position = png->window_base + index;
+            long candidate = insert_position(png, index);
+
+            int limit = png->window_length - index < DEFLATE_MAX_MATCH ? png->window_length - index :
+                                                                          DEFLATE_MAX_MATCH;
+            const uint8_t *current = &png->window[index];
+
+            for(int chain = 0; chain < DEFLATE_MAX_CHAIN && candidate >= 0 && candidate < position &&
+                position - candidate <= DEFLATE_WINDOW; chain++){
+
+                const uint8_t *earlier = &png->window[candidate - png->window_base];
+
+                if(earlier[best_length] == current[best_length]){
+
+                    int length = 0;
+
+                    while(length < limit && earlier[length] == current[length]){
+
+                        length++;
+                    }
+
+                    if(length > best_length){
+
+                        best_length = length;
+                        best_distance = position - candidate;
+
+                        if(length == limit){
+
+                            break;
+                        }
+                    }
+                }
+
+                candidate = png->previous[candidate & (DEFLATE_WINDOW - 1)];
+            }
+        }
+
+        if(best_length >= DEFLATE_MIN_MATCH){
+
+            put_match(png, best_length, best_distance);
+
+            for(int skipped = 1; skipped < best_length; skipped++){
+
+                if(index + skipped + DEFLATE_MIN_MATCH <= png->window_length){
+
+                    insert_position(png, index + skipped);
+                }
+            }
+
+            index += best_length;
+
+        } else {
+
+            put_symbol(png, png->window[index]);
+            index++;
+        }
+    }
+
+    png->window_done = index;
+}
+
+void deflate_bytes(png_state *png, const uint8_t *bytes, int count){
+
+    for(int index = 0; index < count; index++){
+
+        png->adler_a = (png->adler_a + bytes[index]) % 65521;
+        png->adler_b = (png->adler_b + png->adler_a) % 65521;
+    }
+
+    while(count > 0){
+
+        // Drop all but the history the next bytes can refer back to.
+        if(png->window_length == DEFLATE_BUFFER){
+
+            int shift = png->window_done - DEFLATE_WINDOW;
+
+            memmove(png->window, &png->window[shift], png->window_length - shift);
+
+            png->window_base += shift;
+            png->window_done -= shift;
+            png->window_length -= shift;
+        }
+
+        int take = DEFLATE_BUFFER - png->window_length < count ? DEFLATE_BUFFER - png->window_length : count;
+
+        memcpy(&png->window[png->window_length], bytes, take);
+
+        png->window_length += take;
+        bytes += take;
+        count -= take;
+
+        deflate_window(png, false);
+    }
+}
+
+bool png_start(png_state *png, int width, int height){
+
+    png->width = width;
+    png->chunk_length = 0;
+    png->bits = 0;
+    png->num_bits = 0;
+    png->adler_a = 1;
+    png->adler_b = 0;
+    png->window_length = 0;
+    png->window_done = 0;
+    png->window_base = 0;
+
+    memset(png->head, 0xff, sizeof(png->head));
+    memset(png->previous, 0xff, sizeof(png->previous));
+
+    for(int filter = 0; filter < 5; filter++){
+
+        png->filtered[filter] = malloc((size_t) width * 3 + 1);
+    }
+
+    for(int filter = 0; filter < 5; filter++){
+
+        if(png->filtered[filter] == NULL){
+
+            return false;
+        }
+    }
+
+    for(uint32_t index = 0; index < 256; index++){
+
+        uint32_t crc = index;
+
+        for(int bit = 0; bit < 8; bit++){
+
+            crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+
+        png->crc_table[index] = crc;
+    }
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace.
+    uint8_t header[13] = {width >> 24, width >> 16, width >> 8, width, height >> 24, height >> 16,
+                          height >> 8, height, 8, 2, 0, 0, 0};
+
+    sink_bytes(&png->sink, signature, 8);
+    png_chunk(png, "IHDR", header, 13);
+
+    // zlib header for deflate with a 32 KB window, then a single final
+    // block with the fixed codes.
+    png_byte(png, 0x78);
+    png_byte(png, 0x01);
+    put_bits(png, 1, 1);
+    put_bits(png, 1, 2);
+
+    return true;
+}
+
+int paeth(int left, int up, int up_left){
+
+    int estimate = left + up - up_left;
+    int to_left = abs(estimate - left);
+    int to_up = abs(estimate - up);
+    int to_up_left = abs(estimate - up_left);
+
+    if(to_left <= to_up && to_left <= to_up_left){
+
+        return left;
+    }
+
+    return to_up <= to_up_left ? up : up_left;
+}
+
+// Filters and compresses one row; above is the row before, or NULL.
+void png_row(png_state *png, const uint8_t *row, const uint8_t *above){
+
+    int length = png->width * 3;
+    long best_cost = -1;
+    int best_filter = 0;
+
+    for(int filter = 0; filter < 5; filter++){
+
+        uint8_t *out = png->filtered[filter];
+        long cost = 0;
+
+        out[0] = filter;
+
+        for(int index = 0; index < length; index++){
+
+            int left = index >= 3 ? row[index - 3] : 0;
+            int up = above != NULL ? above[index] : 0;
+            int up_left = index >= 3 && above != NULL ? above[index - 3] : 0;
+            int predicted = 0;
+
+            switch(filter){
+
+                case 1: predicted = left; break;
+                case 2: predicted = up; break;
+                case 3: predicted = (left + up) / 2; break;
+                case 4: predicted = paeth(left, up, up_left); break;
+            }
+
+            out[index + 1] = row[index] - predicted;
+
+            // Smallest total distance from zero usually compresses best.
+            cost += abs((int8_t) out[index + 1]);
+        }
+
+        if(best_cost < 0 || cost < best_cost){
+
+            best_cost = cost;
+            best_filter = filter;
+        }
+    }
+
+    deflate_bytes(png, png->filtered[best_filter], length + 1);
+}
+
+void png_finish(png_state *png){
+
+    deflate_window(png, true);
+
+    // End of block, then pad to a byte and add the zlib checksum.
+    put_symbol(png, 256);
+    put_bits(png, 0, (8 - png->num_bits) % 8);
+
+    uint32_t adler = png->adler_b << 16 | png->adler_a;
+
+    png_byte(png, adler >> 24);
+    png_byte(png, adler >> 16);
+    png_byte(png, adler >> 8);
+    png_byte(png, adler);
+
+    png_chunk(png, "IDAT", png->chunk, png->chunk_length);
+    png_chunk(png, "IEND", NULL, 0);
+    sink_flush(&png->sink);
+}
+
+void png_free(png_state *png){
+
+    for(int filter = 0; filter < 5; filter++){
+
+        free(png->filtered[filter]);
+    }
+}
+
+
+byte_sink *encoder_sink(row_encoder *encoder){
+
+    return encoder->format == FormatQOI ? &((qoi_state *) encoder->state)->sink :
+                                          &((png_state *) encoder->state)->sink;
+}
+
+void encode_rows(row_encoder *encoder, int first, int last){
+
+    size_t row_length = (size_t) encoder->width * 3;
+
+    if(encoder->format == FormatQOI){
+
+        qoi_pixels(encoder->state, &encoder->pixmap[first * row_length], (long) (last - first) * encoder->width);
+
+        return;
+    }
+
+    for(int row = first; row < last; row++){
+
+        png_row(encoder->state, &encoder->pixmap[row * row_length],
+                row > 0 ? &encoder->pixmap[(row - 1) * row_length] : NULL);
+    }
+}
+
+void *encoder_main(void *arg){
+
+    row_encoder *encoder = arg;
+
+    pthread_mutex_lock(&encoder->lock);
+
+    while(encoder->encoded < encoder->height){
+
+        while(encoder->ready == encoder->encoded && !encoder->abandoned){
+
+            pthread_cond_wait(&encoder->rows_ready, &encoder->lock);
+        }
+
+        if(encoder->abandoned){
+
+            break;
+        }
+
+        int first = encoder->encoded;
+        int last = encoder->ready;
+
+        pthread_mutex_unlock(&encoder->lock);
+
+        encode_rows(encoder, first, last);
+
+        pthread_mutex_lock(&encoder->lock);
+
+        encoder->encoded = last;
+    }
+
+    bool complete = encoder->encoded == encoder->height;
+
+    pthread_mutex_unlock(&encoder->lock);
+
+    if(complete && encoder->format == FormatQOI){
+
+        qoi_finish(encoder->state);
+
+    } else if(complete){
+
+        png_finish(encoder->state);
+
+    } else {
+
+        sink_flush(encoder_sink(encoder));
+    }
+
+    encoder->failed = encoder_sink(encoder)->failed;
+
+    return NULL;
+}
+
+bool image_format_for(const char *filename, enum image_format *format){
+
+    size_t length = strlen(filename);
+    const char *extension = length >= 4 ? &filename[length - 4] : "";
+
+    if(strcmp(extension, ".ppm") == 0){
+
+        *format = FormatP3;
+
+    } else if(strcmp(extension, ".qoi") == 0){
+
+        *format = FormatQOI;
+
+    } else if(strcmp(extension, ".png") == 0){
+
+        *format = FormatPNG;
+
+    } else {
+
+        return false;
+    }
+
+    return true;
+}
+
+// Marks the pixels of bounds as rendered and moves ready past the rows
+// that are now complete. Called with the lock held, or before the thread
+// starts.
+void mark_rendered(row_encoder *encoder, const int bounds[4]){
+
+    for(int row = bounds[1]; row < bounds[3]; row++){
+
+        encoder->remaining[row] -= bounds[2] - bounds[0];
+    }
+
+    while(encoder->ready < encoder->height && encoder->remaining[encoder->ready] == 0){
+
+        encoder->ready++;
+    }
+}
+
+bool encoder_start(row_encoder *encoder, FILE *fp, enum image_format format, const uint8_t *pixmap,
+                   const rt_render_options *options, const uint8_t *skip_tiles){
+
+    encoder->fp = fp;
+    encoder->format = format;
+    encoder->pixmap = pixmap;
+    encoder->width = options->width;
+    encoder->height = options->height;
+    encoder->ready = 0;
+    encoder->encoded = 0;
+    encoder->abandoned = false;
+    encoder->failed = false;
+
+    encoder->remaining = malloc(sizeof(int) * encoder->height);
+    encoder->state = malloc(format == FormatQOI ? sizeof(qoi_state) : sizeof(png_state));
+
+    if(encoder->remaining == NULL || encoder->state == NULL){
+
+        free(encoder->remaining);
+        free(encoder->state);
+
+        return false;
+    }
+
+    for(int row = 0; row < encoder->height; row++){
+
+        encoder->remaining[row] = encoder->width;
+    }
+
+    for(int tile = 0; skip_tiles != NULL && tile < rt_tile_count(options); tile++){
+
+        if(skip_tiles[tile]){
+
+            int bounds[4];
+            rt_tile_bounds(options, tile, bounds);
+
+            mark_rendered(encoder, bounds);
+        }
+    }
+
+    byte_sink *sink = encoder_sink(encoder);
+
+    sink->fp = fp;
+    sink->length = 0;
+    sink->failed = false;
+
+    bool started = true;
+
+    if(format == FormatQOI){
+
+        qoi_start(encoder->state, encoder->width, encoder->height);
+
+    } else {
+
+        // png_free() is safe on whatever png_start() got to.
+        memset(((png_state *) encoder->state)->filtered, 0, sizeof(((png_state *) encoder->state)->filtered));
+
+        started = png_start(encoder->state, encoder->width, encoder->height);
+    }
+
+    pthread_mutex_init(&encoder->lock, NULL);
+    pthread_cond_init(&encoder->rows_ready, NULL);
+
+    if(!started || pthread_create(&encoder->thread, NULL, encoder_main, encoder) != 0){
+
+        if(format == FormatPNG){
+
+            png_free(encoder->state);
+        }
+
+        pthread_mutex_destroy(&encoder->lock);
+        pthread_cond_destroy(&encoder->rows_ready);
+        free(encoder->remaining);
+        free(encoder->state);
+
+        return false;
+    }
+
+    return true;
+}
+
+int encoder_tile(int tile, const int bounds[4], void *user_data){
+
+    // Rows are tracked by their pixels, not by tile number.
+    (void) tile;
+
+    row_encoder *encoder = user_data;
+
+    pthread_mutex_lock(&encoder->lock);
+
+    int ready = encoder->ready;
+
+    mark_rendered(encoder, bounds);
+
+    if(encoder->ready != ready){
+
+        pthread_cond_signal(&encoder->rows_ready);
+    }
+
+    pthread_mutex_unlock(&encoder->lock);
+
+    return 0;
+}
+
+bool encoder_finish(row_encoder *encoder, bool rendered){
+
+    pthread_mutex_lock(&encoder->lock);
+
+    // A finished render has filled every row, whatever was reported.
+    if(rendered){
+
+        encoder->ready = encoder->height;
+
+    } else {
+
+        encoder->abandoned = true;
+    }
+
+    pthread_cond_signal(&encoder->rows_ready);
+    pthread_mutex_unlock(&encoder->lock);
+
+    pthread_join(encoder->thread, NULL);
+
+    if(encoder->format == FormatPNG){
+
+        png_free(encoder->state);
+    }
+
+    pthread_mutex_destroy(&encoder->lock);
+    pthread_cond_destroy(&encoder->rows_ready);
+    free(encoder->remaining);
+    free(encoder->state);
+
+    return rendered && !encoder->failed;
+}
@@ -0,0 +1,68 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "rt.h"
+
+// Lossless QOI and PNG output, written by a thread of its own while the
+// frame is still rendering. Render tiles report in through encoder_tile();
+// as soon as every tile covering a row is done, the rows up to it are
+// compressed and written, so most of the encoding hides behind the render.
+
+enum image_format{FormatP3, FormatQOI, FormatPNG};
+
+typedef struct {
+
+    FILE *fp;
+    enum image_format format;
+
+    const uint8_t *pixmap;
+    int width;
+    int height;
+
+    // Per row, the pixels not rendered yet.
+    int *remaining;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t rows_ready;
+
+    // Rows 0 .. ready - 1 are rendered; the thread has written the rows
+    // before encoded. Guarded by lock.
+    int ready;
+    int encoded;
+    bool abandoned;
+
+    // Set by the thread if a write fails.
+    bool failed;
+
+    // Format state, owned by the thread.
+    void *state;
+
+} row_encoder;
+
+// The format to write filename in, from its extension: .ppm, .qoi or .png.
+// Returns false for anything else.
+bool image_format_for(const char *filename, enum image_format *format);
+
+// Starts a thread writing the width x height pixmap to fp as format (QOI or
+// PNG) as its rows are rendered. Tiles marked in skip_tiles, which may be
+// NULL, are treated as already rendered; options gives the tile layout.
+// Returns false if memory or the thread can't be had.
+bool encoder_start(row_encoder *encoder, FILE *fp, enum image_format format, const uint8_t *pixmap,
+                   const rt_render_options *options, const uint8_t *skip_tiles);
+
+// Marks the pixels of bounds as rendered. An rt_tile_callback with the
+// encoder as user_data.
+int encoder_tile(int tile, const int bounds[4], void *user_data);
+
+// Waits for the rest of the image to be written and frees the encoder.
+// If rendered is false the rest of the image is abandoned instead. Returns
+// false if anything couldn't be written.
+bool encoder_finish(row_encoder *encoder, bool rendered);
+
+#endif
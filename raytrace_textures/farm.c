@@ -0,0 +1,753 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "farm.h"
+#include "net.h"
+#include "rt.h"
+#include "ppmrw.h"
+
+// The protocol is line based, with raw bytes after lines that announce a
+// length:
+//
+//   coordinator -> worker   SCENE WIDTH HEIGHT LENGTH\n<scene text>
+//   worker -> coordinator   READY\n  or  ERR MESSAGE\n
+//   coordinator -> worker   TILE INDEX X0 Y0 X1 Y1\n
+//   worker -> coordinator   DONE INDEX LENGTH\n<RGB bytes of the tile>
+//   coordinator -> worker   QUIT\n
+
+// Edge of the square tiles handed to workers, in pixels.
+#define FARM_TILE_SIZE 64
+
+// Tiles queued on each worker, so it starts the next while the last one
+// is on its way back.
+#define FARM_TILES_IN_FLIGHT 2
+
+// Connection attempts a worker makes while the coordinator starts up.
+#define FARM_CONNECT_ATTEMPTS 50
+#define FARM_CONNECT_RETRY_MS 100
+
+// How long a worker gets to load the scene, or to finish the tile at the
+// head of its queue, before the coordinator gives up on it and hands its
+// tiles to someone else.
+#define FARM_TILE_TIMEOUT_MS 120000
+
+// How long a read or write may wait once a message has started, so a
+// worker that stalls halfway through one can't hang the coordinator.
+#define FARM_IO_TIMEOUT_MS 10000
+
+// How long the coordinator waits for a worker, from start-up or once every
+// worker it had is gone, when it has no local ones of its own.
+#define FARM_IDLE_TIMEOUT_MS 60000
+
+// Longest the coordinator sleeps between checks of deadlines and workers.
+#define FARM_POLL_INTERVAL_MS 1000
+
+enum tile_state{Pending, Assigned, Done};
+
+typedef struct {
+
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+
+    enum tile_state state;
+
+} farm_tile;
+
+typedef struct {
+
+    int fd;
+    int id;
+    bool ready;
+
+    int in_flight[FARM_TILES_IN_FLIGHT];
+    int num_in_flight;
+
+    int tiles_done;
+
+    // When the worker is overdue: for READY while it loads, then for the
+    // tile at the head of its queue. Only counts while it has one.
+    double deadline;
+
+} farm_worker;
+
+
+// Reads the whole of filename into a buffer. Returns NULL if it can't.
+char *read_scene_text(const char *filename, size_t *length){
+
+    FILE *fp = fopen(filename, "rb");
+
+    if(fp == NULL){
+
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    char *text = malloc(capacity);
+    *length = 0;
+
+    while(text != NULL){
+
+        *length += fread(&text[*length], 1, capacity - *length, fp);
+
+        if(*length < capacity){
+
+            break;
+        }
+
+        capacity *= 2;
+
+        char *grown = realloc(text, capacity);
+
+        if(grown == NULL){
+
+            free(text);
+        }
+
+        text = grown;
+    }
+
+    if(text != NULL && ferror(fp)){
+
+        free(text);
+        text = NULL;
+    }
+
+    fclose(fp);
+
+    return text;
+}
+
+// Puts the tiles a worker still holds back in the queue and closes it.
+void drop_worker(farm_worker *worker, farm_tile *tiles, const char *reason){
+
+    for(int slot = 0; slot < worker->num_in_flight; slot++){
+
+        tiles[worker->in_flight[slot]].state = Pending;
+    }
+
+    printf("Worker %d lost (%s) after %d tiles; %d tiles requeued.\n", worker->id, reason,
+           worker->tiles_done, worker->num_in_flight);
+
+    close(worker->fd);
+
+    worker->fd = -1;
+    worker->num_in_flight = 0;
+}
+
+// Sends the worker pending tiles until it holds FARM_TILES_IN_FLIGHT.
+// Returns false if the connection broke.
+bool assign_tiles(farm_worker *worker, farm_tile *tiles, int num_tiles, int *next_pending){
+
+    // An idle worker starts on its first tile straight away.
+    if(worker->num_in_flight == 0){
+
+        worker->deadline = stats_now_ms() + FARM_TILE_TIMEOUT_MS;
+    }
+
+    while(worker->num_in_flight < FARM_TILES_IN_FLIGHT){
+
+        // Requeued tiles sit behind next_pending, so look from the start
+        // again once it runs off the end.
+        while(*next_pending < num_tiles && tiles[*next_pending].state != Pending){
+
+            (*next_pending)++;
+        }
+
+        if(*next_pending == num_tiles){
+
+            *next_pending = 0;
+
+            while(*next_pending < num_tiles && tiles[*next_pending].state != Pending){
+
+                (*next_pending)++;
+            }
+
+            if(*next_pending == num_tiles){
+
+                return true;
+            }
+        }
+
+        farm_tile *tile = &tiles[*next_pending];
+
+        char line[128];
+        int length = snprintf(line, sizeof(line), "TILE %d %d %d %d %d\n", *next_pending, tile->x0,
+                              tile->y0, tile->x1, tile->y1);
+
+        if(!net_write_full(worker->fd, line, length)){
+
+            return false;
+        }
+
+        tile->state = Assigned;
+        worker->in_flight[worker->num_in_flight] = *next_pending;
+        worker->num_in_flight++;
+    }
+
+    return true;
+}
+
+// Reads one DONE message from worker into frame. Returns false if the
+// worker broke the protocol or went away.
+bool receive_tile(farm_worker *worker, farm_tile *tiles, int num_tiles, uint8_t *frame, int width,
+                  uint8_t *buffer){
+
+    char line[128];
+    int index;
+    int length;
+
+    if(!net_read_line(worker->fd, line, sizeof(line)) ||
+       sscanf(line, "DONE %d %d", &index, &length) != 2 || index < 0 || index >= num_tiles){
+
+        return false;
+    }
+
+    farm_tile *tile = &tiles[index];
+    int tile_width = tile->x1 - tile->x0;
+
+    if(length != tile_width * (tile->y1 - tile->y0) * 3 || !net_read_full(worker->fd, buffer, length)){
+
+        return false;
+    }
+
+    int slot = 0;
+
+    while(slot < worker->num_in_flight && worker->in_flight[slot] != index){
+
+        slot++;
+    }
+
+    if(slot == worker->num_in_flight){
+
+        return false;
+    }
+
+    worker->in_flight[slot] = worker->in_flight[worker->num_in_flight - 1];
+    worker->num_in_flight--;
+    worker->tiles_done++;
+
+    // The next tile in its queue starts now.
+    worker->deadline = stats_now_ms() + FARM_TILE_TIMEOUT_MS;
+
+    for(int row = tile->y0; row < tile->y1; row++){
+
+        memcpy(&frame[((size_t) row * width + tile->x0) * 3],
+               &buffer[(size_t) (row - tile->y0) * tile_width * 3], tile_width * 3);
+    }
+
+    tile->state = Done;
+
+    return true;
+}
+
+int run_coordinator(const char *address, const char *scene_file, int width, int height,
+                    const char *output_file, int spawn_workers, int threads_per_worker){
+
+    size_t scene_length;
+    char *scene_text = read_scene_text(scene_file, &scene_length);
+
+    if(scene_text == NULL){
+
+        printf("Error: Could not read the scene %s.\n", scene_file);
+
+        return 1;
+    }
+
+    int listener = net_listen(address);
+
+    if(listener < 0){
+
+        printf("Error: Could not listen on %s.\n", address);
+        free(scene_text);
+
+        return 1;
+    }
+
+    // A worker that goes away mid-write is handled where the write fails.
+    signal(SIGPIPE, SIG_IGN);
+
+    int tiles_across = (width + FARM_TILE_SIZE - 1) / FARM_TILE_SIZE;
+    int tiles_down = (height + FARM_TILE_SIZE - 1) / FARM_TILE_SIZE;
+    int num_tiles = tiles_across * tiles_down;
+
+    farm_tile *tiles = malloc(sizeof(farm_tile) * num_tiles);
+    uint8_t *frame = malloc((size_t) width * height * 3);
+    uint8_t *buffer = malloc(FARM_TILE_SIZE * FARM_TILE_SIZE * 3);
+
+    if(tiles == NULL || frame == NULL || buffer == NULL){
+
+        printf("Error: Memory allocation for the frame has failed!\n");
+        exit(1);
+    }
+
+    for(int index = 0; index < num_tiles; index++){
+
+        farm_tile *tile = &tiles[index];
+
+        tile->x0 = index % tiles_across * FARM_TILE_SIZE;
+        tile->y0 = index / tiles_across * FARM_TILE_SIZE;
+        tile->x1 = tile->x0 + FARM_TILE_SIZE < width ? tile->x0 + FARM_TILE_SIZE : width;
+        tile->y1 = tile->y0 + FARM_TILE_SIZE < height ? tile->y0 + FARM_TILE_SIZE : height;
+        tile->state = Pending;
+    }
+
+    printf("Coordinating %d tiles on %s.\n", num_tiles, address);
+    fflush(stdout);
+
+    // Local workers are forked before anything else so they start from a
+    // clean process.
+    pid_t *children = malloc(sizeof(pid_t) * (spawn_workers > 0 ? spawn_workers : 1));
+    int num_children = 0;
+    int live_children = 0;
+
+    for(int child = 0; child < spawn_workers; child++){
+
+        pid_t pid = fork();
+
+        if(pid == 0){
+
+            close(listener);
+            free(scene_text);
+
+            _exit(run_worker(address, threads_per_worker));
+        }
+
+        if(pid > 0){
+
+            children[num_children] = pid;
+            num_children++;
+            live_children++;
+        }
+    }
+
+    farm_worker *workers = NULL;
+    int num_workers = 0;
+    int workers_capacity = 0;
+    int next_worker_id = 0;
+
+    int tiles_done = 0;
+    int next_pending = 0;
+    int result = 0;
+
+    double start = stats_now_ms();
+    double idle_since = start;
+
+    while(tiles_done < num_tiles && result == 0){
+
+        double now = stats_now_ms();
+
+        // A worker that is stuck, or gone without closing its connection,
+        // gives its tiles back.
+        for(int index = 0; index < num_workers; index++){
+
+            farm_worker *worker = &workers[index];
+
+            if(worker->fd >= 0 && (!worker->ready || worker->num_in_flight > 0) && now >= worker->deadline){
+
+                drop_worker(worker, tiles, worker->ready ? "tile timed out" : "scene load timed out");
+            }
+        }
+
+        // Reap local workers that have exited.
+        for(int child = 0; child < num_children; child++){
+
+            if(children[child] > 0 && waitpid(children[child], NULL, WNOHANG) == children[child]){
+
+                children[child] = -1;
+                live_children--;
+            }
+        }
+
+        int connected = 0;
+        int timeout = FARM_POLL_INTERVAL_MS;
+
+        for(int index = 0; index < num_workers; index++){
+
+            farm_worker *worker = &workers[index];
+
+            if(worker->fd < 0){
+
+                continue;
+            }
+
+            connected++;
+
+            if((!worker->ready || worker->num_in_flight > 0) && worker->deadline - now < timeout){
+
+                timeout = worker->deadline - now > 0 ? (int) (worker->deadline - now) + 1 : 0;
+            }
+        }
+
+        // With no workers left the frame can't finish. Local workers don't
+        // come back, and remote ones get FARM_IDLE_TIMEOUT_MS to join, from
+        // start-up or from when the last one left.
+        if(connected > 0 || live_children > 0){
+
+            idle_since = now;
+
+        } else if(spawn_workers > 0 || now - idle_since >= FARM_IDLE_TIMEOUT_MS){
+
+            printf("Error: No workers %s; %d of %d tiles were not rendered.\n",
+                   next_worker_id > 0 ? "left" : "connected", num_tiles - tiles_done, num_tiles);
+            result = 1;
+
+            break;
+        }
+
+        struct pollfd fds[num_workers + 1];
+
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+
+        for(int index = 0; index < num_workers; index++){
+
+            fds[index + 1].fd = workers[index].fd;
+            fds[index + 1].events = POLLIN;
+            fds[index + 1].revents = 0;
+        }
+
+        if(poll(fds, num_workers + 1, timeout) < 0){
+
+            if(errno == EINTR){
+
+                continue;
+            }
+
+            printf("Error: Waiting for workers has failed.\n");
+            result = 1;
+
+            break;
+        }
+
+        for(int index = 0; index < num_workers; index++){
+
+            farm_worker *worker = &workers[index];
+
+            if(fds[index + 1].revents == 0 || worker->fd < 0){
+
+                continue;
+            }
+
+            if(!worker->ready){
+
+                char line[256];
+
+                if(!net_read_line(worker->fd, line, sizeof(line))){
+
+                    drop_worker(worker, tiles, "disconnected while loading");
+
+                    continue;
+                }
+
+                // Every worker gets the same scene, so if one can't load
+                // it the frame can't be rendered.
+                if(strncmp(line, "READY", 5) != 0){
+
+                    printf("Error: Worker %d could not load the scene: %s\n", worker->id,
+                           strncmp(line, "ERR ", 4) == 0 ? &line[4] : line);
+                    result = 1;
+
+                    break;
+                }
+
+                worker->ready = true;
+
+            } else {
+
+                if(!receive_tile(worker, tiles, num_tiles, frame, width, buffer)){
+
+                    drop_worker(worker, tiles, "connection closed");
+
+                    continue;
+                }
+
+                tiles_done++;
+            }
+
+            if(!assign_tiles(worker, tiles, num_tiles, &next_pending)){
+
+                drop_worker(worker, tiles, "connection closed");
+            }
+        }
+
+        // Requeued tiles go to the idle workers that are still around.
+        for(int index = 0; index < num_workers; index++){
+
+            farm_worker *worker = &workers[index];
+
+            if(worker->fd >= 0 && worker->ready && worker->num_in_flight < FARM_TILES_IN_FLIGHT &&
+               !assign_tiles(worker, tiles, num_tiles, &next_pending)){
+
+                drop_worker(worker, tiles, "connection closed");
+            }
+        }
+
+        if(fds[0].revents & POLLIN){
+
+            int fd = accept(listener, NULL, NULL);
+
+            if(fd < 0){
+
+                continue;
+            }
+
+            if(num_workers == workers_capacity){
+
+                workers_capacity = workers_capacity == 0 ? 8 : workers_capacity * 2;
+
+                farm_worker *grown = realloc(workers, sizeof(farm_worker) * workers_capacity);
+
+                if(grown == NULL){
+
+                    printf("Error: Memory allocation for the workers has failed!\n");
+                    exit(1);
+                }
+
+                workers = grown;
+            }
+
+            farm_worker *worker = &workers[num_workers];
+
+            memset(worker, 0, sizeof(farm_worker));
+            worker->fd = fd;
+            worker->id = next_worker_id;
+            worker->deadline = stats_now_ms() + FARM_TILE_TIMEOUT_MS;
+            next_worker_id++;
+            num_workers++;
+
+            char line[128];
+            int length = snprintf(line, sizeof(line), "SCENE %d %d %zu\n", width, height, scene_length);
+
+            if(!net_set_timeout(fd, FARM_IO_TIMEOUT_MS) || !net_write_full(fd, line, length) ||
+               !net_write_full(fd, scene_text, scene_length)){
+
+                drop_worker(worker, tiles, "could not send the scene");
+
+            } else {
+
+                printf("Worker %d joined.\n", worker->id);
+            }
+        }
+
+        // Forget closed connections.
+        int kept = 0;
+
+        for(int index = 0; index < num_workers; index++){
+
+            if(workers[index].fd >= 0){
+
+                workers[kept] = workers[index];
+                kept++;
+            }
+        }
+
+        num_workers = kept;
+        fflush(stdout);
+    }
+
+    for(int index = 0; index < num_workers; index++){
+
+        net_write_full(workers[index].fd, "QUIT\n", 5);
+        close(workers[index].fd);
+    }
+
+    close(listener);
+    net_unlink(address);
+
+    // A local worker dropped as stuck never sees QUIT, so none of them gets
+    // longer than FARM_IO_TIMEOUT_MS to exit before it is killed.
+    double give_up = stats_now_ms() + FARM_IO_TIMEOUT_MS;
+
+    for(int child = 0; child < num_children; child++){
+
+        if(children[child] < 0){
+
+            continue;
+        }
+
+        if(result != 0){
+
+            kill(children[child], SIGTERM);
+        }
+
+        while(waitpid(children[child], NULL, WNOHANG) == 0){
+
+            if(stats_now_ms() >= give_up){
+
+                kill(children[child], SIGKILL);
+                waitpid(children[child], NULL, 0);
+
+                break;
+            }
+
+            usleep(10 * 1000);
+        }
+    }
+
+    if(result == 0){
+
+        printf("Rendered %d tiles in %.3f ms.\n", num_tiles, stats_now_ms() - start);
+
+        FILE *outfile = fopen(output_file, "w");
+
+        if(outfile == NULL){
+
+            printf("Error: Could not open the output file.\n");
+            result = 1;
+
+        } else {
+
+            write_p3(outfile, frame, width, height, 255);
+            fclose(outfile);
+        }
+    }
+
+    free(children);
+    free(workers);
+    free(buffer);
+    free(frame);
+    free(tiles);
+    free(scene_text);
+
+    return result;
+}
+
+// Loads the scene the coordinator sends. Returns NULL after telling the
+// coordinator why it couldn't.
+rt_scene *receive_scene(int fd, int *width, int *height){
+
+    char line[128];
+    size_t length;
+
+    if(!net_read_line(fd, line, sizeof(line)) || sscanf(line, "SCENE %d %d %zu", width, height, &length) != 3){
+
+        return NULL;
+    }
+
+    char *text = malloc(length + 1);
+
+    if(text == NULL || !net_read_full(fd, text, length)){
+
+        free(text);
+
+        return NULL;
+    }
+
+    rt_scene *loaded;
+    rt_error error;
+
+    rt_status status = rt_scene_load_memory(&loaded, text, length, NULL, &error);
+
+    free(text);
+
+    if(status != RT_OK){
+
+        char reply[sizeof(error.message) + 8];
+        int reply_length = snprintf(reply, sizeof(reply), "ERR %s\n", error.message);
+
+        net_write_full(fd, reply, reply_length);
+
+        return NULL;
+    }
+
+    if(!net_write_full(fd, "READY\n", 6)){
+
+        rt_scene_free(loaded);
+
+        return NULL;
+    }
+
+    return loaded;
+}
+
+int run_worker(const char *address, int num_threads){
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = net_connect(address);
+
+    // The coordinator may still be starting up.
+    for(int attempt = 1; fd < 0 && attempt < FARM_CONNECT_ATTEMPTS; attempt++){
+
+        usleep(FARM_CONNECT_RETRY_MS * 1000);
+
+        fd = net_connect(address);
+    }
+
+    if(fd < 0){
+
+        printf("Error: Could not connect to %s.\n", address);
+
+        return 1;
+    }
+
+    int width;
+    int height;
+
+    rt_scene *loaded = receive_scene(fd, &width, &height);
+    rt_context *context = rt_context_create();
+    uint8_t *pixmap = malloc(FARM_TILE_SIZE * FARM_TILE_SIZE * 3);
+
+    if(loaded == NULL || context == NULL || pixmap == NULL){
+
+        rt_scene_free(loaded);
+        rt_context_free(context);
+        free(pixmap);
+        close(fd);
+
+        return 1;
+    }
+
+    int result = 1;
+    char line[128];
+
+    while(net_read_line(fd, line, sizeof(line))){
+
+        if(strcmp(line, "QUIT") == 0){
+
+            result = 0;
+
+            break;
+        }
+
+        int index;
+        rt_render_options options;
+        rt_render_options_init(&options, width, height);
+
+        if(sscanf(line, "TILE %d %d %d %d %d", &index, &options.region[0], &options.region[1],
+                  &options.region[2], &options.region[3]) != 5 ||
+           (options.region[2] - options.region[0]) * (options.region[3] - options.region[1]) >
+           FARM_TILE_SIZE * FARM_TILE_SIZE){
+
+            break;
+        }
+
+        options.num_threads = num_threads;
+
+        if(rt_render(context, loaded, &options, pixmap) != RT_OK){
+
+            break;
+        }
+
+        int length = (options.region[2] - options.region[0]) * (options.region[3] - options.region[1]) * 3;
+        int header_length = snprintf(line, sizeof(line), "DONE %d %d\n", index, length);
+
+        if(!net_write_full(fd, line, header_length) || !net_write_full(fd, pixmap, length)){
+
+            break;
+        }
+    }
+
+    free(pixmap);
+    rt_context_free(context);
+    rt_scene_free(loaded);
+    close(fd);
+
+    return result;
+}
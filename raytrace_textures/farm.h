@@ -0,0 +1,25 @@
+#ifndef FARM_H
+#define FARM_H
+
+// Renders one frame across worker processes. The coordinator listens on
+// address ("unix:PATH" or "HOST:PORT", see net.h), sends each worker that
+// connects the scene text once, then hands out tiles as workers finish
+// them, so faster workers take more of the frame. Tiles held by a worker
+// that disconnects, or that is still on a tile after two minutes, go back
+// in the queue. Workers may join at any point;
+// spawn_workers forks that many local ones, each with threads_per_worker
+// render threads. Texture filenames in the scene are opened by each worker,
+// relative to its own working directory.
+//
+// The assembled frame is written to output_file as P3. Returns 0 on
+// success, and 1 if the frame can't be finished: when every local worker
+// has exited, or when there are no local ones and no worker has been
+// connected for a minute.
+int run_coordinator(const char *address, const char *scene_file, int width, int height,
+                    const char *output_file, int spawn_workers, int threads_per_worker);
+
+// Connects to the coordinator at address and renders tiles until told to
+// stop. Returns 0 on a clean finish.
+int run_worker(const char *address, int num_threads);
+
+#endif
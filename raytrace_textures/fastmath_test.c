@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fastmath.h"
+#include "rt.h"
+
+// Checks the fast math path two ways: the AVX2 approximations give the same
+// bits as the scalar ones they stand in for, and a render with fast math
+// stays within a channel level or two of the exact one. Prints each
+// failure and exits with 1 if there were any.
+
+#define TEST_INPUTS 100000
+#define TEST_SIZE 160
+
+// Untextured, so texel lookups that round the other way can't move whole
+// texels; what is left is the error of pow() and sqrt().
+#define TEST_MAX_DELTA 2
+
+// Textured, where a texel boundary that moves changes a subpixel by as much
+// as the neighbouring texel differs; only a few of them may.
+#define TEST_MAX_TEXEL_CHANGES (TEST_SIZE * TEST_SIZE * 3 / 1000)
+
+int test_failures = 0;
+
+uint32_t test_random_state = 12345;
+
+float test_random_float(float low, float high){
+
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 17;
+    test_random_state ^= test_random_state << 5;
+
+    return low + (high - low) * ((test_random_state & 0xFFFFFF) / (float) 0x1000000);
+}
+
+#ifdef FASTMATH_AVX2
+
+__attribute__((target("avx2")))
+void check_lanes(const char *name, const float *expected, __m256 actual){
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, actual);
+
+    for(int lane = 0; lane < 8; lane++){
+
+        if(memcmp(&expected[lane], &lanes[lane], sizeof(float)) != 0){
+
+            printf("FAIL %s: %.9g with AVX2, %.9g without\n", name, lanes[lane], expected[lane]);
+            test_failures++;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void test_avx2_approximations(){
+
+    for(int input = 0; input < TEST_INPUTS; input += 8){
+
+        float base[8], exponent[8];
+        float log2[8], exp2[8], log2_expected[8], exp2_expected[8], power_expected[8];
+
+        for(int lane = 0; lane < 8; lane++){
+
+            // Dot products, so mostly (0, 1], with some at and below 0.
+            base[lane] = test_random_float(-0.1f, 1);
+            exponent[lane] = test_random_float(0, 200);
+            log2[lane] = test_random_float(1e-30f, 1e30f);
+            exp2[lane] = test_random_float(-150, 150);
+        }
+
+        // Exactly 0 and 1 go through the edges of the bit tricks.
+        if(input == 0){
+
+            base[0] = 0;
+            base[1] = 1;
+            log2[0] = 1;
+            exp2[0] = 0;
+        }
+
+        for(int lane = 0; lane < 8; lane++){
+
+            log2_expected[lane] = fast_log2f(log2[lane]);
+            exp2_expected[lane] = fast_exp2f(exp2[lane]);
+            power_expected[lane] = fast_powf(base[lane], exponent[lane]);
+        }
+
+        check_lanes("fast_log2f_avx2", log2_expected, fast_log2f_avx2(_mm256_loadu_ps(log2)));
+        check_lanes("fast_exp2f_avx2", exp2_expected, fast_exp2f_avx2(_mm256_loadu_ps(exp2)));
+
+        check_lanes("fast_powf_avx2", power_expected,
+                    fast_powf_avx2(_mm256_loadu_ps(base), _mm256_loadu_ps(exponent)));
+    }
+}
+
+#endif
+
+// Renders text with and without fast math and counts the subpixels that
+// differ, and by how much at most. Returns false if the scene won't render.
+bool compare_renders(const char *name, const char *text, int *max_delta, int *num_changed){
+
+    rt_scene *loaded;
+    rt_error error;
+
+    if(rt_scene_load_memory(&loaded, text, strlen(text), NULL, &error) != RT_OK){
+
+        printf("FAIL %s: %s\n", name, error.message);
+        test_failures++;
+
+        return false;
+    }
+
+    rt_context *context = rt_context_create();
+    uint8_t *exact = malloc(TEST_SIZE * TEST_SIZE * 3);
+    uint8_t *fast = malloc(TEST_SIZE * TEST_SIZE * 3);
+
+    if(context == NULL || exact == NULL || fast == NULL){
+
+        printf("Error: Memory allocation for the renders has failed!\n");
+        exit(1);
+    }
+
+    rt_render_options options;
+    rt_render_options_init(&options, TEST_SIZE, TEST_SIZE);
+
+    bool rendered = rt_render(context, loaded, &options, exact) == RT_OK;
+
+    options.fast_math = true;
+    rendered = rendered && rt_render(context, loaded, &options, fast) == RT_OK;
+
+    if(!rendered){
+
+        printf("FAIL %s: %s\n", name, rt_context_error(context));
+        test_failures++;
+    }
+
+    *max_delta = 0;
+    *num_changed = 0;
+
+    for(int index = 0; rendered && index < TEST_SIZE * TEST_SIZE * 3; index++){
+
+        int delta = abs(exact[index] - fast[index]);
+
+        if(delta > 0){
+
+            (*num_changed)++;
+        }
+
+        if(delta > *max_delta){
+
+            *max_delta = delta;
+        }
+    }
+
+    free(fast);
+    free(exact);
+    rt_context_free(context);
+    rt_scene_free(loaded);
+
+    return rendered;
+}
+
+void test_renders(){
+
+    // A non-integer spot exponent, so fast math takes over its pow(). The
+    // shininess stays an integer: past the highlight R.V goes negative, and
+    // there pow() gives NaN where fast_powf() gives 0, as fastmath.h says.
+    const char *plain =
+        "camera, width: 3.0, height: 3.0\n"
+        "sphere, radius: 2.0, diffuse_color: [0.5, 0.1, 0.1], specular_color: [1, 1, 1], "
+        "position: [1, 1, -5], shininess: 12, reflectivity: 0.2\n"
+        "sphere, radius: 1.5, diffuse_color: [0.3, 0.6, 0.7], specular_color: [1, 1, 1], "
+        "position: [-2.0, -1.0, -4.0], shininess: 37, reflectivity: 0.5\n"
+        "plane, normal: [0, 1, 0], diffuse_color: [0.35, 0.7, 0.25], position: [0, -1, 0], "
+        "shininess: 7, reflectivity: 0.3\n"
+        "light, color: [2, 2, 2], theta: 0, radial-a2: 0.125, radial-a1: 0.125, radial-a0: 0.125, "
+        "position: [0, 2, 1]\n"
+        "light, color: [1, 1, 1], theta: 45, radial-a2: 0.125, radial-a1: 0.125, radial-a0: 0.125, "
+        "position: [-2, 2, -1], angular-a0: 2.5, direction: [0, -1, -1]\n";
+
+    // The same scene with textures, for atan2(), acos() and remainder().
+    const char *textured =
+        "camera, width: 3.0, height: 3.0\n"
+        "sphere, radius: 2.0, diffuse_color: [0.5, 0.1, 0.1], specular_color: [1, 1, 1], "
+        "position: [1, 1, -5], shininess: 12, reflectivity: 0.2, texture: windows.ppm\n"
+        "sphere, radius: 1.5, diffuse_color: [0.3, 0.6, 0.7], specular_color: [1, 1, 1], "
+        "position: [-2.0, -1.0, -4.0], shininess: 37, reflectivity: 0.5\n"
+        "plane, normal: [0, 1, 0], diffuse_color: [0.35, 0.7, 0.25], position: [0, -1, 0], "
+        "shininess: 7, reflectivity: 0.3, texture: windows.ppm\n"
+        "light, color: [2, 2, 2], theta: 0, radial-a2: 0.125, radial-a1: 0.125, radial-a0: 0.125, "
+        "position: [0, 2, 1]\n"
+        "light, color: [1, 1, 1], theta: 45, radial-a2: 0.125, radial-a1: 0.125, radial-a0: 0.125, "
+        "position: [-2, 2, -1], angular-a0: 2.5, direction: [0, -1, -1]\n";
+
+    int max_delta;
+    int num_changed;
+
+    if(compare_renders("untextured render", plain, &max_delta, &num_changed)){
+
+        printf("untextured: %d subpixels differ, by at most %d\n", num_changed, max_delta);
+
+        if(max_delta > TEST_MAX_DELTA){
+
+            printf("FAIL untextured render: a channel differs by %d, more than %d\n", max_delta,
+                   TEST_MAX_DELTA);
+            test_failures++;
+        }
+    }
+
+    if(compare_renders("textured render", textured, &max_delta, &num_changed)){
+
+        printf("textured: %d subpixels differ, by at most %d\n", num_changed, max_delta);
+
+        if(num_changed > TEST_MAX_TEXEL_CHANGES){
+
+            printf("FAIL textured render: %d subpixels differ, more than %d\n", num_changed,
+                   TEST_MAX_TEXEL_CHANGES);
+            test_failures++;
+        }
+    }
+}
+
+int main(){
+
+#ifdef FASTMATH_AVX2
+    if(__builtin_cpu_supports("avx2")){
+
+        test_avx2_approximations();
+
+    } else {
+
+        printf("No AVX2 on this CPU; skipping the AVX2 approximations\n");
+    }
+#endif
+
+    test_renders();
+
+    if(test_failures > 0){
+
+        printf("fastmath_test: %d failures\n", test_failures);
+        return 1;
+    }
+
+    printf("fastmath_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define FNV1A_PRIME 0x100000001b3ULL
+
+uint64_t fnv1a(const void *data, size_t length, uint64_t hash){
+
+    const uint8_t *bytes = data;
+
+    for(size_t i = 0; i < length; i++){
+
+        hash ^= bytes[i];
+        hash *= FNV1A_PRIME;
+    }
+
+    return hash;
+}
+
+
+
+static const uint32_t SHA256_ROUND[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+uint32_t sha256_rotate(uint32_t value, int bits){
+
+    return value >> bits | value << (32 - bits);
+}
+
+void sha256_block(sha256_context *context, const uint8_t *block){
+
+    uint32_t schedule[64];
+
+    for(int i = 0; i < 16; i++){
+
+        schedule[i] = (uint32_t) block[i * 4] << 24 | block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 |
+                      block[i * 4 + 3];
+    }
+
+    for(int i = 16; i < 64; i++){
+
+        uint32_t s0 = sha256_rotate(schedule[i - 15], 7) ^ sha256_rotate(schedule[i - 15], 18) ^
+                      schedule[i - 15] >> 3;
+        uint32_t s1 = sha256_rotate(schedule[i - 2], 17) ^ sha256_rotate(schedule[i - 2], 19) ^
+                      schedule[i - 2] >> 10;
+
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = context->state[0], b = context->state[1], c = context->state[2], d = context->state[3];
+    uint32_t e = context->state[4], f = context->state[5], g = context->state[6], h = context->state[7];
+
+    for(int i = 0; i < 64; i++){
+
+        uint32_t t1 = h + (sha256_rotate(e, 6) ^ sha256_rotate(e, 11) ^ sha256_rotate(e, 25)) +
+                      ((e & f) ^ (~e & g)) + SHA256_ROUND[i] + schedule[i];
+        uint32_t t2 = (sha256_rotate(a, 2) ^ sha256_rotate(a, 13) ^ sha256_rotate(a, 22)) +
+                      ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    context->state[0] += a;
+    context->state[1] += b;
+    context->state[2] += c;
+    context->state[3] += d;
+    context->state[4] += e;
+    context->state[5] += f;
+    context->state[6] += g;
+    context->state[7] += h;
+}
+
+void sha256_init(sha256_context *context){
+
+    const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                 0x1f83d9ab, 0x5be0cd19};
+
+    for(int i = 0; i < 8; i++){
+
+        context->state[i] = initial[i];
+    }
+
+    context->length = 0;
+    context->block_length = 0;
+}
+
+void sha256_update(sha256_context *context, const void *data, size_t length){
+
+    const uint8_t *bytes = data;
+
+    context->length += length;
+
+    // Whole blocks straight from data once the partial one is full.
+    while(length > 0){
+
+        if(context->block_length == 0 && length >= 64){
+
+            sha256_block(context, bytes);
+
+            bytes += 64;
+            length -= 64;
+
+            continue;
+        }
+
+        size_t take = 64 - context->block_length;
+
+        if(take > length){
+
+            take = length;
+        }
+
+        memcpy(&context->block[context->block_length], bytes, take);
+
+        context->block_length += take;
+        bytes += take;
+        length -= take;
+
+        if(context->block_length == 64){
+
+            sha256_block(context, context->block);
+            context->block_length = 0;
+        }
+    }
+}
+
+void sha256_final(sha256_context *context, uint8_t digest[32]){
+
+    uint64_t bit_length = context->length * 8;
+    uint8_t padding[72] = {0x80};
+
+    // Pad to 56 bytes past a block boundary, then the length in bits.
+    int padding_length = (context->block_length < 56 ? 56 : 120) - context->block_length;
+
+    for(int i = 0; i < 8; i++){
+
+        padding[padding_length + i] = bit_length >> (56 - i * 8);
+    }
+
+    sha256_update(context, padding, padding_length + 8);
+
+    for(int i = 0; i < 8; i++){
+
+        digest[i * 4] = context->state[i] >> 24;
+        digest[i * 4 + 1] = context->state[i] >> 16;
+        digest[i * 4 + 2] = context->state[i] >> 8;
+        digest[i * 4 + 3] = context->state[i];
+    }
+}
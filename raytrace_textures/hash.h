@@ -0,0 +1,33 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit FNV-1a. Not cryptographic; good for telling inputs apart and for
+// catching torn or corrupted records.
+#define FNV1A_OFFSET 0xcbf29ce484222325ULL
+
+// Folds length bytes of data into hash; start from FNV1A_OFFSET.
+uint64_t fnv1a(const void *data, size_t length, uint64_t hash);
+
+// SHA-256, for keys that must not collide even between inputs chosen to,
+// such as the render cache's. Feed data with sha256_update() between
+// sha256_init() and sha256_final().
+typedef struct {
+
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    int block_length;
+
+} sha256_context;
+
+void sha256_init(sha256_context *context);
+
+void sha256_update(sha256_context *context, const void *data, size_t length);
+
+void sha256_final(sha256_context *context, uint8_t digest[32]);
+
+#endif
@@ -0,0 +1,92 @@
+#include <math.h>
+#include <time.h>
+
+#include "heatmap.h"
+#include "ppmrw.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// False-color ramp stops, evenly spaced from cheapest to most expensive.
+const uint8_t HEATMAP_RAMP[6][3] = {
+    {0, 0, 0},
+    {50, 10, 120},
+    {180, 30, 100},
+    {240, 110, 30},
+    {250, 225, 60},
+    {255, 255, 255}
+};
+
+uint64_t heatmap_counter(heatmap *heat, render_stats *stats){
+
+    if(heat->metric == Tests){
+
+        return stats->sphere_tests + stats->plane_tests + stats->triangle_tests;
+    }
+
+    if(heat->metric == Rays){
+
+        return stats->primary_rays + stats->reflection_rays + stats->shadow_rays;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    // No cycle counter; nanoseconds rank pixels the same way.
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+float write_heatmap(FILE *fp, heatmap *heat){
+
+    int length = heat->width * heat->height;
+    float max_cost = 0;
+
+    for(int index = 0; index < length; index++){
+
+        if(heat->cost[index] > max_cost){
+
+            max_cost = heat->cost[index];
+        }
+    }
+
+    uint8_t *pixmap = malloc(sizeof(uint8_t) * length * 3);
+
+    if(pixmap == NULL){
+
+        return -1;
+    }
+
+    // Log scale so a few pathological pixels don't wash out the rest.
+    float scale = max_cost > 0 ? 1 / log1pf(max_cost) : 0;
+
+    for(int index = 0; index < length; index++){
+
+        float position = log1pf(heat->cost[index]) * scale * 5;
+
+        int stop = (int) position;
+
+        if(stop >= 5){
+
+            stop = 4;
+        }
+
+        float blend = position - stop;
+
+        for(int channel = 0; channel < 3; channel++){
+
+            pixmap[index * 3 + channel] = HEATMAP_RAMP[stop][channel] +
+                blend * (HEATMAP_RAMP[stop + 1][channel] - HEATMAP_RAMP[stop][channel]);
+        }
+    }
+
+    write_p6(fp, pixmap, heat->width, heat->height, 255);
+
+    free(pixmap);
+
+    return max_cost;
+}
@@ -0,0 +1,30 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <stdint.h>
+
+#include "stats.h"
+
+// What each heatmap pixel measures.
+enum heatmap_metric{Tests, Rays, Cycles}; // intersection tests, rays cast, CPU cycles
+
+// Per-pixel cost of a render, filled in by raytrace() when one is passed.
+typedef struct {
+
+    enum heatmap_metric metric;
+    int width;
+    int height;
+    float *cost;
+
+} heatmap;
+
+// Reads the running total of the heatmap's metric. A pixel's cost is the
+// difference between the readings taken before and after it is traced.
+uint64_t heatmap_counter(heatmap *heat, render_stats *stats);
+
+// Writes the costs as a P6 image on a black-purple-orange-yellow-white ramp.
+// Costs are log-scaled against the most expensive pixel, which is returned,
+// or -1 if memory for the image runs out.
+float write_heatmap(FILE *fp, heatmap *heat);
+
+#endif
@@ -0,0 +1,339 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lightgrid.h"
+
+// Upper bound on the number of cells. Unbounded lights are listed in every
+// cell, so this also bounds what they cost.
+#define LIGHT_GRID_MAX_CELLS 4096
+
+// Cell tests are widened by this fraction so rounding never drops a light
+// from a cell a hit it reaches falls in.
+#define LIGHT_GRID_SLACK 1e-3f
+
+
+// Distance at which 1 / (a2 d^2 + a1 d + a0) falls below cutoff, or
+// INFINITY if it never does.
+float influence_radius(light *iter_light, float cutoff){
+
+    float a0 = iter_light->radial[0];
+    float a1 = iter_light->radial[1];
+    float a2 = iter_light->radial[2];
+
+    // Negative coefficients make the falloff non-monotonic; don't guess.
+    if(cutoff <= 0 || a1 < 0 || a2 < 0){
+
+        return INFINITY;
+    }
+
+    float target = 1 / cutoff;
+
+    if(a0 >= target){
+
+        return 0;
+    }
+
+    if(a2 > 0){
+
+        return (-a1 + sqrtf(a1 * a1 + 4 * a2 * (target - a0))) / (2 * a2);
+    }
+
+    if(a1 > 0){
+
+        return (target - a0) / a1;
+    }
+
+    return INFINITY;
+}
+
+// Whether the light at center, reaching radius, may light some point of
+// the box from lo to hi.
+bool light_touches_cell(light *iter_light, float radius, float *lo, float *hi){
+
+    float distance_squared = 0;
+
+    for(int axis = 0; axis < 3; axis++){
+
+        float nearest = fmaxf(lo[axis], fminf(iter_light->center[axis], hi[axis]));
+        float offset = iter_light->center[axis] - nearest;
+
+        distance_squared += offset * offset;
+    }
+
+    float reach = radius * (1 + LIGHT_GRID_SLACK);
+
+    if(distance_squared > reach * reach){
+
+        return false;
+    }
+
+    // A spot light only sees the cell if its cone meets the cell's
+    // bounding sphere.
+    if(iter_light->theta == 0 || v3_length(iter_light->direction) == 0){
+
+        return true;
+    }
+
+    float cell_center[3];
+    float half_diagonal[3];
+
+    for(int axis = 0; axis < 3; axis++){
+
+        cell_center[axis] = (lo[axis] + hi[axis]) / 2;
+        half_diagonal[axis] = (hi[axis] - lo[axis]) / 2;
+    }
+
+    float cell_radius = v3_length(half_diagonal) * (1 + LIGHT_GRID_SLACK);
+
+    float to_cell[3];
+    v3_from_points(to_cell, iter_light->center, cell_center);
+
+    float distance = v3_length(to_cell);
+
+    if(distance <= cell_radius){
+
+        return true;
+    }
+
+    float cone_angle = fabsf(iter_light->theta) * M_PI / 180;
+    float spread = asinf(cell_radius / distance);
+    float cosine = v3_dot_product(to_cell, iter_light->direction) / distance;
+    float angle = acosf(fmaxf(-1, fminf(1, cosine)));
+
+    return angle <= cone_angle + spread + LIGHT_GRID_SLACK;
+}
+
+bool light_grid_build(light_grid *grid, scene *current_scene, float cutoff){
+
+    memset(grid, 0, sizeof(light_grid));
+
+    int num_lights = current_scene->num_lights;
+    light *light_list = current_scene->light_list;
+
+    grid->radius = malloc(sizeof(float) * (num_lights > 0 ? num_lights : 1));
+    grid->radius_squared = malloc(sizeof(float) * (num_lights > 0 ? num_lights : 1));
+    grid->unbounded = malloc(sizeof(int) * (num_lights > 0 ? num_lights : 1));
+
+    if(grid->radius == NULL || grid->radius_squared == NULL || grid->unbounded == NULL){
+
+        light_grid_free(grid);
+
+        return false;
+    }
+
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    float total_reach = 0;
+    int num_bounded = 0;
+
+    for(int axis = 0; axis < 3; axis++){
+
+        grid->min[axis] = INFINITY;
+    }
+
+    for(int light_index = 0; light_index < num_lights; light_index++){
+
+        float radius = influence_radius(&light_list[light_index], cutoff);
+
+        grid->radius[light_index] = radius;
+        grid->radius_squared[light_index] = radius * radius;
+
+        if(isinf(radius)){
+
+            grid->unbounded[grid->num_unbounded] = light_index;
+            grid->num_unbounded++;
+
+            continue;
+        }
+
+        for(int axis = 0; axis < 3; axis++){
+
+            grid->min[axis] = fminf(grid->min[axis], light_list[light_index].center[axis] - radius);
+            hi[axis] = fmaxf(hi[axis], light_list[light_index].center[axis] + radius);
+        }
+
+        total_reach += 2 * radius;
+        num_bounded++;
+    }
+
+    // Nothing to bucket; every hit considers every (unbounded) light.
+    if(num_bounded == 0){
+
+        return true;
+    }
+
+    // Cells about as wide as an average sphere of influence, within the
+    // cell budget.
+    float cell_size = fmaxf(total_reach / num_bounded, 1e-6f);
+    long num_cells;
+
+    do {
+
+        num_cells = 1;
+
+        for(int axis = 0; axis < 3; axis++){
+
+            float extent = hi[axis] - grid->min[axis];
+            float cells = extent > 0 ? ceilf(extent / cell_size) : 1;
+
+            // Any axis over the budget sends us round again with bigger
+            // cells, so clamp it just past the budget rather than let the
+            // cast overflow; the product stays over the budget too.
+            grid->dims[axis] = cells < 1 ? 1 : cells > LIGHT_GRID_MAX_CELLS ? LIGHT_GRID_MAX_CELLS + 1 : (int) cells;
+            grid->inv_cell_size[axis] = extent > 0 ? grid->dims[axis] / extent : 0;
+
+            num_cells *= grid->dims[axis];
+            num_cells = num_cells > LIGHT_GRID_MAX_CELLS ? LIGHT_GRID_MAX_CELLS + 1 : num_cells;
+        }
+
+        cell_size *= 2;
+
+    } while(num_cells > LIGHT_GRID_MAX_CELLS);
+
+    grid->cell_start = calloc(num_cells + 1, sizeof(int));
+
+    if(grid->cell_start == NULL){
+
+        light_grid_free(grid);
+
+        return false;
+    }
+
+    // The first pass counts the lights of each cell, the second fills them
+    // in. Lights are visited in scene order, so every list comes out sorted.
+    for(int pass = 0; pass < 2; pass++){
+
+        int *cursor = NULL;
+
+        if(pass == 1){
+
+            for(int cell = 0; cell < num_cells; cell++){
+
+                grid->cell_start[cell + 1] += grid->cell_start[cell];
+            }
+
+            grid->cell_lights = malloc(sizeof(int) * (grid->cell_start[num_cells] > 0 ? grid->cell_start[num_cells] : 1));
+            cursor = malloc(sizeof(int) * num_cells);
+
+            if(grid->cell_lights == NULL || cursor == NULL){
+
+                free(cursor);
+                light_grid_free(grid);
+
+                return false;
+            }
+
+            memcpy(cursor, grid->cell_start, sizeof(int) * num_cells);
+        }
+
+        for(int light_index = 0; light_index < num_lights; light_index++){
+
+            light *iter_light = &light_list[light_index];
+            float radius = grid->radius[light_index];
+
+            int first[3];
+            int last[3];
+
+            for(int axis = 0; axis < 3; axis++){
+
+                first[axis] = 0;
+                last[axis] = grid->dims[axis] - 1;
+
+                if(!isinf(radius) && grid->inv_cell_size[axis] > 0){
+
+                    first[axis] = (int) floorf((iter_light->center[axis] - radius - grid->min[axis]) *
+                                               grid->inv_cell_size[axis]);
+                    last[axis] = (int) floorf((iter_light->center[axis] + radius - grid->min[axis]) *
+                                              grid->inv_cell_size[axis]);
+
+                    first[axis] = first[axis] < 0 ? 0 : first[axis];
+                    last[axis] = last[axis] >= grid->dims[axis] ? grid->dims[axis] - 1 : last[axis];
+                }
+            }
+
+            for(int z = first[2]; z <= last[2]; z++){
+
+                for(int y = first[1]; y <= last[1]; y++){
+
+                    for(int x = first[0]; x <= last[0]; x++){
+
+                        int coords[3] = {x, y, z};
+                        float lo[3];
+                        float cell_hi[3];
+
+                        for(int axis = 0; axis < 3; axis++){
+
+                            float size = grid->inv_cell_size[axis] > 0 ? 1 / grid->inv_cell_size[axis] : 0;
+
+                            lo[axis] = grid->min[axis] + coords[axis] * size;
+                            cell_hi[axis] = lo[axis] + size;
+                        }
+
+                        if(!isinf(radius) && !light_touches_cell(iter_light, radius, lo, cell_hi)){
+
+                            continue;
+                        }
+
+                        int cell = (z * grid->dims[1] + y) * grid->dims[0] + x;
+
+                        if(pass == 0){
+
+                            grid->cell_start[cell + 1]++;
+
+                        } else {
+
+                            grid->cell_lights[cursor[cell]] = light_index;
+                            cursor[cell]++;
+                        }
+                    }
+                }
+            }
+        }
+
+        free(cursor);
+    }
+
+    return true;
+}
+
+void light_grid_free(light_grid *grid){
+
+    free(grid->radius);
+    free(grid->radius_squared);
+    free(grid->cell_start);
+    free(grid->cell_lights);
+    free(grid->unbounded);
+
+    memset(grid, 0, sizeof(light_grid));
+}
+
+const int *light_grid_lookup(const light_grid *grid, const float *point, int *num_lights){
+
+    if(grid->cell_start == NULL){
+
+        *num_lights = grid->num_unbounded;
+
+        return grid->unbounded;
+    }
+
+    int coords[3];
+
+    for(int axis = 0; axis < 3; axis++){
+
+        coords[axis] = (int) floorf((point[axis] - grid->min[axis]) * grid->inv_cell_size[axis]);
+
+        // Only unbounded lights reach past the grid.
+        if(coords[axis] < 0 || coords[axis] >= grid->dims[axis]){
+
+            *num_lights = grid->num_unbounded;
+
+            return grid->unbounded;
+        }
+    }
+
+    int cell = (coords[2] * grid->dims[1] + coords[1]) * grid->dims[0] + coords[0];
+
+    *num_lights = grid->cell_start[cell + 1] - grid->cell_start[cell];
+
+    return &grid->cell_lights[grid->cell_start[cell]];
+}
@@ -0,0 +1,47 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include <stdbool.h>
+
+#include "scene.h"
+
+// Lights bucketed by the part of space they can light, so a hit only looks
+// at lights that might reach it. A light reaches as far as its radial
+// attenuation 1 / (a2 d^2 + a1 d + a0) stays at or above the cutoff; with a
+// cutoff of 0, or coefficients that never fall that low, it reaches
+// everywhere. Lights with a finite reach are put in every cell of a uniform
+// grid their sphere of influence touches, and spot lights only in the
+// cells their cone can see. Lists are kept in scene order so lights are
+// summed in the same order as without the grid.
+typedef struct {
+
+    // Per light: how far it reaches (INFINITY when unbounded) and the
+    // square of that, for rejecting hits before a shadow ray is cast.
+    float *radius;
+    float *radius_squared;
+
+    float min[3];
+    float inv_cell_size[3];
+    int dims[3];
+
+    // Cell c lists cell_lights[cell_start[c]] .. cell_lights[cell_start[c + 1] - 1].
+    int *cell_start;
+    int *cell_lights;
+
+    // Lights that reach everywhere, which is all that points outside the
+    // grid can see.
+    int *unbounded;
+    int num_unbounded;
+
+} light_grid;
+
+// Builds the grid for the lights of current_scene. Returns false if memory
+// runs out.
+bool light_grid_build(light_grid *grid, scene *current_scene, float cutoff);
+
+void light_grid_free(light_grid *grid);
+
+// The lights that may reach point, in scene order.
+const int *light_grid_lookup(const light_grid *grid, const float *point, int *num_lights);
+
+#endif
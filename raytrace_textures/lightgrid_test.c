@@ -0,0 +1,161 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lightgrid.h"
+
+// Checks the light grid on lights strung out along one axis, which gives a
+// grid thousands of cells long on that axis and one cell on the others: it
+// must stay within its cell budget, and every point must still see every
+// light that reaches it. Prints each failure and exits with 1 if there
+// were any.
+
+// The budget in lightgrid.c.
+#define TEST_MAX_CELLS 4096
+
+#define TEST_PROBES 20000
+
+int test_failures = 0;
+
+// A point light at position that reaches exactly 1 at a cutoff of 1.
+light test_light(float x, float y, float z){
+
+    light result;
+    memset(&result, 0, sizeof(light));
+
+    result.color[0] = result.color[1] = result.color[2] = 1;
+    result.center[0] = x;
+    result.center[1] = y;
+    result.center[2] = z;
+    result.radial[2] = 1;
+
+    return result;
+}
+
+void check_grid(const char *name, light *lights, int num_lights, const float *from, const float *to){
+
+    scene current_scene;
+    memset(&current_scene, 0, sizeof(scene));
+
+    current_scene.light_list = lights;
+    current_scene.num_lights = num_lights;
+    current_scene.light_capacity = num_lights;
+
+    light_grid grid;
+
+    if(!light_grid_build(&grid, &current_scene, 1)){
+
+        printf("Error: Memory allocation for the light grid has failed!\n");
+        exit(1);
+    }
+
+    long num_cells = (long) grid.dims[0] * grid.dims[1] * grid.dims[2];
+
+    if(num_cells > TEST_MAX_CELLS){
+
+        printf("FAIL %s: %d x %d x %d cells, more than %d\n", name, grid.dims[0], grid.dims[1], grid.dims[2],
+               TEST_MAX_CELLS);
+        test_failures++;
+    }
+
+    // Probe points along the line, past both ends, and check that the
+    // lookup lists every light within reach.
+    for(int probe = 0; probe <= TEST_PROBES; probe++){
+
+        float point[3];
+
+        for(int axis = 0; axis < 3; axis++){
+
+            float t = -0.01f + 1.02f * probe / TEST_PROBES;
+            point[axis] = from[axis] + t * (to[axis] - from[axis]);
+        }
+
+        int num_near;
+        const int *near = light_grid_lookup(&grid, point, &num_near);
+
+        for(int light_index = 0; light_index < num_lights; light_index++){
+
+            float distance_squared = 0;
+
+            for(int axis = 0; axis < 3; axis++){
+
+                float offset = point[axis] - lights[light_index].center[axis];
+                distance_squared += offset * offset;
+            }
+
+            if(distance_squared > grid.radius_squared[light_index]){
+
+                continue;
+            }
+
+            bool listed = false;
+
+            for(int near_index = 0; near_index < num_near; near_index++){
+
+                listed = listed || near[near_index] == light_index;
+            }
+
+            if(!listed){
+
+                printf("FAIL %s: light %d reaches (%g, %g, %g) but is not listed there\n", name, light_index,
+                       point[0], point[1], point[2]);
+                test_failures++;
+
+                break;
+            }
+        }
+    }
+
+    light_grid_free(&grid);
+}
+
+void test_strung_lights(){
+
+    const char *axis_names[3] = {"x", "y", "z"};
+
+    for(int axis = 0; axis < 3; axis++){
+
+        float from[3] = {0, 0, 0};
+        float to[3] = {0, 0, 0};
+        char name[64];
+
+        // Two lights far apart: about 5000 cells along the axis.
+        to[axis] = 10000;
+
+        light pair[2] = {test_light(from[0], from[1], from[2]), test_light(to[0], to[1], to[2])};
+
+        snprintf(name, sizeof(name), "two lights along %s", axis_names[axis]);
+        check_grid(name, pair, 2, from, to);
+
+        // A row of them, each just reaching the next.
+        light row[64];
+
+        for(int light_index = 0; light_index < 64; light_index++){
+
+            float position[3] = {0, 0, 0};
+            position[axis] = 2 * light_index;
+
+            row[light_index] = test_light(position[0], position[1], position[2]);
+        }
+
+        to[axis] = 2 * 63;
+
+        snprintf(name, sizeof(name), "a row of lights along %s", axis_names[axis]);
+        check_grid(name, row, 64, from, to);
+    }
+}
+
+int main(){
+
+    test_strung_lights();
+
+    if(test_failures > 0){
+
+        printf("lightgrid_test: %d failures\n", test_failures);
+        return 1;
+    }
+
+    printf("lightgrid_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,1143 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene.h"
+#include "mesh.h"
+
+// Triangles per BVH leaf; one SSE test covers a full leaf.
+#define MESH_LEAF_SIZE 4
+
+// Deeper subtrees become leaves however many triangles they hold, which
+// bounds the traversal stack.
+#define MESH_MAX_DEPTH 48
+
+// Longest OBJ or PLY header line, and most vertices in one face.
+#define MESH_LINE_SIZE 4096
+#define MESH_MAX_FACE 256
+
+
+// Growable arrays filled while a file is read.
+typedef struct {
+
+    float *positions;
+    int num_positions;
+    int positions_capacity;
+
+    float *uvs;
+    int num_uvs;
+    int uvs_capacity;
+
+    uint32_t *indices;
+    int num_indices;
+    int indices_capacity;
+
+} mesh_buffers;
+
+bool push_float(float **list, int *count, int *capacity, float value){
+
+    if(!grow_list((void **) list, *count, capacity, sizeof(float))){
+
+        return false;
+    }
+
+    (*list)[*count] = value;
+    (*count)++;
+
+    return true;
+}
+
+bool push_index(mesh_buffers *buffers, uint32_t value){
+
+    if(!grow_list((void **) &buffers->indices, buffers->num_indices, &buffers->indices_capacity,
+                  sizeof(uint32_t))){
+
+        return false;
+    }
+
+    buffers->indices[buffers->num_indices] = value;
+    buffers->num_indices++;
+
+    return true;
+}
+
+// Adds the triangles of a face as a fan around its first corner.
+bool push_face(mesh_buffers *buffers, uint32_t *corners, int num_corners){
+
+    for(int corner = 2; corner < num_corners; corner++){
+
+        if(!push_index(buffers, corners[0]) || !push_index(buffers, corners[corner - 1]) ||
+           !push_index(buffers, corners[corner])){
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// OBJ faces index positions and texture coordinates separately, so each
+// distinct pair becomes one vertex of the buffer. Open-addressed map from
+// pair to vertex.
+typedef struct {
+
+    uint64_t *keys;
+    uint32_t *vertices;
+    size_t capacity;
+    size_t count;
+
+} vertex_map;
+
+// Returns the vertex for key, adding it to out with the position and
+// texture coordinate it names, or -1 if memory runs out.
+int64_t map_vertex(vertex_map *map, uint64_t key, mesh_buffers *obj, mesh_buffers *out){
+
+    if(map->count * 2 >= map->capacity){
+
+        size_t new_capacity = map->capacity == 0 ? 1024 : map->capacity * 2;
+        uint64_t *keys = malloc(sizeof(uint64_t) * new_capacity);
+        uint32_t *vertices = malloc(sizeof(uint32_t) * new_capacity);
+
+        if(keys == NULL || vertices == NULL){
+
+            free(keys);
+            free(vertices);
+
+            return -1;
+        }
+
+        memset(keys, 0xff, sizeof(uint64_t) * new_capacity);
+
+        for(size_t slot = 0; slot < map->capacity; slot++){
+
+            if(map->keys[slot] == UINT64_MAX){
+
+                continue;
+            }
+
+            size_t new_slot = (map->keys[slot] * 0x9e3779b97f4a7c15ULL) & (new_capacity - 1);
+
+            while(keys[new_slot] != UINT64_MAX){
+
+                new_slot = (new_slot + 1) & (new_capacity - 1);
+            }
+
+            keys[new_slot] = map->keys[slot];
+            vertices[new_slot] = map->vertices[slot];
+        }
+
+        free(map->keys);
+        free(map->vertices);
+
+        map->keys = keys;
+        map->vertices = vertices;
+        map->capacity = new_capacity;
+    }
+
+    size_t slot = (key * 0x9e3779b97f4a7c15ULL) & (map->capacity - 1);
+
+    while(map->keys[slot] != UINT64_MAX){
+
+        if(map->keys[slot] == key){
+
+            return map->vertices[slot];
+        }
+
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+
+    uint32_t position = key >> 32;
+    uint32_t uv = (uint32_t) key;
+    uint32_t vertex = out->num_positions / 3;
+
+    for(int axis = 0; axis < 3; axis++){
+
+        if(!push_float(&out->positions, &out->num_positions, &out->positions_capacity,
+                       obj->positions[position * 3 + axis])){
+
+            return -1;
+        }
+    }
+
+    // uv 0 means the corner had no texture coordinate.
+    for(int axis = 0; axis < 2; axis++){
+
+        if(!push_float(&out->uvs, &out->num_uvs, &out->uvs_capacity,
+                       uv > 0 ? obj->uvs[(uv - 1) * 2 + axis] : 0)){
+
+            return -1;
+        }
+    }
+
+    map->keys[slot] = key;
+    map->vertices[slot] = vertex;
+    map->count++;
+
+    return vertex;
+}
+
+// Resolves a 1-based or negative (relative) OBJ index into 0-based, or -1
+// if it is out of range.
+long obj_index(long index, int count){
+
+    if(index < 0){
+
+        index += count;
+
+    } else {
+
+        index--;
+    }
+
+    return index >= 0 && index < count ? index : -1;
+}
+
+rt_status read_obj(FILE *fp, const char *filename, mesh_buffers *out, rt_error *error){
+
+    mesh_buffers obj = {0};
+    vertex_map map = {NULL, NULL, 0, 0};
+    rt_status status = RT_OK;
+    bool any_uvs = false;
+
+    char line[MESH_LINE_SIZE];
+    int line_number = 0;
+
+    while(status == RT_OK && fgets(line, sizeof(line), fp) != NULL){
+
+        line_number++;
+
+        float x;
+        float y;
+        float z;
+
+        if(strncmp(line, "v ", 2) == 0){
+
+            if(sscanf(line + 2, "%f %f %f", &x, &y, &z) != 3){
+
+                status = set_error(error, RT_ERROR_PARSE, "%s:%d: a vertex needs x, y and z.", filename, line_number);
+
+            } else if(!push_float(&obj.positions, &obj.num_positions, &obj.positions_capacity, x) ||
+                      !push_float(&obj.positions, &obj.num_positions, &obj.positions_capacity, y) ||
+                      !push_float(&obj.positions, &obj.num_positions, &obj.positions_capacity, z)){
+
+                status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for %s has failed!", filename);
+            }
+
+        } else if(strncmp(line, "vt ", 3) == 0){
+
+            if(sscanf(line + 3, "%f %f", &x, &y) != 2){
+
+                status = set_error(error, RT_ERROR_PARSE, "%s:%d: a texture coordinate needs u and v.",
+                                   filename, line_number);
+
+            } else if(!push_float(&obj.uvs, &obj.num_uvs, &obj.uvs_capacity, x) ||
+                      !push_float(&obj.uvs, &obj.num_uvs, &obj.uvs_capacity, y)){
+
+                status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for %s has failed!", filename);
+            }
+
+        } else if(strncmp(line, "f ", 2) == 0){
+
+            uint32_t corners[MESH_MAX_FACE];
+            int num_corners = 0;
+            char *cursor = line + 2;
+            char *token;
+
+            while(status == RT_OK && (token = strtok(cursor, " \t\r\n")) != NULL){
+
+                cursor = NULL;
+
+                // v, v/vt, v//vn or v/vt/vn; normals are ignored.
+                long position = obj_index(strtol(token, &token, 10), obj.num_positions / 3);
+                bool has_uv = *token == '/' && token[1] != '/';
+                long uv = has_uv ? obj_index(strtol(token + 1, NULL, 10), obj.num_uvs / 2) : 0;
+
+                if(position < 0 || uv < 0 || num_corners == MESH_MAX_FACE){
+
+                    status = set_error(error, RT_ERROR_PARSE, "%s:%d: bad face.", filename, line_number);
+
+                    break;
+                }
+
+                any_uvs |= has_uv;
+
+                // The uv is stored 1-based so 0 can mean none.
+                uint64_t key = ((uint64_t) position << 32) | (uint32_t) (has_uv ? uv + 1 : 0);
+
+                int64_t vertex = map_vertex(&map, key, &obj, out);
+
+                if(vertex < 0){
+
+                    status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for %s has failed!", filename);
+
+                    break;
+                }
+
+                corners[num_corners] = vertex;
+                num_corners++;
+            }
+
+            if(status == RT_OK && num_corners < 3){
+
+                status = set_error(error, RT_ERROR_PARSE, "%s:%d: a face needs three vertices.", filename,
+                                   line_number);
+            }
+
+            if(status == RT_OK && !push_face(out, corners, num_corners)){
+
+                status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for %s has failed!", filename);
+            }
+        }
+
+        // Normals, groups, materials and the rest are ignored.
+    }
+
+    if(!any_uvs){
+
+        free(out->uvs);
+        out->uvs = NULL;
+        out->num_uvs = 0;
+    }
+
+    free(obj.positions);
+    free(obj.uvs);
+    free(map.keys);
+    free(map.vertices);
+
+    return status;
+}
+
+
+enum ply_type{PlyInt8, PlyUint8, PlyInt16, PlyUint16, PlyInt32, PlyUint32, PlyFloat32, PlyFloat64};
+
+// What a vertex property feeds.
+enum ply_role{PlyIgnored, PlyX, PlyY, PlyZ, PlyU, PlyV, PlyFaceIndices};
+
+typedef struct {
+
+    enum ply_type type;
+
+    // Lists have a count of count_type followed by that many values.
+    bool is_list;
+    enum ply_type count_type;
+
+    enum ply_role role;
+
+} ply_property;
+
+typedef struct {
+
+    char name[64];
+    long count;
+
+    ply_property properties[32];
+    int num_properties;
+
+} ply_element;
+
+bool ply_parse_type(const char *name, enum ply_type *type){
+
+    const char *names[][2] = {{"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+                              {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"},
+                              {"double", "float64"}};
+
+    for(int index = 0; index < 8; index++){
+
+        if(strcmp(name, names[index][0]) == 0 || strcmp(name, names[index][1]) == 0){
+
+            *type = index;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Reads one value of type. Binary files are assumed to match the host's
+// little-endian byte order.
+bool ply_read_value(FILE *fp, bool binary, enum ply_type type, double *value){
+
+    if(!binary){
+
+        return fscanf(fp, "%lf", value) == 1;
+    }
+
+    const int sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+    uint8_t bytes[8];
+
+    if(fread(bytes, sizes[type], 1, fp) != 1){
+
+        return false;
+    }
+
+    int8_t i8;
+    int16_t i16;
+    uint16_t u16;
+    int32_t i32;
+    uint32_t u32;
+    float f32;
+    double f64;
+
+    switch(type){
+
+        case PlyInt8: memcpy(&i8, bytes, 1); *value = i8; break;
+        case PlyUint8: *value = bytes[0]; break;
+        case PlyInt16: memcpy(&i16, bytes, 2); *value = i16; break;
+        case PlyUint16: memcpy(&u16, bytes, 2); *value = u16; break;
+        case PlyInt32: memcpy(&i32, bytes, 4); *value = i32; break;
+        case PlyUint32: memcpy(&u32, bytes, 4); *value = u32; break;
+        case PlyFloat32: memcpy(&f32, bytes, 4); *value = f32; break;
+        case PlyFloat64: memcpy(&f64, bytes, 8); *value = f64; break;
+    }
+
+    return true;
+}
+
+rt_status read_ply(FILE *fp, const char *filename, mesh_buffers *out, rt_error *error){
+
+    char line[MESH_LINE_SIZE];
+    bool binary = false;
+
+    ply_element elements[16];
+    int num_elements = 0;
+
+    if(fgets(line, sizeof(line), fp) == NULL || strncmp(line, "ply", 3) != 0){
+
+        return set_error(error, RT_ERROR_PARSE, "%s is not a PLY file.", filename);
+    }
+
+    while(true){
+
+        if(fgets(line, sizeof(line), fp) == NULL){
+
+            return set_error(error, RT_ERROR_PARSE, "%s: the header has no end_header.", filename);
+        }
+
+        char word[64];
+        char type_name[64];
+        char count_name[64];
+        char name[64];
+        long count;
+
+        if(strncmp(line, "end_header", 10) == 0){
+
+            break;
+
+        } else if(sscanf(line, "format %63s", word) == 1){
+
+            if(strcmp(word, "binary_little_endian") == 0){
+
+                binary = true;
+
+            } else if(strcmp(word, "ascii") != 0){
+
+                return set_error(error, RT_ERROR_PARSE, "%s: only ASCII and little-endian PLY are supported.",
+                                 filename);
+            }
+
+        } else if(sscanf(line, "element %63s %ld", name, &count) == 2){
+
+            if(num_elements == 16 || count < 0){
+
+                return set_error(error, RT_ERROR_PARSE, "%s: too many or bad elements.", filename);
+            }
+
+            ply_element *element = &elements[num_elements];
+            num_elements++;
+
+            strcpy(element->name, name);
+            element->count = count;
+            element->num_properties = 0;
+
+        } else if(strncmp(line, "property", 8) == 0){
+
+            if(num_elements == 0 || elements[num_elements - 1].num_properties == 32){
+
+                return set_error(error, RT_ERROR_PARSE, "%s: a property is out of place.", filename);
+            }
+
+            ply_element *element = &elements[num_elements - 1];
+            ply_property *property = &element->properties[element->num_properties];
+
+            property->is_list = false;
+            property->role = PlyIgnored;
+
+            if(sscanf(line, "property list %63s %63s %63s", count_name, type_name, name) == 3){
+
+                property->is_list = true;
+
+                if(!ply_parse_type(count_name, &property->count_type)){
+
+                    return set_error(error, RT_ERROR_PARSE, "%s: unknown type %s.", filename, count_name);
+                }
+
+            } else if(sscanf(line, "property %63s %63s", type_name, name) != 2){
+
+                return set_error(error, RT_ERROR_PARSE, "%s: bad property line.", filename);
+            }
+
+            if(!ply_parse_type(type_name, &property->type)){
+
+                return set_error(error, RT_ERROR_PARSE, "%s: unknown type %s.", filename, type_name);
+            }
+
+            if(strcmp(element->name, "vertex") == 0 && !property->is_list){
+
+                if(strcmp(name, "x") == 0){
+                    property->role = PlyX;
+                } else if(strcmp(name, "y") == 0){
+                    property->role = PlyY;
+                } else if(strcmp(name, "z") == 0){
+                    property->role = PlyZ;
+                } else if(strcmp(name, "u") == 0 || strcmp(name, "s") == 0 || strcmp(name, "texture_u") == 0){
+                    property->role = PlyU;
+                } else if(strcmp(name, "v") == 0 || strcmp(name, "t") == 0 || strcmp(name, "texture_v") == 0){
+                    property->role = PlyV;
+                }
+            }
+
+            if(strcmp(element->name, "face") == 0 && property->is_list &&
+               (strcmp(name, "vertex_indices") == 0 || strcmp(name, "vertex_index") == 0)){
+
+                property->role = PlyFaceIndices;
+            }
+
+            element->num_properties++;
+        }
+
+        // comment and obj_info lines are skipped.
+    }
+
+    long num_vertices = 0;
+    bool has_uvs = false;
+
+    for(int index = 0; index < num_elements; index++){
+
+        if(strcmp(elements[index].name, "vertex") == 0){
+
+            num_vertices = elements[index].count;
+
+            for(int property = 0; property < elements[index].num_properties; property++){
+
+                has_uvs |= elements[index].properties[property].role == PlyU;
+            }
+        }
+    }
+
+    for(int index = 0; index < num_elements; index++){
+
+        ply_element *element = &elements[index];
+        bool is_vertex = strcmp(element->name, "vertex") == 0;
+
+        for(long item = 0; item < element->count; item++){
+
+            float vertex[5] = {0, 0, 0, 0, 0};
+            uint32_t corners[MESH_MAX_FACE];
+            int num_corners = 0;
+
+            for(int property_index = 0; property_index < element->num_properties; property_index++){
+
+                ply_property *property = &element->properties[property_index];
+                double value;
+
+                if(!property->is_list){
+
+                    if(!ply_read_value(fp, binary, property->type, &value)){
+
+                        return set_error(error, RT_ERROR_PARSE, "%s: the file ends early.", filename);
+                    }
+
+                    if(property->role >= PlyX && property->role <= PlyV){
+
+                        vertex[property->role - PlyX] = value;
+                    }
+
+                    continue;
+                }
+
+                double list_count;
+
+                if(!ply_read_value(fp, binary, property->count_type, &list_count)){
+
+                    return set_error(error, RT_ERROR_PARSE, "%s: the file ends early.", filename);
+                }
+
+                for(long entry = 0; entry < (long) list_count; entry++){
+
+                    if(!ply_read_value(fp, binary, property->type, &value)){
+
+                        return set_error(error, RT_ERROR_PARSE, "%s: the file ends early.", filename);
+                    }
+
+                    if(property->role != PlyFaceIndices){
+
+                        continue;
+                    }
+
+                    if(value < 0 || value >= num_vertices || num_corners == MESH_MAX_FACE){
+
+                        return set_error(error, RT_ERROR_PARSE, "%s: face %ld is bad.", filename, item);
+                    }
+
+                    corners[num_corners] = value;
+                    num_corners++;
+                }
+            }
+
+            bool pushed = true;
+
+            if(is_vertex){
+
+                for(int axis = 0; axis < 3; axis++){
+
+                    pushed = pushed && push_float(&out->positions, &out->num_positions,
+                                                  &out->positions_capacity, vertex[axis]);
+                }
+
+                for(int axis = 0; has_uvs && axis < 2; axis++){
+
+                    pushed = pushed && push_float(&out->uvs, &out->num_uvs, &out->uvs_capacity,
+                                                  vertex[3 + axis]);
+                }
+
+            } else if(num_corners >= 3){
+
+                pushed = push_face(out, corners, num_corners);
+            }
+
+            if(!pushed){
+
+                return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for %s has failed!", filename);
+            }
+        }
+    }
+
+    return RT_OK;
+}
+
+
+// Scratch space for building the BVH.
+typedef struct {
+
+    triangle_mesh *loaded;
+    float *centroids;
+    int *order;
+
+} bvh_builder;
+
+void build_node(bvh_builder *builder, int node_index, int first, int count, int depth){
+
+    triangle_mesh *loaded = builder->loaded;
+    mesh_node *node = &loaded->nodes[node_index];
+
+    float centroid_lo[3] = {INFINITY, INFINITY, INFINITY};
+    float centroid_hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    for(int axis = 0; axis < 3; axis++){
+
+        node->lo[axis] = INFINITY;
+        node->hi[axis] = -INFINITY;
+    }
+
+    for(int index = first; index < first + count; index++){
+
+        int triangle = builder->order[index];
+
+        for(int corner = 0; corner < 3; corner++){
+
+            float *position = &loaded->positions[loaded->indices[triangle * 3 + corner] * 3];
+
+            for(int axis = 0; axis < 3; axis++){
+
+                node->lo[axis] = fminf(node->lo[axis], position[axis]);
+                node->hi[axis] = fmaxf(node->hi[axis], position[axis]);
+            }
+        }
+
+        for(int axis = 0; axis < 3; axis++){
+
+            centroid_lo[axis] = fminf(centroid_lo[axis], builder->centroids[triangle * 3 + axis]);
+            centroid_hi[axis] = fmaxf(centroid_hi[axis], builder->centroids[triangle * 3 + axis]);
+        }
+    }
+
+    int axis = 0;
+
+    for(int other = 1; other < 3; other++){
+
+        if(centroid_hi[other] - centroid_lo[other] > centroid_hi[axis] - centroid_lo[axis]){
+
+            axis = other;
+        }
+    }
+
+    if(count <= MESH_LEAF_SIZE || depth >= MESH_MAX_DEPTH || centroid_hi[axis] <= centroid_lo[axis]){
+
+        node->first = first;
+        node->count = count;
+
+        return;
+    }
+
+    // Split at the middle of the centroids along their longest axis.
+    float middle = (centroid_lo[axis] + centroid_hi[axis]) / 2;
+    int left = first;
+    int right = first + count - 1;
+
+    while(left <= right){
+
+        if(builder->centroids[builder->order[left] * 3 + axis] < middle){
+
+            left++;
+
+        } else {
+
+            int swap = builder->order[left];
+            builder->order[left] = builder->order[right];
+            builder->order[right] = swap;
+            right--;
+        }
+    }
+
+    int split = left - first;
+
+    if(split == 0 || split == count){
+
+        split = count / 2;
+    }
+
+    int children = loaded->num_nodes;
+    loaded->num_nodes += 2;
+
+    node->first = children;
+    node->count = 0;
+
+    build_node(builder, children, first, split, depth + 1);
+    build_node(builder, children + 1, first + split, count - split, depth + 1);
+}
+
+// Builds the BVH and reorders the triangles to match its leaves.
+bool build_bvh(triangle_mesh *loaded){
+
+    int num_triangles = loaded->num_triangles;
+
+    bvh_builder builder = {loaded, malloc(sizeof(float) * 3 * num_triangles), malloc(sizeof(int) * num_triangles)};
+
+    loaded->nodes = malloc(sizeof(mesh_node) * (2 * num_triangles - 1));
+    uint32_t *indices = malloc(sizeof(uint32_t) * 3 * num_triangles);
+
+    if(builder.centroids == NULL || builder.order == NULL || loaded->nodes == NULL || indices == NULL){
+
+        free(builder.centroids);
+        free(builder.order);
+        free(indices);
+
+        return false;
+    }
+
+    for(int triangle = 0; triangle < num_triangles; triangle++){
+
+        builder.order[triangle] = triangle;
+
+        for(int axis = 0; axis < 3; axis++){
+
+            float sum = 0;
+
+            for(int corner = 0; corner < 3; corner++){
+
+                sum += loaded->positions[loaded->indices[triangle * 3 + corner] * 3 + axis];
+            }
+
+            builder.centroids[triangle * 3 + axis] = sum / 3;
+        }
+    }
+
+    loaded->num_nodes = 1;
+
+    build_node(&builder, 0, 0, num_triangles, 0);
+
+    for(int index = 0; index < num_triangles; index++){
+
+        memcpy(&indices[index * 3], &loaded->indices[builder.order[index] * 3], sizeof(uint32_t) * 3);
+    }
+
+    free(loaded->indices);
+    loaded->indices = indices;
+
+    free(builder.centroids);
+    free(builder.order);
+
+    return true;
+}
+
+rt_status read_mesh(const char *filename, triangle_mesh *loaded, rt_error *error){
+
+    size_t length = strlen(filename);
+    bool is_ply = length > 4 && strcmp(&filename[length - 4], ".ply") == 0;
+
+    if(!is_ply && (length <= 4 || strcmp(&filename[length - 4], ".obj") != 0)){
+
+        return set_error(error, RT_ERROR_INVALID_ARGUMENT, "%s should be an .obj or .ply mesh.", filename);
+    }
+
+    FILE *fp = fopen(filename, is_ply ? "rb" : "r");
+
+    if(fp == NULL){
+
+        return set_error(error, RT_ERROR_IO, "Could not open the mesh %s.", filename);
+    }
+
+    mesh_buffers buffers = {0};
+
+    loaded->nodes = NULL;
+    loaded->num_nodes = 0;
+
+    rt_status status = is_ply ? read_ply(fp, filename, &buffers, error) : read_obj(fp, filename, &buffers, error);
+
+    fclose(fp);
+
+    loaded->positions = buffers.positions;
+    loaded->uvs = buffers.uvs;
+    loaded->indices = buffers.indices;
+    loaded->num_vertices = buffers.num_positions / 3;
+    loaded->num_triangles = buffers.num_indices / 3;
+
+    if(status == RT_OK && loaded->num_triangles == 0){
+
+        status = set_error(error, RT_ERROR_PARSE, "The mesh %s has no faces.", filename);
+    }
+
+    if(status == RT_OK && !build_bvh(loaded)){
+
+        status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for %s has failed!", filename);
+    }
+
+    if(status != RT_OK){
+
+        free_mesh(loaded);
+    }
+
+    return status;
+}
+
+void free_mesh(triangle_mesh *loaded){
+
+    free(loaded->positions);
+    free(loaded->uvs);
+    free(loaded->indices);
+    free(loaded->nodes);
+
+    loaded->positions = NULL;
+    loaded->uvs = NULL;
+    loaded->indices = NULL;
+    loaded->nodes = NULL;
+}
+
+
+// The per-ray part of the watertight test: the ray is sheared so it runs
+// along +z, which makes the edge tests 2D and exact in sign.
+typedef struct {
+
+    float origin[3];
+    float inv_dir[3];
+
+    int kx;
+    int ky;
+    int kz;
+
+    float sx;
+    float sy;
+    float sz;
+
+} mesh_ray;
+
+void setup_ray(mesh_ray *ray, const float *ro, const float *rd){
+
+    ray->kz = 0;
+
+    for(int axis = 1; axis < 3; axis++){
+
+        if(fabsf(rd[axis]) > fabsf(rd[ray->kz])){
+
+            ray->kz = axis;
+        }
+    }
+
+    ray->kx = (ray->kz + 1) % 3;
+    ray->ky = (ray->kx + 1) % 3;
+
+    // Keeps the winding, and so the sign of the edge tests, the same.
+    if(rd[ray->kz] < 0){
+
+        int swap = ray->kx;
+        ray->kx = ray->ky;
+        ray->ky = swap;
+    }
+
+    ray->sx = rd[ray->kx] / rd[ray->kz];
+    ray->sy = rd[ray->ky] / rd[ray->kz];
+    ray->sz = 1 / rd[ray->kz];
+
+    for(int axis = 0; axis < 3; axis++){
+
+        ray->origin[axis] = ro[axis];
+        ray->inv_dir[axis] = 1 / rd[axis];
+    }
+}
+
+// Entry distance of the ray into node's box if it is nearer than best_t,
+// or INFINITY.
+float node_entry(const mesh_node *node, const mesh_ray *ray, float best_t){
+
+    float t_near = 0;
+    float t_far = best_t;
+
+    for(int axis = 0; axis < 3; axis++){
+
+        float t0 = (node->lo[axis] - ray->origin[axis]) * ray->inv_dir[axis];
+        float t1 = (node->hi[axis] - ray->origin[axis]) * ray->inv_dir[axis];
+
+        t_near = fmaxf(t_near, fminf(t0, t1));
+        t_far = fminf(t_far, fmaxf(t0, t1));
+    }
+
+    return t_near <= t_far ? t_near : INFINITY;
+}
+
+// Tests up to four triangles, first .. first + count - 1, and records the
+// nearest hit closer than *best_t.
+void test_triangles(const triangle_mesh *loaded, const mesh_ray *ray, int first, int count, float *best_t,
+                    mesh_hit *hit){
+
+    // Corners relative to the ray origin, lane per triangle, permuted into
+    // the ray's axes. Unused lanes repeat the first triangle.
+    float corner_x[3][4];
+    float corner_y[3][4];
+    float corner_z[3][4];
+
+    for(int lane = 0; lane < 4; lane++){
+
+        int triangle = first + (lane < count ? lane : 0);
+
+        for(int corner = 0; corner < 3; corner++){
+
+            const float *position = &loaded->positions[loaded->indices[triangle * 3 + corner] * 3];
+
+            corner_x[corner][lane] = position[ray->kx] - ray->origin[ray->kx];
+            corner_y[corner][lane] = position[ray->ky] - ray->origin[ray->ky];
+            corner_z[corner][lane] = position[ray->kz] - ray->origin[ray->kz];
+        }
+    }
+
+    float t[4];
+    float edge[3][4];
+    int valid = 0;
+
+#ifdef VEC3_SSE
+    __m128 sx = _mm_set1_ps(ray->sx);
+    __m128 sy = _mm_set1_ps(ray->sy);
+    __m128 sz = _mm_set1_ps(ray->sz);
+
+    __m128 x[3];
+    __m128 y[3];
+
+    for(int corner = 0; corner < 3; corner++){
+
+        __m128 z = _mm_loadu_ps(corner_z[corner]);
+
+        x[corner] = _mm_sub_ps(_mm_loadu_ps(corner_x[corner]), _mm_mul_ps(sx, z));
+        y[corner] = _mm_sub_ps(_mm_loadu_ps(corner_y[corner]), _mm_mul_ps(sy, z));
+    }
+
+    // Twice the signed areas seen from the ray; all one sign means inside.
+    __m128 u = _mm_sub_ps(_mm_mul_ps(x[2], y[1]), _mm_mul_ps(y[2], x[1]));
+    __m128 v = _mm_sub_ps(_mm_mul_ps(x[0], y[2]), _mm_mul_ps(y[0], x[2]));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(x[1], y[0]), _mm_mul_ps(y[1], x[0]));
+
+    __m128 zero = _mm_setzero_ps();
+
+    __m128 any_negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+    __m128 any_positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(u, v), w);
+
+    __m128 scaled_t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(sz, _mm_loadu_ps(corner_z[0]))),
+                                            _mm_mul_ps(v, _mm_mul_ps(sz, _mm_loadu_ps(corner_z[1])))),
+                                 _mm_mul_ps(w, _mm_mul_ps(sz, _mm_loadu_ps(corner_z[2]))));
+
+    __m128 lane_t = _mm_div_ps(scaled_t, det);
+
+    __m128 inside = _mm_andnot_ps(_mm_and_ps(any_negative, any_positive), _mm_cmpneq_ps(det, zero));
+    __m128 ahead = _mm_and_ps(_mm_cmpgt_ps(lane_t, zero), _mm_cmplt_ps(lane_t, _mm_set1_ps(*best_t)));
+
+    valid = _mm_movemask_ps(_mm_and_ps(inside, ahead));
+
+    _mm_storeu_ps(t, lane_t);
+    _mm_storeu_ps(edge[0], u);
+    _mm_storeu_ps(edge[1], v);
+    _mm_storeu_ps(edge[2], w);
+#else
+    for(int lane = 0; lane < 4; lane++){
+
+        float x[3];
+        float y[3];
+
+        for(int corner = 0; corner < 3; corner++){
+
+            x[corner] = corner_x[corner][lane] - ray->sx * corner_z[corner][lane];
+            y[corner] = corner_y[corner][lane] - ray->sy * corner_z[corner][lane];
+        }
+
+        float u = x[2] * y[1] - y[2] * x[1];
+        float v = x[0] * y[2] - y[0] * x[2];
+        float w = x[1] * y[0] - y[1] * x[0];
+
+        float det = u + v + w;
+
+        t[lane] = (u * (ray->sz * corner_z[0][lane]) + v * (ray->sz * corner_z[1][lane]) +
+                   w * (ray->sz * corner_z[2][lane])) / det;
+
+        edge[0][lane] = u;
+        edge[1][lane] = v;
+        edge[2][lane] = w;
+
+        bool inside = !((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) && det != 0;
+
+        if(inside && t[lane] > 0 && t[lane] < *best_t){
+
+            valid |= 1 << lane;
+        }
+    }
+#endif
+
+    for(int lane = 0; lane < count; lane++){
+
+        if((valid & (1 << lane)) && t[lane] < *best_t){
+
+            *best_t = t[lane];
+
+            if(hit != NULL){
+
+                float det = edge[0][lane] + edge[1][lane] + edge[2][lane];
+
+                hit->triangle = first + lane;
+
+                for(int corner = 0; corner < 3; corner++){
+
+                    hit->weights[corner] = edge[corner][lane] / det;
+                }
+            }
+        }
+    }
+}
+
+float mesh_intersection(const triangle_mesh *loaded, const float *ro, const float *rd, mesh_hit *hit,
+                        long *tests){
+
+    mesh_ray ray;
+    setup_ray(&ray, ro, rd);
+
+    float best_t = INFINITY;
+
+    int stack[MESH_MAX_DEPTH * 2 + 2];
+    int top = 0;
+
+    if(node_entry(&loaded->nodes[0], &ray, best_t) < INFINITY){
+
+        stack[top] = 0;
+        top++;
+    }
+
+    while(top > 0){
+
+        top--;
+
+        const mesh_node *node = &loaded->nodes[stack[top]];
+
+        // The node may have been pushed before a nearer hit was found.
+        if(node_entry(node, &ray, best_t) == INFINITY){
+
+            continue;
+        }
+
+        if(node->count > 0){
+
+            for(int first = node->first; first < node->first + node->count; first += 4){
+
+                int count = node->first + node->count - first;
+
+                test_triangles(loaded, &ray, first, count < 4 ? count : 4, &best_t, hit);
+            }
+
+            *tests += node->count;
+
+            continue;
+        }
+
+        // Visit the nearer child first so its hits prune the other.
+        float near_t = node_entry(&loaded->nodes[node->first], &ray, best_t);
+        float far_t = node_entry(&loaded->nodes[node->first + 1], &ray, best_t);
+        int near_child = node->first;
+        int far_child = node->first + 1;
+
+        if(far_t < near_t){
+
+            float swap_t = near_t;
+            near_t = far_t;
+            far_t = swap_t;
+
+            near_child = node->first + 1;
+            far_child = node->first;
+        }
+
+        if(far_t < INFINITY){
+
+            stack[top] = far_child;
+            top++;
+        }
+
+        if(near_t < INFINITY){
+
+            stack[top] = near_child;
+            top++;
+        }
+    }
+
+    return best_t < INFINITY ? best_t : -1;
+}
+
+void mesh_normal(const triangle_mesh *loaded, const mesh_hit *hit, float *normal){
+
+    const uint32_t *corners = &loaded->indices[hit->triangle * 3];
+
+    float edge_1[3];
+    float edge_2[3];
+
+    v3_from_points(edge_1, &loaded->positions[corners[0] * 3], &loaded->positions[corners[1] * 3]);
+    v3_from_points(edge_2, &loaded->positions[corners[0] * 3], &loaded->positions[corners[2] * 3]);
+
+    v3_cross_product(normal, edge_1, edge_2);
+    v3_normalize(normal, normal);
+}
+
+void mesh_uv(const triangle_mesh *loaded, const mesh_hit *hit, float *uv){
+
+    uv[0] = 0;
+    uv[1] = 0;
+
+    if(loaded->uvs == NULL){
+
+        return;
+    }
+
+    const uint32_t *corners = &loaded->indices[hit->triangle * 3];
+
+    for(int corner = 0; corner < 3; corner++){
+
+        uv[0] += hit->weights[corner] * loaded->uvs[corners[corner] * 2];
+        uv[1] += hit->weights[corner] * loaded->uvs[corners[corner] * 2 + 1];
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rt.h"
+
+// Triangle meshes read from OBJ or PLY files. Each file is loaded once per
+// scene into an indexed vertex buffer, shared by every mesh entry that
+// names it; entries place it with their own position and scale.
+
+// A node of a mesh's bounding volume hierarchy. Leaves (count > 0) hold
+// triangles first .. first + count - 1; inner nodes (count 0) have their
+// children at first and first + 1.
+typedef struct {
+
+    float lo[3];
+    float hi[3];
+
+    int first;
+    int count;
+
+} mesh_node;
+
+typedef struct {
+
+    char *filename;
+
+    int num_vertices;
+    int num_triangles;
+
+    // 3 floats per vertex, 2 per vertex of texture coordinates (NULL if the
+    // file has none) and 3 vertex indices per triangle, in BVH leaf order.
+    float *positions;
+    float *uvs;
+    uint32_t *indices;
+
+    mesh_node *nodes;
+    int num_nodes;
+
+} triangle_mesh;
+
+// Where a ray hit a mesh: the triangle and the barycentric weight of each
+// of its vertices.
+typedef struct {
+
+    int triangle;
+    float weights[3];
+
+} mesh_hit;
+
+// Reads filename, an .obj or .ply (ASCII or binary little-endian), into
+// loaded and builds its BVH. Faces with more than three vertices are split
+// into fans. loaded->filename is left as it is; on failure nothing else is
+// kept.
+rt_status read_mesh(const char *filename, triangle_mesh *loaded, rt_error *error);
+
+// Frees what read_mesh() allocated, but not the filename.
+void free_mesh(triangle_mesh *loaded);
+
+// Distance along rd from ro, both in mesh space, to the nearest triangle in
+// front of ro, or -1 if there is none. Uses the watertight test of Woop,
+// Benthin and Wald, four triangles at a time with SSE, so rays through a
+// shared edge never slip between its triangles. hit may be NULL; tests is
+// increased by the number of triangles tested.
+float mesh_intersection(const triangle_mesh *loaded, const float *ro, const float *rd, mesh_hit *hit,
+                        long *tests);
+
+// Unit normal of the hit triangle, from its winding.
+void mesh_normal(const triangle_mesh *loaded, const mesh_hit *hit, float *normal);
+
+// Texture coordinates at the hit, interpolated from its vertices; 0, 0 if
+// the mesh has none.
+void mesh_uv(const triangle_mesh *loaded, const mesh_hit *hit, float *uv);
+
+#endif
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "net.h"
+
+// Fills address with a Unix socket path. Returns false if it doesn't fit.
+bool unix_address(const char *path, struct sockaddr_un *address){
+
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+
+    if(strlen(path) >= sizeof(address->sun_path)){
+
+        return false;
+    }
+
+    strcpy(address->sun_path, path);
+
+    return true;
+}
+
+// Resolves "HOST:PORT"; an empty host means every interface.
+struct addrinfo *tcp_address(const char *address, bool passive){
+
+    const char *colon = strrchr(address, ':');
+
+    if(colon == NULL){
+
+        return NULL;
+    }
+
+    char host[256];
+    snprintf(host, sizeof(host), "%.*s", (int) (colon - address), address);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    struct addrinfo *results;
+
+    if(getaddrinfo(host[0] != '\0' ? host : NULL, colon + 1, &hints, &results) != 0){
+
+        return NULL;
+    }
+
+    return results;
+}
+
+int net_listen(const char *address){
+
+    if(strncmp(address, "unix:", 5) == 0){
+
+        struct sockaddr_un unix_addr;
+
+        if(!unix_address(address + 5, &unix_addr)){
+
+            return -1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        unlink(address + 5);
+
+        if(fd < 0 || bind(fd, (struct sockaddr *) &unix_addr, sizeof(unix_addr)) != 0 || listen(fd, 64) != 0){
+
+            if(fd >= 0){
+
+                close(fd);
+            }
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    struct addrinfo *results = tcp_address(address, true);
+
+    for(struct addrinfo *result = results; result != NULL; result = result->ai_next){
+
+        int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+
+        if(fd < 0){
+
+            continue;
+        }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if(bind(fd, result->ai_addr, result->ai_addrlen) == 0 && listen(fd, 64) == 0){
+
+            freeaddrinfo(results);
+
+            return fd;
+        }
+
+        close(fd);
+    }
+
+    if(results != NULL){
+
+        freeaddrinfo(results);
+    }
+
+    return -1;
+}
+
+int net_connect(const char *address){
+
+    if(strncmp(address, "unix:", 5) == 0){
+
+        struct sockaddr_un unix_addr;
+
+        if(!unix_address(address + 5, &unix_addr)){
+
+            return -1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if(fd >= 0 && connect(fd, (struct sockaddr *) &unix_addr, sizeof(unix_addr)) != 0){
+
+            close(fd);
+
+            return -1;
+        }
+
+        return fd;
+    }
+
+    struct addrinfo *results = tcp_address(address, false);
+
+    for(struct addrinfo *result = results; result != NULL; result = result->ai_next){
+
+        int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+
+        if(fd < 0){
+
+            continue;
+        }
+
+        if(connect(fd, result->ai_addr, result->ai_addrlen) == 0){
+
+            freeaddrinfo(results);
+
+            return fd;
+        }
+
+        close(fd);
+    }
+
+    if(results != NULL){
+
+        freeaddrinfo(results);
+    }
+
+    return -1;
+}
+
+void net_unlink(const char *address){
+
+    if(strncmp(address, "unix:", 5) == 0){
+
+        unlink(address + 5);
+    }
+}
+
+bool net_set_timeout(int fd, int milliseconds){
+
+    struct timeval timeout;
+
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = milliseconds % 1000 * 1000;
+
+    return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0 &&
+           setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+}
+
+bool net_read_full(int fd, void *buffer, size_t length){
+
+    uint8_t *bytes = buffer;
+
+    while(length > 0){
+
+        ssize_t count = read(fd, bytes, length);
+
+        if(count < 0 && errno == EINTR){
+
+            continue;
+        }
+
+        if(count <= 0){
+
+            return false;
+        }
+
+        bytes += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+bool net_write_full(int fd, const void *buffer, size_t length){
+
+    const uint8_t *bytes = buffer;
+
+    while(length > 0){
+
+        ssize_t count = write(fd, bytes, length);
+
+        if(count < 0 && errno == EINTR){
+
+            continue;
+        }
+
+        if(count <= 0){
+
+            return false;
+        }
+
+        bytes += count;
+        length -= count;
+    }
+
+    return true;
+}
+
+bool net_read_line(int fd, char *line, size_t capacity){
+
+    size_t length = 0;
+
+    while(length + 1 < capacity){
+
+        if(!net_read_full(fd, &line[length], 1)){
+
+            return false;
+        }
+
+        if(line[length] == '\n'){
+
+            line[length] = '\0';
+
+            return true;
+        }
+
+        length++;
+    }
+
+    return false;
+}
@@ -0,0 +1,34 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Stream sockets for the distributed renderer. An address is either
+// "unix:PATH" for a Unix domain socket or "HOST:PORT" for TCP.
+
+// Returns a listening socket, or -1.
+int net_listen(const char *address);
+
+// Returns a connected socket, or -1.
+int net_connect(const char *address);
+
+// Removes the socket file a Unix address left behind; nothing for TCP.
+void net_unlink(const char *address);
+
+// Makes reads and writes on fd give up once they have waited milliseconds
+// for the other end, so a peer that stalls mid-message can't hang the
+// caller. Returns false if the socket doesn't take the timeout.
+bool net_set_timeout(int fd, int milliseconds);
+
+// Reads exactly length bytes. Returns false on EOF or error.
+bool net_read_full(int fd, void *buffer, size_t length);
+
+// Writes all length bytes. Returns false on error.
+bool net_write_full(int fd, const void *buffer, size_t length);
+
+// Reads one '\n'-terminated line of at most capacity - 1 characters, without
+// the newline. Reads a byte at a time so nothing past the line is consumed.
+bool net_read_line(int fd, char *line, size_t capacity);
+
+#endif
@@ -0,0 +1,210 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene.h"
+#include "pattern.h"
+
+// Octaves summed by noise and marble; each has twice the frequency and half
+// the weight of the one before.
+#define PATTERN_OCTAVES 4
+
+// Checker and stripe cells are shifted by this much so a surface lying
+// exactly on a cell boundary, like a plane through its own position,
+// doesn't flicker between the two colors with rounding.
+#define PATTERN_BIAS 1e-3f
+
+// How strongly the turbulence bends the veins of marble.
+#define MARBLE_TURBULENCE 4
+
+
+rt_status parse_pattern(const char *name, const char *args, pattern *new_pattern, rt_error *error){
+
+    const char *names[] = {"checker", "stripes", "noise", "marble"};
+    const enum pattern_kind kinds[] = {CheckerPattern, StripesPattern, NoisePattern, MarblePattern};
+
+    size_t name_length = strcspn(name, " \t");
+
+    new_pattern->kind = NoPattern;
+
+    for(int index = 0; index < 4; index++){
+
+        if(strlen(names[index]) == name_length && strncmp(name, names[index], name_length) == 0){
+
+            new_pattern->kind = kinds[index];
+        }
+    }
+
+    if(new_pattern->kind == NoPattern){
+
+        return set_error(error, RT_ERROR_PARSE, "Unknown texture pattern \"%s\".", name);
+    }
+
+    // size, then the two colors; brackets and commas are only separators.
+    float values[7] = {1, 1, 1, 1, 0, 0, 0};
+    int num_values = 0;
+    const char *cursor = args;
+
+    while(true){
+
+        cursor += strspn(cursor, " \t[],");
+
+        if(*cursor == '\0'){
+
+            break;
+        }
+
+        char *end;
+        float value = strtof(cursor, &end);
+
+        if(end == cursor || num_values == 7){
+
+            return set_error(error, RT_ERROR_PARSE, "Bad arguments \"%s\" for the %s pattern.", args, name);
+        }
+
+        values[num_values] = value;
+        num_values++;
+        cursor = end;
+    }
+
+    if((num_values != 0 && num_values != 1 && num_values != 7) || values[0] <= 0){
+
+        return set_error(error, RT_ERROR_PARSE, "The %s pattern takes a positive size and optionally two "
+                         "colors.", name);
+    }
+
+    new_pattern->inv_size = 1 / values[0];
+
+    for(int channel = 0; channel < 3; channel++){
+
+        new_pattern->colors[0][channel] = 255 * values[1 + channel];
+        new_pattern->colors[1][channel] = 255 * values[4 + channel];
+    }
+
+    return RT_OK;
+}
+
+
+// A pseudo-random value in [0, 1) for each lattice point. Plain integer
+// arithmetic, with no permutation table, so it vectorizes.
+float lattice_value(int x, int y, int z){
+
+    uint32_t hash = ((uint32_t) x * 73856093u) ^ ((uint32_t) y * 19349663u) ^ ((uint32_t) z * 83492791u);
+
+    hash ^= hash >> 13;
+    hash *= 0x5bd1e995u;
+    hash ^= hash >> 15;
+
+    return (hash & 0xffffff) * (1.0f / 16777216);
+}
+
+// Quintic fade, so the noise has no visible creases at lattice lines.
+float fade(float t){
+
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+float lerp(float a, float b, float t){
+
+    return a + (b - a) * t;
+}
+
+// Value noise in [0, 1): the lattice values around point, blended.
+float value_noise(const float *point){
+
+    int cell[3];
+    float weight[3];
+
+    for(int axis = 0; axis < 3; axis++){
+
+        float floor_value = floorf(point[axis]);
+
+        cell[axis] = (int) floor_value;
+        weight[axis] = fade(point[axis] - floor_value);
+    }
+
+    float corners[2][2][2];
+
+    for(int dz = 0; dz < 2; dz++){
+
+        for(int dy = 0; dy < 2; dy++){
+
+            for(int dx = 0; dx < 2; dx++){
+
+                corners[dz][dy][dx] = lattice_value(cell[0] + dx, cell[1] + dy, cell[2] + dz);
+            }
+        }
+    }
+
+    float near = lerp(lerp(corners[0][0][0], corners[0][0][1], weight[0]),
+                      lerp(corners[0][1][0], corners[0][1][1], weight[0]), weight[1]);
+    float far = lerp(lerp(corners[1][0][0], corners[1][0][1], weight[0]),
+                     lerp(corners[1][1][0], corners[1][1][1], weight[0]), weight[1]);
+
+    return lerp(near, far, weight[2]);
+}
+
+// Sum of octaves of noise, scaled back into [0, 1). With turbulence each
+// octave is folded around its midpoint first, which gives sharp creases.
+float fractal_noise(const float *point, bool turbulence){
+
+    float octave_point[3] = {point[0], point[1], point[2]};
+    float amplitude = 1;
+    float total = 0;
+    float total_amplitude = 0;
+
+    for(int octave = 0; octave < PATTERN_OCTAVES; octave++){
+
+        float noise = value_noise(octave_point);
+
+        total += amplitude * (turbulence ? fabsf(2 * noise - 1) : noise);
+        total_amplitude += amplitude;
+
+        amplitude *= 0.5f;
+        v3_scale(octave_point, 2);
+    }
+
+    return total / total_amplitude;
+}
+
+void pattern_color(const pattern *texture_pattern, const float *point, float *color){
+
+    float scaled[3];
+
+    for(int axis = 0; axis < 3; axis++){
+
+        scaled[axis] = point[axis] * texture_pattern->inv_size;
+    }
+
+    // How far to blend from the first color to the second.
+    float blend = 0;
+
+    switch(texture_pattern->kind){
+
+        case CheckerPattern:
+            blend = ((int) floorf(scaled[0] + PATTERN_BIAS) + (int) floorf(scaled[1] + PATTERN_BIAS) +
+                     (int) floorf(scaled[2] + PATTERN_BIAS)) & 1;
+            break;
+
+        case StripesPattern:
+            blend = (int) floorf(scaled[0] + PATTERN_BIAS) & 1;
+            break;
+
+        case NoisePattern:
+            blend = fractal_noise(scaled, false);
+            break;
+
+        case MarblePattern:
+            blend = 0.5f + 0.5f * sinf((scaled[0] + MARBLE_TURBULENCE * fractal_noise(scaled, true)) * M_PI);
+            break;
+
+        case NoPattern:
+            break;
+    }
+
+    for(int channel = 0; channel < 3; channel++){
+
+        color[channel] = lerp(texture_pattern->colors[0][channel], texture_pattern->colors[1][channel], blend);
+    }
+}
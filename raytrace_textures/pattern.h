@@ -0,0 +1,32 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include "rt.h"
+
+// Procedural textures, written in a scene as "texture: NAME(size, [r, g, b],
+// [r, g, b])" instead of a filename. They are solid textures: the color is
+// a function of the hit point relative to the object's position, so they
+// take no memory, have no resolution and wrap around any shape without
+// seams. size is the width of one feature in scene units and the two colors
+// (0 to 1, default white and black) are what the pattern blends between.
+enum pattern_kind{NoPattern, CheckerPattern, StripesPattern, NoisePattern, MarblePattern};
+
+typedef struct {
+
+    enum pattern_kind kind;
+
+    float inv_size;
+
+    // 0 to 255, like the texels of an image texture.
+    float colors[2][3];
+
+} pattern;
+
+// Fills new_pattern from a pattern name (checker, stripes, noise or marble)
+// and the text between its parentheses.
+rt_status parse_pattern(const char *name, const char *args, pattern *new_pattern, rt_error *error);
+
+// Writes the color of the pattern at point, in object space, to color.
+void pattern_color(const pattern *texture_pattern, const float *point, float *color);
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ppmrw.h"
+
+// Stitches the partial images written by raytrace --region or --stripe back
+// into the full frame. Each part records where it goes in a
+// "# region x0 y0 x1 y1 of WIDTH HEIGHT" header comment, so the parts can be
+// listed in any order. The output uses the format of the first part.
+
+
+void ppm_merge_fail(const char *s) {
+
+    printf("Error: %s\n\n", s);
+    printf("Usage:\n");
+    printf("ppm-merge OUTPUT.ppm PART.ppm [PART.ppm ...]\n\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]){
+
+    if(argc < 3){
+
+        ppm_merge_fail("Wrong number of arguments.");
+    }
+
+    uint8_t *frame = NULL;
+    uint8_t *covered = NULL;
+    int frame_width = 0;
+    int frame_height = 0;
+    char frame_format = 0;
+
+    for(int part = 2; part < argc; part++){
+
+        FILE *fp = fopen(argv[part], "r");
+
+        if(fp == NULL){
+
+            printf("Error: Could not open %s.\n", argv[part]);
+            exit(1);
+        }
+
+        char format;
+        int region[4];
+        int width;
+        int height;
+
+        if(fscanf(fp, "P%c # region %d %d %d %d of %d %d", &format, &region[0], &region[1], &region[2],
+                  &region[3], &width, &height) != 7){
+
+            printf("Error: %s has no region comment; was it rendered with --region or --stripe?\n", argv[part]);
+            exit(1);
+        }
+
+        rewind(fp);
+
+        char header_num[3];
+        int part_width;
+        int part_height;
+        int max_val;
+
+        const char *read_error = read_header(fp, header_num, &part_width, &part_height, &max_val);
+
+        if(read_error == NULL && (part_width != region[2] - region[0] || part_height != region[3] - region[1] ||
+                                  region[0] < 0 || region[1] < 0 || region[2] > width || region[3] > height)){
+
+            read_error = "The image does not match its region comment.";
+        }
+
+        if(read_error == NULL && frame != NULL && (width != frame_width || height != frame_height)){
+
+            read_error = "The part is from a frame of a different size.";
+        }
+
+        if(read_error != NULL){
+
+            printf("Error: %s: %s\n", argv[part], read_error);
+            exit(1);
+        }
+
+        if(frame == NULL){
+
+            frame_width = width;
+            frame_height = height;
+            frame_format = format;
+
+            frame = malloc((size_t) width * height * 3);
+            covered = calloc((size_t) width * height, 1);
+
+            if(frame == NULL || covered == NULL){
+
+                ppm_merge_fail("Memory allocation for the frame has failed!");
+            }
+        }
+
+        int length = part_width * part_height * 3;
+        uint8_t *pixmap = malloc(length);
+
+        if(pixmap == NULL){
+
+            ppm_merge_fail("Memory allocation for a part has failed!");
+        }
+
+        read_error = format == '3' ? read_p3(fp, pixmap, length) : read_p6(fp, pixmap, length);
+
+        fclose(fp);
+
+        if(read_error != NULL){
+
+            printf("Error: %s: %s\n", argv[part], read_error);
+            exit(1);
+        }
+
+        for(int row = 0; row < part_height; row++){
+
+            int frame_index = (region[1] + row) * frame_width + region[0];
+
+            memcpy(&frame[frame_index * 3], &pixmap[row * part_width * 3], part_width * 3);
+            memset(&covered[frame_index], 1, part_width);
+        }
+
+        free(pixmap);
+    }
+
+    int missing = 0;
+
+    for(int index = 0; index < frame_width * frame_height; index++){
+
+        missing += !covered[index];
+    }
+
+    if(missing > 0){
+
+        printf("Error: The parts leave %d of %d pixels uncovered.\n", missing, frame_width * frame_height);
+        exit(1);
+    }
+
+    FILE *outfile = fopen(argv[1], "w");
+
+    if(outfile == NULL){
+
+        ppm_merge_fail("Could not open the output file.");
+    }
+
+    if(frame_format == '3'){
+
+        write_p3(outfile, frame, frame_width, frame_height, 255);
+
+    } else {
+
+        write_p6(outfile, frame, frame_width, frame_height, 255);
+    }
+
+    fclose(outfile);
+
+    free(frame);
+    free(covered);
+
+    return 0;
+}
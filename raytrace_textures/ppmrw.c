@@ -3,15 +3,9 @@
 const int BUFFER_SIZE = 500;
 
 
-void fail( char *s ) {
-
-    printf( "Error: %s\n\n", s );
-    printf( "Usage:\n" );
-    printf( "ppmrw MAGICNUM INPUT OUTPUT\n\n" );
-    exit(1);
-}
-
-FILE *read_header( FILE *fp, char *header_num, int *width, int *height, int *max_val ) {
+// The readers return NULL on success or a message describing what was wrong
+// with the file, so callers decide how to report it.
+const char *read_header( FILE *fp, char *header_num, int *width, int *height, int *max_val ) {
 
     char width_buffer[ BUFFER_SIZE ];
     char height_buffer[ BUFFER_SIZE ];
@@ -20,7 +14,7 @@ FILE *read_header( FILE *fp, char *header_num, int *width, int *height, int *max
     int index;
 
     if( fp == NULL ) {
-        printf( "File not Found. Please check input filename." );
+        return "File not Found. Please check input filename.";
     }
 
     // Get the magic number from the file.
@@ -30,8 +24,7 @@ FILE *read_header( FILE *fp, char *header_num, int *width, int *height, int *max
 
     // Check if there are more characters than needed.
     if( fgetc( fp ) != '\n') {
-        printf( "Error: Magic Number Invalid" );
-        exit(1);
+        return "Magic Number Invalid";
     }
 
     // Skip past the comments in the file if they exist.
@@ -87,11 +80,14 @@ FILE *read_header( FILE *fp, char *header_num, int *width, int *height, int *max
     // to the passed-in local variable.
     *max_val = atoi( max_val_buffer );
 
-    // Return the file pointer so that we don't lose its place.
-    return fp;
+    if( *width <= 0 || *height <= 0 ) {
+        return "The width and height in the header must be positive.";
+    }
+
+    return NULL;
 }
 
-void read_p3( FILE *fp, uint8_t *pixmap, int length ) {
+const char *read_p3( FILE *fp, uint8_t *pixmap, int length ) {
 
     // Initialize variables and buffers for reading.
     char line_string[ BUFFER_SIZE ];
@@ -106,15 +102,10 @@ void read_p3( FILE *fp, uint8_t *pixmap, int length ) {
 
             // Check if nothing was parsed or if the parsed line is too long.
             if( parsed_len == 0 || line_string[ parsed_len - 1 ] != '\n' ) {
-                char error = line_string[ parsed_len - 1  ];
-                printf( "Error: One of the RGB channels in the input file " );
-                printf( "does not contain a valid value" );
-                printf( "\nlast char == %c\nlen== %ld", error, parsed_len );
-                exit( 1 );
+                return "One of the RGB channels in the input file does not contain a valid value.";
             }
         } else {
-            printf( "Error: Not enough channels provided in input file." );
-            exit( 1 );
+            return "Not enough channels provided in input file.";
         }
 
         // Parse the int using strtol (base 10).
@@ -123,22 +114,26 @@ void read_p3( FILE *fp, uint8_t *pixmap, int length ) {
         // endptr will contain more than the the newline character if non-numerical
         // characters are parsed.
         if( *endptr != '\n') {
-            printf( "Error: An RGB channel contained a non-numerical value." );
-            printf( "\nSpecifically: %c", *endptr );
-            exit( 1 );
+            return "An RGB channel contained a non-numerical value.";
         }
 
         if( parsed_int < 0 || parsed_int > 255) {
-            printf( "Error: An RGB channel in the provided file is not an 8-Bit value." );
-            printf( "\nSpecifically: %d", parsed_int );
-            exit( 1 );
+            return "An RGB channel in the provided file is not an 8-Bit value.";
         }
 
         pixmap[ index ] = parsed_int;
     }
+
+    return NULL;
 }
 
 void write_p3( FILE *fp, uint8_t *pixmap, int width, int height, int max_val ) {
+
+    write_p3_comment( fp, pixmap, width, height, max_val, NULL );
+}
+
+void write_p3_comment( FILE *fp, uint8_t *pixmap, int width, int height, int max_val,
+                       const char *comment ) {
     
     int length = width * height * 3;
     char str_num[ BUFFER_SIZE ];
@@ -148,6 +143,10 @@ void write_p3( FILE *fp, uint8_t *pixmap, int width, int height, int max_val ) {
     putc( '3', fp );
     putc( '\n', fp );
 
+    if( comment != NULL ) {
+        fprintf( fp, "# %s\n", comment );
+    }
+
     // Convert the width integer to a string for iteration and file writing.
     snprintf( str_num, 10, "%d", width );
 
@@ -204,7 +203,7 @@ void write_p3( FILE *fp, uint8_t *pixmap, int width, int height, int max_val ) {
     }
 }
 
-void read_p6( FILE *fp, uint8_t *pixmap, int length ) {
+const char *read_p6( FILE *fp, uint8_t *pixmap, int length ) {
     
     int index;
     size_t num_elements;
@@ -220,18 +219,23 @@ void read_p6( FILE *fp, uint8_t *pixmap, int length ) {
 
     // Check there were enough RGB channels
     if( index < length ) {
-        printf( "Error: The provided input file did not have enough RGB channels.");
-        printf( "\nElements parsed: %d\nElements Expected: %d", index, length );
-        exit(1);
+        return "The provided input file did not have enough RGB channels.";
     }
 
     if( fgetc( fp ) != EOF ) {
-        printf( "Error: The provided input file had too many RGB channels.");
-        exit(1);
+        return "The provided input file had too many RGB channels.";
     }
+
+    return NULL;
 }
 
 void write_p6( FILE *fp, uint8_t *pixmap, int width, int height, int max_val ) {
+
+    write_p6_comment( fp, pixmap, width, height, max_val, NULL );
+}
+
+void write_p6_comment( FILE *fp, uint8_t *pixmap, int width, int height, int max_val,
+                       const char *comment ) {
     
     int length = width * height * 3;
     char str_num[ BUFFER_SIZE ];
@@ -240,6 +244,10 @@ void write_p6( FILE *fp, uint8_t *pixmap, int width, int height, int max_val ) {
     putc( '6', fp );
     putc( '\n', fp );
 
+    if( comment != NULL ) {
+        fprintf( fp, "# %s\n", comment );
+    }
+
     // Convert the width integer to a string for iteration and file writing.
     snprintf( str_num, 10, "%d", width );
 
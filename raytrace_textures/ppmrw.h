@@ -3,15 +3,22 @@
 #include <stdint.h>
 #include <string.h>
 
-void fail( char *s );
+// The readers return NULL on success, otherwise a static error message.
+const char *read_header( FILE *fp, char *header_num, int *width, int *height, int *max_val );
 
-FILE *read_header( FILE *fp, char *header_num, int *width, int *height, int *max_val );
-
-void read_p3( FILE *fp, uint8_t *pixmap, int length );
+const char *read_p3( FILE *fp, uint8_t *pixmap, int length );
 
 void write_p3( FILE *fp, uint8_t *pixmap, int width, int height, int max_val );
 
-void read_p6( FILE *fp, uint8_t *pixmap, int length );
+const char *read_p6( FILE *fp, uint8_t *pixmap, int length );
 
 void write_p6( FILE *fp, uint8_t *pixmap, int width, int height, int max_val );
 
+// Same as write_p3() / write_p6() with a "# comment" line after the magic
+// number, which read_header() skips.
+void write_p3_comment( FILE *fp, uint8_t *pixmap, int width, int height, int max_val,
+                       const char *comment );
+
+void write_p6_comment( FILE *fp, uint8_t *pixmap, int width, int height, int max_val,
+                       const char *comment );
+
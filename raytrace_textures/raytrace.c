@@ -1,1054 +1,742 @@
-#include "v3math.h"
-#include "ppmrw.h"
-
-const int MAX_SIZE = 128;
-
-enum shape_type{Sphere, Plane}; // 0 = sphere, 1 = plane
+#include <unistd.h>
 
+#include "rt.h"
+#include "ppmrw.h"
+#include "batch.h"
+#include "farm.h"
+#include "checkpoint.h"
+#include "encoder.h"
+#include "rendercache.h"
+#include "texpage.h"
+
+// Passes each finished tile to both the journal and the encoder, when a
+// render has both.
 typedef struct {
 
-    enum shape_type type;
-    int diffuse_color[3];
-    int specular_color[3];
-    float center[3];
-    float reflectivity;
-    int texture_index;
-
-    union {
+    checkpoint *journal;
+    row_encoder *encoder;
 
-        struct {
-            float radius;
-        } sphere;
+} tile_listeners;
 
-        struct {
-            float normal[3];
-        } plane;
-    };
-} object;
+int notify_tile(int tile, const int bounds[4], void *user_data) {
 
-typedef struct {
+    tile_listeners *listeners = user_data;
 
-    // theta of 0 = point light.
-    float theta;
-    float color[3];
-    float center[3];
-    float radial[3];
-
-    // Only for spot lights (theta != 0)
-    float angular_a0;
-    float direction[3];
-    float cosine;
-    
-} light;
-
-typedef struct {
+    if(listeners->journal != NULL) {
+        checkpoint_tile(tile, bounds, listeners->journal);
+    }
 
-    int width;
-    int height;
-    uint8_t *pixmap;
+    if(listeners->encoder != NULL) {
+        encoder_tile(tile, bounds, listeners->encoder);
+    }
 
-} texture;
+    return 0;
+}
 
 void raytrace_fail(char *s) {
 
     printf("Error: %s\n\n", s);
     printf("Usage:\n");
-    printf("raytrace WIDTH HEIGHT INPUT.scene OUTPUT.ppm\n\n");
+    printf("raytrace [OPTIONS] WIDTH HEIGHT INPUT.scene OUTPUT.ppm|OUTPUT.qoi|OUTPUT.png\n");
+    printf("raytrace --batch MANIFEST [--threads N]\n");
+    printf("raytrace --coordinate ADDRESS [--spawn N] [--threads N] WIDTH HEIGHT INPUT.scene OUTPUT.ppm\n");
+    printf("raytrace --worker ADDRESS [--threads N]\n\n");
+    printf("Options:\n");
+    printf("  --stats json    write render counters and phase times to OUTPUT.stats.json\n");
+    printf("  --heatmap FILE.ppm\n");
+    printf("                  write a false-color image of the cost of each pixel\n");
+    printf("  --heatmap-metric tests|rays|cycles\n");
+    printf("                  what the heatmap measures (default tests)\n");
+    printf("  --threads N     number of render threads (default: one per CPU)\n");
+    printf("  --light-cutoff C\n");
+    printf("                  ignore a light where its radial attenuation is below C (default 0, off)\n");
+    printf("  --fast-math     shade with float approximations of atan2, acos, pow and sqrt\n");
+    printf("  --trace FILE.json\n");
+    printf("                  write a Chrome trace / Perfetto timeline of the run\n");
+    printf("  --batch MANIFEST\n");
+    printf("                  render every \"SCENE WIDTH HEIGHT OUTPUT.ppm\" line as P6,\n");
+    printf("                  one job per thread, and print each job's timing\n");
+    printf("  --region x0,y0,x1,y1\n");
+    printf("                  render only these pixels (x1, y1 exclusive) into a partial PPM\n");
+    printf("  --stripe k/n    render only the k-th of n bands of rows, counting from 0\n");
+    printf("  --checkpoint FILE.journal\n");
+    printf("                  record finished tiles in FILE.journal, removed once OUTPUT is written\n");
+    printf("  --resume        carry on from the tiles in the --checkpoint journal\n");
+    printf("  --render-cache DIR\n");
+    printf("                  reuse an identical earlier render from DIR, or store this one there\n");
+    printf("  --render-cache-size MB\n");
+    printf("                  evict least recently used renders beyond MB (default 1024)\n");
+    printf("  --texture-mem SIZE\n");
+    printf("                  page image textures in 64x64 tiles, keeping at most SIZE\n");
+    printf("                  (like 512M or 2G) in memory\n");
+    printf("  --coordinate ADDRESS\n");
+    printf("                  hand tiles out to workers connecting to unix:PATH or HOST:PORT\n");
+    printf("  --spawn N       start N local workers for --coordinate, splitting --threads\n");
+    printf("  --worker ADDRESS\n");
+    printf("                  render tiles for the coordinator at ADDRESS\n\n");
     exit(1);
 }
 
-// Gets the camera width and height and stores them in the provided pointers.
-// Returns the file pointer pointing to the first object in the list.
-FILE *get_camera(FILE *fp, float *camera_width, float *camera_height) {
-
-    char string_width[MAX_SIZE];
-    char string_height[MAX_SIZE];
-
-    // Assuming the camera will always be formatted correctly,
-    // we can use an fscanf pattern for parsing the width and height.
-    fscanf(fp, "%*s %*s %s %*s %s", string_width, string_height);
-    float width = atof(string_width);
-    float height = atof(string_height);
-
-    *camera_width = width;
-    *camera_height = height;
-
-    return fp;
-}
-
-void get_objects(FILE *fp, object *object_list, light *light_list, texture *texture_list, 
-    int *num_objects, int *num_lights, int *num_textures) {
-
-    char string_buffer[MAX_SIZE];
 
-    int object_index = 0;
-    int light_index = 0;
-    int iterations = 0;
-    int texture_index = 0;
-
-    while(!feof(fp)){
-
-        // Prevents infinite loops caused by improper formatting and
-        // prevents segfaults from adding too many objects + lights. (>128)
-        if(iterations >= 128){
-        printf("\nError: Improper formatting of scene file or too many items listed.");
-        exit(1);
-        }
-
-        // Grab the object's type.
-        fscanf(fp, " %128[^,] ", string_buffer);
-
-        if(strcmp(string_buffer, "sphere") == 0 || strcmp(string_buffer, "plane") == 0) {
-
-            object new_object;
-
-            // Default the diffuse color to black in case a texture is used instead.
-            new_object.diffuse_color[0] = 0;
-            new_object.diffuse_color[1] = 0;
-            new_object.diffuse_color[2] = 0;
-
-            // Default the texture index to -1 in case a texture is not used.
-            new_object.texture_index = -1;
-
-            // Default the specular color to black in case it isn't listed.
-            new_object.specular_color[0] = 0;
-            new_object.specular_color[1] = 0;
-            new_object.specular_color[2] = 0;
-
-            if(strcmp(string_buffer, "sphere") == 0) {
-
-                new_object.type = Sphere;
+int main( int argc, char *argv[] ){
 
+    char *positional[4];
+    int num_positional = 0;
+    bool write_stats = false;
+    char *heatmap_file = NULL;
+    enum heatmap_metric metric = Tests;
+    int num_threads = rt_default_thread_count();
+    char *trace_file = NULL;
+    float light_cutoff = 0;
+    bool fast_math = false;
+    char *batch_file = NULL;
+    int region[4] = {0, 0, 0, 0};
+    int stripe_index = 0;
+    int stripe_count = 0;
+    char *checkpoint_file = NULL;
+    bool resume = false;
+    char *coordinate_address = NULL;
+    char *worker_address = NULL;
+    int spawn_workers = 0;
+    render_cache cache = {.directory = NULL, .max_bytes = 1024LL * 1024 * 1024};
+    size_t texture_mem = 0;
+
+    // Options may appear anywhere; everything else is positional.
+    for(int arg = 1; arg < argc; arg++){
+
+        if(strcmp(argv[arg], "--stats") == 0){
+
+            if(arg + 1 >= argc || strcmp(argv[arg + 1], "json") != 0){
+                raytrace_fail("--stats only supports the json format.");
             }
 
-            if(strcmp(string_buffer, "plane") == 0) {
+            write_stats = true;
+            arg++;
 
-                new_object.type = Plane;
+        } else if(strcmp(argv[arg], "--heatmap") == 0){
 
+            if(arg + 1 >= argc || strlen(argv[arg + 1]) < 4 ||
+               strcmp(&argv[arg + 1][strlen(argv[arg + 1]) - 4], ".ppm") != 0){
+                raytrace_fail("--heatmap needs a .ppm output file.");
             }
 
-            // prime the while-loop.
-            char delim = fgetc(fp);
-
-            // iterate until the end of the line
-            while(delim == ','){
-
-                fscanf(fp, " %s ", string_buffer);
-
-                if(strcmp(string_buffer, "radius:") == 0){
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_object.sphere.radius = atof(string_buffer);
-
-                }
-
-                else if(strcmp(string_buffer, "diffuse_color:") == 0){
-
-                    fscanf(fp, " [%s ", string_buffer);
-
-                    new_object.diffuse_color[0] = floor(255 * atof(string_buffer));
-
-                    fscanf(fp, " %s", string_buffer);
-
-                    new_object.diffuse_color[1] = floor(255 * atof(string_buffer));
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_object.diffuse_color[2] =  floor(255 * atof(string_buffer));
-
-                }
-
-                else if(strcmp(string_buffer, "specular_color:") == 0){
-
-                    fscanf(fp, " [%s ", string_buffer);
-
-                    new_object.specular_color[0] = floor(255 * atof(string_buffer));
-
-                    fscanf(fp, " %s", string_buffer);
-
-                    new_object.specular_color[1] = floor(255 * atof(string_buffer));
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_object.specular_color[2] = floor(255 * atof(string_buffer));
-
-                }
-
-                else if(strcmp(string_buffer, "position:") == 0){
-
-                    fscanf(fp, " [%s ", string_buffer);
-
-                    new_object.center[0] = atof(string_buffer);
-
-                    fscanf(fp, " %s", string_buffer);
-
-                    new_object.center[1] = atof(string_buffer);
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_object.center[2] = atof(string_buffer);
-
-                }
-                
-                else if(strcmp(string_buffer, "normal:") == 0){
-
-                    fscanf(fp, " [%s ", string_buffer);
-
-                    new_object.plane.normal[0] = atof(string_buffer);
-
-                    fscanf(fp, " %s", string_buffer);
-
-                    new_object.plane.normal[1] = atof(string_buffer);
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_object.plane.normal[2] = atof(string_buffer);
-
-                }
-
-               else if(strcmp(string_buffer, "reflectivity:") == 0){
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_object.reflectivity = atof(string_buffer);
-
-                }
-
-                else if(strcmp(string_buffer, "texture:") == 0){
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    texture new_texture;
-
-                    // string_buffer contains the filename of the texture.
-                    FILE *texture_fp = fopen(string_buffer, "r");
-
-                    char header_num[3];
-
-                    int max_val = 0;
+            heatmap_file = argv[arg + 1];
+            arg++;
 
-                    texture_fp = read_header(texture_fp, header_num, &new_texture.width,
-                                             &new_texture.height, &max_val);
+        } else if(strcmp(argv[arg], "--heatmap-metric") == 0){
 
-                    int length = new_texture.width * new_texture.height * 3;
-
-                    uint8_t *pixmap = malloc(sizeof(uint8_t) * length);
-
-                    if(strcmp(header_num, "P3") == 0) {
-
-                        read_p3(texture_fp, pixmap, length);
-
-                    } else {
-
-                        read_p6(texture_fp, pixmap, length);
-                    }
-
-                    new_texture.pixmap = pixmap;
-
-                    texture_list[texture_index] = new_texture;
-
-                    new_object.texture_index = texture_index;
-
-                    texture_index++;
-
-                }
-
-                delim = fgetc(fp);
+            if(arg + 1 >= argc){
+                raytrace_fail("--heatmap-metric needs a value.");
             }
 
-            object_list[object_index] = new_object;
-            object_index++;
-
-        }
-
-        if(strcmp(string_buffer, "light") == 0) {
-
-            light new_light;
-
-            // Default to 0.0 in case 
-            new_light.theta = 0.0;
-
-            // prime the while-loop.
-            char delim = fgetc(fp);
-
-            // iterate until the end of the line
-            while(delim == ','){
-
-                fscanf(fp, " %s ", string_buffer);
-
-                if(strcmp(string_buffer, "theta:") == 0){
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_light.theta = atof(string_buffer);
-
-                    // Only need to calculate cosine if the light is a spotlight.
-                    if(new_light.theta != 0){
-
-                        // convert theta to radians for cosine function
-                        float rad_theta = new_light.theta * M_PI / 180;
-
-                        new_light.cosine = cos(rad_theta);
-                    }
-
-                }
-
-                else if(strcmp(string_buffer, "radial-a0:") == 0){
-
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
-
-                    new_light.radial[0] = atof(string_buffer);
-
-                }
+            if(strcmp(argv[arg + 1], "tests") == 0){
+                metric = Tests;
+            } else if(strcmp(argv[arg + 1], "rays") == 0){
+                metric = Rays;
+            } else if(strcmp(argv[arg + 1], "cycles") == 0){
+                metric = Cycles;
+            } else {
+                raytrace_fail("--heatmap-metric must be tests, rays or cycles.");
+            }
 
-                else if(strcmp(string_buffer, "radial-a1:") == 0){
+            arg++;
 
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
+        } else if(strcmp(argv[arg], "--threads") == 0){
 
-                    new_light.radial[1] = atof(string_buffer);
+            if(arg + 1 >= argc || atoi(argv[arg + 1]) < 1){
+                raytrace_fail("--threads needs a positive number.");
+            }
 
-                }
+            num_threads = atoi(argv[arg + 1]);
+            arg++;
 
-                else if(strcmp(string_buffer, "radial-a2:") == 0){
+        } else if(strcmp(argv[arg], "--light-cutoff") == 0){
 
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
+            if(arg + 1 >= argc || atof(argv[arg + 1]) < 0){
+                raytrace_fail("--light-cutoff needs a number of at least 0.");
+            }
 
-                    new_light.radial[2] = atof(string_buffer);
+            light_cutoff = atof(argv[arg + 1]);
+            arg++;
 
-                }
+        } else if(strcmp(argv[arg], "--fast-math") == 0){
 
-                else if(strcmp(string_buffer, "angular-a0:") == 0){
+            fast_math = true;
 
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
+        } else if(strcmp(argv[arg], "--trace") == 0){
 
-                    new_light.angular_a0 = atof(string_buffer);
+            if(arg + 1 >= argc){
+                raytrace_fail("--trace needs an output file.");
+            }
 
-                }
+            trace_file = argv[arg + 1];
+            arg++;
 
-                else if(strcmp(string_buffer, "color:") == 0){
+        } else if(strcmp(argv[arg], "--batch") == 0){
 
-                    fscanf(fp, " [%s ", string_buffer);
+            if(arg + 1 >= argc){
+                raytrace_fail("--batch needs a manifest file.");
+            }
 
-                    new_light.color[0] = atof(string_buffer);
+            batch_file = argv[arg + 1];
+            arg++;
 
-                    fscanf(fp, " %s", string_buffer);
+        } else if(strcmp(argv[arg], "--region") == 0){
 
-                    new_light.color[1] = atof(string_buffer);
+            if(arg + 1 >= argc || sscanf(argv[arg + 1], "%d,%d,%d,%d", &region[0], &region[1],
+                                         &region[2], &region[3]) != 4) {
+                raytrace_fail("--region needs x0,y0,x1,y1.");
+            }
 
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
+            arg++;
 
-                    new_light.color[2] =  atof(string_buffer);
+        } else if(strcmp(argv[arg], "--stripe") == 0){
 
-                }
+            if(arg + 1 >= argc || sscanf(argv[arg + 1], "%d/%d", &stripe_index, &stripe_count) != 2 ||
+               stripe_count < 1 || stripe_index < 0 || stripe_index >= stripe_count) {
+                raytrace_fail("--stripe needs k/n with 0 <= k < n.");
+            }
 
-                else if(strcmp(string_buffer, "direction:") == 0){
+            arg++;
 
-                    fscanf(fp, " [%s ", string_buffer);
+        } else if(strcmp(argv[arg], "--checkpoint") == 0){
 
-                    new_light.direction[0] = atof(string_buffer);
+            if(arg + 1 >= argc){
+                raytrace_fail("--checkpoint needs a journal file.");
+            }
 
-                    fscanf(fp, " %s", string_buffer);
+            checkpoint_file = argv[arg + 1];
+            arg++;
 
-                    new_light.direction[1] = atof(string_buffer);
+        } else if(strcmp(argv[arg], "--render-cache") == 0){
 
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
+            if(arg + 1 >= argc){
+                raytrace_fail("--render-cache needs a directory.");
+            }
 
-                    new_light.direction[2] = atof(string_buffer);
+            cache.directory = argv[arg + 1];
+            arg++;
 
-                }
+        } else if(strcmp(argv[arg], "--render-cache-size") == 0){
 
-                else if(strcmp(string_buffer, "position:") == 0){
+            if(arg + 1 >= argc || atol(argv[arg + 1]) < 1){
+                raytrace_fail("--render-cache-size needs a positive number of MB.");
+            }
 
-                    fscanf(fp, " [%s ", string_buffer);
+            cache.max_bytes = atol(argv[arg + 1]) * 1024LL * 1024;
+            arg++;
 
-                    new_light.center[0] = atof(string_buffer);
+        } else if(strcmp(argv[arg], "--texture-mem") == 0){
 
-                    fscanf(fp, " %s", string_buffer);
+            if(arg + 1 >= argc || !parse_memory_size(argv[arg + 1], &texture_mem)){
+                raytrace_fail("--texture-mem needs a size like 512M or 2G.");
+            }
 
-                    new_light.center[1] = atof(string_buffer);
+            arg++;
 
-                    fscanf(fp, " %128[^,^\n]", string_buffer);
+        } else if(strcmp(argv[arg], "--resume") == 0){
 
-                    new_light.center[2] = atof(string_buffer);
+            resume = true;
 
-                }
+        } else if(strcmp(argv[arg], "--coordinate") == 0 || strcmp(argv[arg], "--worker") == 0){
 
-                delim = fgetc(fp);
+            if(arg + 1 >= argc){
+                raytrace_fail("--coordinate and --worker need an address.");
             }
 
-            light_list[light_index] = new_light;
-            light_index++;
-
-        }
-
-        iterations++;
-    }
+            if(argv[arg][2] == 'c'){
+                coordinate_address = argv[arg + 1];
+            } else {
+                worker_address = argv[arg + 1];
+            }
 
-    *num_objects = object_index;
-    *num_lights = light_index;
-    *num_textures = texture_index;
-}
+            arg++;
 
-            
-float sphere_intersection(float *rd, float *ro, float *center, float radius){
-        
-    float x_diff = ro[0] - center[0];
-    float y_diff = ro[1] - center[1];
-    float z_diff = ro[2] - center[2];      
+        } else if(strcmp(argv[arg], "--spawn") == 0){
 
-    //float a = pow(rd[0], 2) + pow(rd[1], 2) + pow(rd[2], 2);
-    float b = 2 * (rd[0] * x_diff + rd[1] * y_diff + rd[2] * z_diff);
-    float c = pow(x_diff, 2) + pow(y_diff, 2) + pow(z_diff, 2);
-          c = c - pow(radius, 2);
+            if(arg + 1 >= argc || atoi(argv[arg + 1]) < 1){
+                raytrace_fail("--spawn needs a positive number.");
+            }
 
-    float discrim = pow(b, 2) - 4 * c;
+            spawn_workers = atoi(argv[arg + 1]);
+            arg++;
 
-    if(discrim >= 0.0){
+        } else if(strncmp(argv[arg], "--", 2) == 0){
 
-        float t0 = (-b - sqrt(discrim)) / 2;
+            raytrace_fail("Unknown option.");
 
-        if(t0 > 0.0){
+        } else if(num_positional < 4){
 
-            return t0;
+            positional[num_positional] = argv[arg];
+            num_positional++;
 
         } else {
 
-            float t1 = (-b + sqrt(discrim)) / 2;
-            return t1;
+            raytrace_fail("Wrong number of arguments.");
         }
+    }
 
-    } else {
-        // return -1 to indicate that there is no intersection
-        return -1;
-    }    
-}
-
-
-float plane_intersection(float *rd, float *ro, float *center, float *normal){
-
-    float vd = v3_dot_product(normal, rd);
-
-    if(vd > 0.0){
-
-        return -1;
+    // Batch jobs run one per thread and only report timing.
+    if(batch_file != NULL) {
 
-    } else {
-            
-        float numerator_comp[3] = {0,0,0};       
-        v3_subtract(numerator_comp, center, ro);
-    
-        float vn = v3_dot_product(numerator_comp, normal);
+        if(num_positional != 0 || write_stats || heatmap_file != NULL || trace_file != NULL ||
+           region[2] != 0 || stripe_count != 0 || fast_math || cache.directory != NULL || texture_mem != 0) {
+            raytrace_fail("--batch only combines with --threads.");
+        }
 
-        return vn / vd;   
+        return run_batch(batch_file, num_threads) == 0 ? 0 : 1;
     }
-}
-
-
-float radial(float a2, float a1, float a0, float d){
 
-    float rad = a2 * (d*d) + a1*d + a0;
+    bool other_options = write_stats || heatmap_file != NULL || trace_file != NULL || region[2] != 0 ||
+                         stripe_count != 0 || batch_file != NULL || checkpoint_file != NULL ||
+                         light_cutoff != 0 || fast_math || cache.directory != NULL || texture_mem != 0;
 
-    if(rad == 0){
+    // A worker gets everything it renders from its coordinator.
+    if(worker_address != NULL) {
 
-        return 0;
+        if(num_positional != 0 || other_options || coordinate_address != NULL || spawn_workers != 0) {
+            raytrace_fail("--worker only combines with --threads.");
+        }
 
+        return run_worker(worker_address, num_threads);
     }
-    if(d == INFINITY){
-
-        return 1;
 
-    } else {
-
-        return 1 / rad;
+    if(spawn_workers != 0 && coordinate_address == NULL) {
+        raytrace_fail("--spawn needs --coordinate.");
     }
-}
-
-
-float angular(light light, float *v_obj){
-
-    if(light.theta == 0){
-
-        return 1;
-
-    } else {
-
-        float dot = v3_dot_product(v_obj, light.direction);
-
-        if(dot < light.cosine) {
-
-            return 0;
-
-        } else {
 
-            return pow(dot, light.angular_a0);
-        }
+    if(resume && checkpoint_file == NULL) {
+        raytrace_fail("--resume needs --checkpoint.");
     }
 
-}
-
-
-void apply_lights(object *object_list, int num_objects, light *light_list, int num_lights,
-                    texture *texture_list, float *intersection, float *rd, 
-                    int subject_object_index, float *I){
-
-    for(int light_index = 0; light_index < num_lights; light_index++){
-
-        light iter_light = light_list[light_index];
+    // Resumed tiles have no cost to show.
+    if(resume && heatmap_file != NULL) {
+        raytrace_fail("--resume can't be combined with --heatmap.");
+    }
 
-        float I_comp[3] = {0, 0, 0};
+    // A cached render has no counters, cost or timeline to report.
+    if(cache.directory != NULL && (write_stats || heatmap_file != NULL || trace_file != NULL)) {
+        raytrace_fail("--render-cache can't be combined with --stats, --heatmap or --trace.");
+    }
 
-        float v_obj[3];
-        v3_from_points(v_obj, iter_light.center, intersection);
+    if(cache.directory != NULL && !render_cache_init(&cache)) {
+        raytrace_fail("Could not create the render cache directory.");
+    }
 
-        v3_normalize(v_obj, v_obj);
+    // Check to make sure there are enough arguments in the CLI
+    if (num_positional != 4) {
+        raytrace_fail( "Wrong number of arguments." );
+    }
 
-        float lit_object_t = INFINITY;
-        int lit_object_index = -1;
-        float light_t = -1;
+    // Retrieve the arguments from the CLI
+    float width = atof(positional[0]);
+    float height = atof(positional[1]);
+    char *input_file = positional[2];
+    char *output_file = positional[3];
 
-        for(int object_index = 0; object_index < num_objects; object_index++){
+    // Get the lengths of the input and output names.
+    int length_input = strlen(input_file);
+    int length_output = strlen(output_file);
 
-            object iter_object = object_list[object_index];
+    // Obtain the extension of the input filename.
+    const char *input_extension = &input_file[length_input - 6];
 
-            if(iter_object.type == Sphere){  
-            
-                light_t = sphere_intersection(v_obj, iter_light.center, iter_object.center, iter_object.sphere.radius);
+    if(strcmp(".scene", input_extension) != 0) {
+        raytrace_fail("Bad input argument.");
+    }
 
-            }
+    enum image_format format;
 
-            if(iter_object.type == Plane){
-            
-                light_t = plane_intersection(v_obj, iter_light.center, iter_object.center, iter_object.plane.normal);
+    if(!image_format_for(output_file, &format)) {
+        raytrace_fail("Bad output argument");
+    }
 
-            }
+    // Parts are merged by ppm-merge and workers send back raw pixels, so
+    // both stay plain PPM.
+    if(format != FormatP3 && (region[2] != 0 || stripe_count != 0 || coordinate_address != NULL)) {
+        raytrace_fail("--region, --stripe and --coordinate need a .ppm output.");
+    }
 
-            if(light_t >= 0.0){
-                
-                if(light_t < lit_object_t){
+    if(coordinate_address != NULL) {
 
-                    lit_object_index = object_index;
-                    lit_object_t = light_t;
-                }
-            }
+        if(other_options) {
+            raytrace_fail("--coordinate only combines with --spawn and --threads.");
         }
 
-        if(subject_object_index == lit_object_index){
+        // Spawned workers share this machine's render threads.
+        int threads_per_worker = spawn_workers > 0 ? num_threads / spawn_workers : num_threads;
 
-            object lit_object = object_list[lit_object_index];
-
-            float light_x_diff = intersection[0] - iter_light.center[0];
-            float light_y_diff = intersection[1] - iter_light.center[1];
-            float light_z_diff = intersection[2] - iter_light.center[2];
-
-            float distance = sqrt(pow(light_x_diff, 2) + pow(light_y_diff, 2) + pow(light_z_diff, 2));
-
-            float f_rad = radial(iter_light.radial[2], iter_light.radial[1],
-                iter_light.radial[0], distance);
+        return run_coordinator(coordinate_address, input_file, width, height, output_file, spawn_workers,
+                               threads_per_worker > 0 ? threads_per_worker : 1);
+    }
 
-            float normal[3] = {0, 0, 0}; 
+    phase_times times = {0, 0, 0, 0};
 
-            if(lit_object.type == Sphere){
+    trace_log trace;
 
-                v3_from_points(normal, lit_object.center, v_obj);
+    if(trace_file != NULL && !trace_init(&trace, num_threads)) {
+        raytrace_fail("Memory allocation for the trace has failed!");
+    }
 
-            }
+    // Events from the main thread go to buffer 0; NULL when not tracing.
+    trace_buffer *main_trace = trace_buffer_for(trace_file != NULL ? &trace : NULL, 0);
 
-            if(lit_object.type == Plane){
+    rt_scene *current_scene;
+    rt_error error;
 
-                normal[0] = lit_object.plane.normal[0];
-                normal[1] = lit_object.plane.normal[1];
-                normal[2] = lit_object.plane.normal[2];
-            }
+    rt_texture_pager *pager = NULL;
 
+    if(texture_mem != 0 && (pager = rt_texture_pager_create(texture_mem)) == NULL) {
+        raytrace_fail("Memory allocation for the texture pager has failed!");
+    }
 
-            v3_normalize(normal, normal);
+    rt_load_options load_options = {.trace = trace_file != NULL ? &trace : NULL, .pager = pager,
+                                    .num_threads = num_threads};
 
-            float I_l[3] = {iter_light.color[0], iter_light.color[1], iter_light.color[2]};
+    // Parses the scene, reads its textures and bakes it for rendering.
+    if(rt_scene_load_file(&current_scene, input_file, &load_options, &error) != RT_OK) {
+        printf("Error: %s\n", error.message);
+        exit(1);
+    }
 
-            float L[3] = {v_obj[0], v_obj[1], v_obj[2]};
+    rt_scene_info info;
+    rt_scene_get_info(current_scene, &info);
 
-            v3_scale(L, -1);
+    times.parse_ms = info.parse_ms;
+    times.texture_load_ms = info.texture_load_ms;
 
-            float n_dot_L = v3_dot_product(normal, L);
+    if(region[2] != 0 && stripe_count != 0) {
+        raytrace_fail("Use either --region or --stripe.");
+    }
 
-            v3_scale(I_l, n_dot_L);
+    // Stripe k of n covers rows [k * height / n, (k + 1) * height / n).
+    if(stripe_count != 0) {
+        region[0] = 0;
+        region[1] = stripe_index * (int) height / stripe_count;
+        region[2] = width;
+        region[3] = (stripe_index + 1) * (int) height / stripe_count;
+    }
 
-            float diffuse_comp[3];
+    bool partial = region[2] != 0;
 
+    if(!partial) {
+        region[2] = width;
+        region[3] = height;
+    }
 
-            if(lit_object.texture_index == -1) {
+    if(region[0] < 0 || region[1] < 0 || region[0] >= region[2] || region[1] >= region[3] ||
+       region[2] > width || region[3] > height) {
+        raytrace_fail("The region must be a non-empty part of the frame.");
+    }
 
-                diffuse_comp[0] = lit_object.diffuse_color[0] * I_l[0];
-                diffuse_comp[1] = lit_object.diffuse_color[1] * I_l[1];
-                diffuse_comp[2] = lit_object.diffuse_color[2] * I_l[2];
+    int region_width = region[2] - region[0];
+    int region_height = region[3] - region[1];
 
-            } else {
-
-                texture obj_texture = texture_list[lit_object.texture_index];
+    int arr_length = region_width * region_height;
+    int max_val = 255;
 
-                float u;
-                float v;
+    // Allocate the memory for the pixmap.
+    uint8_t *pixmap = malloc(sizeof(uint8_t) * arr_length * 3);
 
-                if(lit_object.type == Sphere) {
+    if(pixmap == NULL) {
+    printf("Error: Memory allocation for pixmap has failed!");
+    exit(1);
+    }
 
-                    float theta = atan2(-(intersection[2] - lit_object.center[2]), 
-                                        intersection[0] - lit_object.center[0]);
-                    u = (theta + M_PI) / (2 * M_PI);
-                    float fi = acos((-(intersection[1] - lit_object.center[1])) / lit_object.sphere.radius);
-                    v = fi / M_PI;
+    printf("\nRaytracing scene with %d objects...\n", info.num_objects);
 
-                    //printf("\n(sphere)u: %f, v: %f", u, v);
+    heatmap heat = {metric, region_width, region_height, NULL};
 
-                    u = u * obj_texture.width;
-                    v = v * obj_texture.height;
+    if(heatmap_file != NULL) {
 
-                } else {
+        heat.cost = malloc(sizeof(float) * arr_length);
 
-                    float vector_v[3] = {0, 1, 1};
+        if(heat.cost == NULL) {
+        printf("Error: Memory allocation for heatmap has failed!");
+        exit(1);
+        }
+    }
 
-                    float vector_u[3] = {0, 0, 0};
+    rt_context *context = rt_context_create();
 
-                    v3_cross_product(vector_u, vector_v, lit_object.plane.normal);
+    if(context == NULL) {
+        raytrace_fail("Memory allocation for the render context has failed!");
+    }
 
-                    u = v3_dot_product(intersection, vector_u);
-                    v = v3_dot_product(intersection, vector_v);
+    rt_render_options options;
+    rt_render_options_init(&options, width, height);
+
+    options.num_threads = num_threads;
+    options.light_cutoff = light_cutoff;
+    options.fast_math = fast_math;
+    memcpy(options.region, region, sizeof(region));
+    options.heat = heatmap_file != NULL ? &heat : NULL;
+    options.trace = trace_file != NULL ? &trace : NULL;
+
+    // Named by the scene as parsed, its textures and meshes and the options
+    // that change the image, plus the format, as P3 is the only .ppm output.
+    // A partial P3 carries a region comment the full frame doesn't, so it
+    // gets a tag of its own even when its region is the whole frame.
+    const char *format_tags[] = {"p3", "qoi", "png"};
+    const char *format_tag = partial ? "p3r" : format_tags[format];
+    char cache_name[RENDER_CACHE_NAME_SIZE];
+
+    // The journal is keyed by the same digest, so both see every input
+    // that changes the image.
+    uint8_t scene_digest[32];
+
+    if(cache.directory != NULL || checkpoint_file != NULL) {
+        rt_scene_digest(current_scene, scene_digest);
+    }
 
-                    u = remainder(u, 70.0);
-                    v = remainder(v, 50.0);
+    if(cache.directory != NULL) {
 
-                    u = u * 50;
-                    v = v * 50;
+        double lookup_start = stats_now_ms();
 
-                    //printf("\n(plane) TC: %d", texture_coord);
+        uint8_t key[32];
 
-                }
+        rt_render_digest(scene_digest, &options, key);
+        render_cache_name(key, format_tag, cache_name);
 
+        long cached_length;
+        FILE *cached = render_cache_open(&cache, cache_name, &cached_length);
 
-                float y_offset = floor(obj_texture.height - v) * obj_texture.width;
-                int texture_coord = (int) (y_offset * 3 + floor(u) * 3);
+        if(cached != NULL) {
 
+            FILE *outfile = fopen(output_file, "wb");
 
-                diffuse_comp[0] = obj_texture.pixmap[texture_coord] * I_l[0];
-                diffuse_comp[1] = obj_texture.pixmap[texture_coord + 1] * I_l[1];
-                diffuse_comp[2] = obj_texture.pixmap[texture_coord + 2] * I_l[2];
+            if(outfile == NULL) {
+                raytrace_fail("Could not open the output file.");
             }
 
-            // Using a second I_l to account for scaling mutations.
-            float I_l_2[3];
-            I_l_2[0] = iter_light.color[0];
-            I_l_2[1] = iter_light.color[1];
-            I_l_2[2] = iter_light.color[2];
-
-            float R[3];
-
-            v3_reflect(R, L, normal);
-
-            float V[3] = {rd[0], rd[1], rd[2]};
-
-            v3_scale(V, -1);
-
-            float R_dot_V = v3_dot_product(R, V);
-
-            // Hard-coded ns to be 20
-            R_dot_V = pow(R_dot_V, 20);
-
-            v3_scale(I_l_2, R_dot_V);
+            bool copied = render_cache_copy(cached, outfile);
+            bool synced = checkpoint_file == NULL || (fflush(outfile) == 0 && fsync(fileno(outfile)) == 0);
 
-            float specular_comp[3];
+            fclose(cached);
 
-            specular_comp[0] = lit_object.specular_color[0] * I_l_2[0];
-            specular_comp[1] = lit_object.specular_color[1] * I_l_2[1];
-            specular_comp[2] = lit_object.specular_color[2] * I_l_2[2];
-
-            v3_add(I_comp, diffuse_comp, specular_comp);
+            if(fclose(outfile) != 0 || !copied || !synced) {
+                raytrace_fail("Could not write the output file.");
+            }
 
-            v3_scale(I_comp, f_rad);
+            // The image is on disk, so a journal left by an interrupted run
+            // of this render has nothing left to resume.
+            if(checkpoint_file != NULL) {
+                remove(checkpoint_file);
+            }
 
-            float f_ang = angular(iter_light, v_obj);
+            printf("\nCopied %ld bytes from the render cache in %.1f ms\n", cached_length,
+                   stats_now_ms() - lookup_start);
 
-            v3_scale(I_comp, f_ang);
+            free(pixmap);
+            rt_context_free(context);
+            rt_scene_free(current_scene);
+            rt_texture_pager_free(pager);
 
-            // Accrue the I component into I for each light.
-            v3_add(I, I, I_comp);
+            return 0;
         }
     }
-}
-
-
-void reflection(object *object_list, int num_objects, light *light_list, int num_lights,
-                    float *intersection, float *rd, int current_object_index, 
-                    int level, float *returned_color, texture *texture_list){
-
-    object current_object = object_list[current_object_index];
-
-    // Reflected color begins as pure black.
-    float reflected_color[3] = {0, 0, 0};
-
 
-    // Stop recursion after 7 levels of recursion.
-    if(level <= 7){
+    checkpoint journal;
+    uint8_t *done_tiles = NULL;
 
-        float normal[3]; 
+    if(checkpoint_file != NULL) {
 
-        if(current_object.type == Sphere){
-
-            v3_from_points(normal, current_object.center, intersection);
+        done_tiles = calloc(rt_tile_count(&options), 1);
 
+        if(done_tiles == NULL) {
+            raytrace_fail("Memory allocation for the journal has failed!");
         }
 
-        if(current_object.type == Plane){
+        int num_restored;
 
-            normal[0] = current_object.plane.normal[0];
-            normal[1] = current_object.plane.normal[1];
-            normal[2] = current_object.plane.normal[2];
+        if(!checkpoint_open(&journal, checkpoint_file, scene_digest, &options, pixmap, resume, done_tiles,
+                            &num_restored)) {
+            exit(1);
         }
 
-        v3_normalize(normal, normal);
-        
-        float reflection_vector[3];
-        v3_reflect(reflection_vector, rd, normal);
-
-        float t = -1;
-        float smallest_t = INFINITY;
-        int closest_to_object_index = -1;
-
-        // Find the closest object hit by the reflected ray, if it exists.
-        for(int object_index = 0; object_index < num_objects; object_index++){
-            
-            object iter_object = object_list[object_index];
-
-            // Skip over the current object to prevent floating point errors.
-            if(object_index != current_object_index){
-
-                if(iter_object.type == Sphere){  
-                    
-                    t = sphere_intersection(reflection_vector, intersection, iter_object.center, iter_object.sphere.radius);
-                }
-
-                if(iter_object.type == Plane){
-                    
-                    t = plane_intersection(reflection_vector, intersection, iter_object.center, iter_object.plane.normal); 
-                }
-
-                if(t >= 0.0){
-
-                    if(t < smallest_t){
-
-                        smallest_t = t;
-                        closest_to_object_index = object_index;
-                    }
-                }
-            }
+        if(resume) {
+            printf("Resuming with %d of %d tiles from %s\n", num_restored, rt_tile_count(&options),
+                   checkpoint_file);
         }
 
-        // Check for an intersection.
-        if(smallest_t < INFINITY){
-
-            // Calculate the intersection of the reflected ray.
-            float new_intersection[3] = {reflection_vector[0], reflection_vector[1], reflection_vector[2]};
-            v3_scale(new_intersection, smallest_t);
-            v3_add(new_intersection, new_intersection, intersection);
-
-            // Since there is an intersection, recurse.
-            reflection(object_list, num_objects, light_list, num_lights,
-                        new_intersection, reflection_vector, closest_to_object_index, 
-                        level + 1, reflected_color, texture_list);
-
-        }
-
-        float I[3] = {0, 0, 0};
-
-        // Apply all lights to the current object.
-        apply_lights(object_list, num_objects, light_list, num_lights, texture_list,
-            intersection, rd, current_object_index, I);
-
-        // Calculate the opaque color.
-        v3_scale(I, 1.0 - current_object.reflectivity);
+        options.skip_tiles = done_tiles;
+    }
 
-        // Apply the reflectivity to the reflected color.
-        v3_scale(reflected_color, current_object.reflectivity);
+    FILE *outfile = fopen(output_file, format == FormatP3 ? "w" : "wb");
 
-        // Add the opaque color to the reflected color and store it in
-        // returned_color
-        v3_add(returned_color, I, reflected_color);
+    if(outfile == NULL) {
+        raytrace_fail("Could not open the output file.");
     }
-}
-
 
-int clamp(int color){
+    row_encoder encoder;
+    tile_listeners listeners = {checkpoint_file != NULL ? &journal : NULL, NULL};
 
-    if(color > 255){
+    // QOI and PNG rows are compressed on their own thread as the render
+    // finishes them.
+    if(format != FormatP3) {
 
-        color = 255;
+        if(!encoder_start(&encoder, outfile, format, pixmap, &options, done_tiles)) {
+            raytrace_fail("Could not start the image encoder.");
+        }
 
+        listeners.encoder = &encoder;
     }
 
-    if(color < 0){
-
-        color = 0;
-
+    if(listeners.journal != NULL || listeners.encoder != NULL) {
+        options.tile_done = notify_tile;
+        options.user_data = &listeners;
     }
 
-    return color;
-}
-
-
-// Takes in all of the information provided by the input file
-// and performs the raytraceing algorithm to generate an image that is then 
-// stored in the given pixmap.
-void raytrace(uint8_t *pixmap, float cam_width, float cam_height, object *object_list,
-                int num_objects, light *light_list, int num_lights, float user_width, 
-                float user_height, texture *texture_list) {
-    
-    // We assume the camera postion is at [0, 0, 0]
-    float camera_position[] = {0,0,0};
-
-    float viewplane_x;
-    float viewplane_y;
-    float viewplane_z = -1;
-
-    // This is how large each "window" will be in the frame
-    float pixwidth = cam_width / user_width;
-    float pixheight = cam_height / user_height;
-
-    int pixmap_index = 0;
-
-    // The camera is aimed directly down the z-axis.
-    float cam_center_x = 0;
-    float cam_center_y = 0;
-
-    for(int row_index = 0; row_index < user_height; row_index++){
-
-        // y coordinate of viewplane row
-        viewplane_y  = cam_center_y - (cam_height / 2) + (pixheight * (row_index + 0.5));
-
-        for(int col_index = 0; col_index < user_width; col_index++){
-
-            // x coordinate of viewplane column
-            viewplane_x = cam_center_x - (cam_width / 2) + (pixwidth * (col_index + 0.5));
-
-            // direction vector without t scalar
-            // viewplane_y is negated to account for ppm writer that writes
-            // in the negative-y direction.
-            float rd[3] = {viewplane_x, -viewplane_y, viewplane_z};
-            
-            v3_normalize(rd, rd);
-
-            object *closest_object = NULL;
-            float closest_to_camera_t = INFINITY;
-            int closest_to_camera_index;
-            float t;
-            
-            for(int object_index = 0; object_index < num_objects; object_index++){
-                
-                object iter_object = object_list[object_index];
-
-                if(iter_object.type == Sphere){  
-                    
-                    t = sphere_intersection(rd, camera_position, iter_object.center, iter_object.sphere.radius);
-                }
-
-                if(iter_object.type == Plane){
-                    
-                    t = plane_intersection(rd, camera_position, iter_object.center, iter_object.plane.normal); 
-                }
-
-                if(t >= 0.0){
-                    if(t < closest_to_camera_t){
-                        closest_object = &object_list[object_index];
-                        closest_to_camera_t = t;
-                        closest_to_camera_index = object_index;
-                    }
-                }
-
-            }
-
-            float color[3] = {0, 0, 0};
+    double phase_start = stats_now_ms();
 
-            if(closest_object != NULL){
-
-                float intersection[3] = {rd[0], rd[1], rd[2]};
-                v3_scale(intersection, closest_to_camera_t);
-                v3_add(intersection, intersection, camera_position);
-
-                reflection(object_list, num_objects, light_list, num_lights,
-                        intersection, rd, closest_to_camera_index, 0, color, texture_list);
-            }
-
-
-            pixmap[pixmap_index] = clamp((int) color[0]); // write R
-            pixmap[pixmap_index + 1] = clamp((int) color[1]); // write G
-            pixmap[pixmap_index + 2] = clamp((int) color[2]); // write B
+    // The image is generated using raytraceing and stored in the pixmap.
+    if(rt_render(context, current_scene, &options, pixmap) != RT_OK) {
 
-            pixmap_index+=3;
+        if(listeners.encoder != NULL) {
+            encoder_finish(&encoder, false);
         }
-    }
-}
-
-
-int main( int argc, char *argv[] ){
 
-    // Check to make sure there are enough arguments in the CLI
-    if (argc != 5) {
-        raytrace_fail( "Wrong number of arguments." );
+        printf("Error: %s\n", rt_context_error(context));
+        exit(1);
     }
 
-    // Retrieve the arguments from the CLI
-    float width = atof(argv[1]);
-    float height = atof(argv[2]);
-    char *input_file = argv[3];
-    char *output_file = argv[4];
-
-    // Get the lengths of the input and output names.
-    int length_input = strlen(input_file);
-    int length_output = strlen(output_file);
-
-    // Obtain the last four characters of the filenames.
-    const char *input_extension = &input_file[length_input - 6];
-    const char *output_extension = &output_file[length_output - 4];
-
-    if(strcmp(".scene", input_extension) != 0) {
-        raytrace_fail("Bad input argument.");
-    }
+    times.render_ms = stats_now_ms() - phase_start;
+    trace_event_end(main_trace, "render", phase_start, "\"width\": %d, \"height\": %d, "
+                    "\"threads\": %d", (int) width, (int) height, num_threads);
 
-    if(strcmp(".ppm", output_extension) != 0) {
-        raytrace_fail("Bad output argument");
-    }
+    phase_start = stats_now_ms();
 
-    // Open the input file for reading.
-    FILE *infile = fopen(input_file, "r"); 
+    const char *format_names[] = {"P3", "QOI", "PNG"};
 
-    // Initialize variables to be retrieved from the camera header.
-    float camera_width;
-    float camera_height;
+    if(format != FormatP3) {
 
-    // infile is returned to maintain the pointer's position after the camera header.
-    infile = get_camera(infile, &camera_width, &camera_height);
+        // Only what the encoder hadn't caught up on by the end of the
+        // render counts as encode time.
+        if(!encoder_finish(&encoder, true)) {
+            raytrace_fail("Could not write the output file.");
+        }
 
-    // Check for proper values to confirm proper parsing.
-    // printf("Camera Width: %f, Camera Height: %f", camera_width, camera_height);
+    } else if(partial) {
 
-    // Initialize variables to keep track of the number of each object and light.
-    int num_objects;
-    int num_lights;
-    int num_textures;
+        // Records where the part goes for ppm-merge.
+        char comment[128];
+        snprintf(comment, sizeof(comment), "region %d %d %d %d of %d %d", region[0], region[1],
+                 region[2], region[3], (int) width, (int) height);
 
-    // Starter of the object list if we decide to use a dynamic array
-    // object *object_list = malloc(sizeof(object));
+        write_p3_comment(outfile, pixmap, region_width, region_height, max_val, comment);
 
-    object object_list[MAX_SIZE];
-    light light_list[MAX_SIZE];
-    texture texture_list[MAX_SIZE];
+    } else {
 
-    get_objects(infile, object_list, light_list, texture_list, &num_objects, 
-                &num_lights, &num_textures);
+        write_p3(outfile, pixmap, width, height, max_val);
+    }
 
-    printf("width: %d, height: %d first_val: %d", 
-            texture_list[2].width, texture_list[2].height, texture_list[2].pixmap[0]);
+    times.encode_ms = stats_now_ms() - phase_start;
+    trace_event_end(main_trace, "encode", phase_start, "\"format\": \"%s\"", format_names[format]);
+    printf("\n");
+    printf("File written as %s format", format_names[format]);
+    printf("\n");
 
-    fclose(infile);
+    if(pager != NULL) {
 
+        rt_texture_pager_stats pager_stats;
+        rt_texture_pager_get_stats(pager, &pager_stats);
 
-    // Iterates through the object list and prints the object info for error checking.
-    // For testing parses. Uncomment to easily view scene data.
+        printf("Texture tiles: %ld hits, %ld misses, %ld evictions, %.1f of %.1f MB resident\n",
+               pager_stats.hits, pager_stats.misses, pager_stats.evictions,
+               pager_stats.resident_bytes / (1024.0 * 1024), pager_stats.budget_bytes / (1024.0 * 1024));
 
-    // for(int index = 0; index < num_objects; index++) {
+        if(pager_stats.read_errors != 0) {
+            printf("Could not read %ld texture tiles; they were rendered black\n", pager_stats.read_errors);
+        }
+    }
 
-    //     printf("\nObject %d:", index+1);
-    //     if(object_list[index].type == Sphere) {
-    //         printf("\nType: Sphere,\nRadius: %f,", object_list[index].sphere.radius);
-    //     } else {
-    //         printf("\nType: Plane,\nNormal: [%f, %f, %f,],", 
-    //             object_list[index].plane.normal[0], object_list[index].plane.normal[1],
-    //             object_list[index].plane.normal[2]);
-    //     }
+    // Close the file since we're done writing to it. The journal is only
+    // removed below once the image is known to be on disk.
+    if((checkpoint_file != NULL && (fflush(outfile) != 0 || fsync(fileno(outfile)) != 0)) ||
+       fclose(outfile) != 0) {
+        raytrace_fail("Could not write the output file.");
+    }
 
-    //     printf("\nCenter: [%f, %f, %f], ", object_list[index].center[0], 
-    //         object_list[index].center[1], object_list[index].center[2]);
+    // A failure to cache costs the next identical render, not this one.
+    if(cache.directory != NULL) {
 
+        FILE *written = fopen(output_file, "rb");
 
-    //     printf("\nDiffuse Color: [%d, %d, %d],", object_list[index].diffuse_color[0], 
-    //         object_list[index].diffuse_color[1], object_list[index].diffuse_color[2]);
+        if(written == NULL || !render_cache_store(&cache, cache_name, written)) {
+            printf("Could not store the image in the render cache %s\n", cache.directory);
+        }
 
-    //     printf("\nSpecular Color: [%d, %d, %d]", object_list[index].specular_color[0], 
-    //         object_list[index].specular_color[1], object_list[index].specular_color[2]);
+        if(written != NULL) {
+            fclose(written);
+        }
+    }
 
-    //     printf("\nReflectivity: %f", object_list[index].reflectivity);
+    // The image is safely written, so the journal has done its job.
+    if(checkpoint_file != NULL) {
 
-    //     printf("\n\n");
+        checkpoint_close(&journal);
+        remove(checkpoint_file);
+        free(done_tiles);
+    }
 
-    // }
+    if(heatmap_file != NULL) {
 
+        FILE *heatmap_fp = fopen(heatmap_file, "w");
 
-    // Iterates through the light list and prints the object info for error checking.
-    // For testing parses or easily viewing the contents of the scene file.
-    
-    // for(int index = 0; index < num_lights; index++) {
+        if(heatmap_fp == NULL) {
+            raytrace_fail("Could not open the heatmap file.");
+        }
 
-    //     printf("\nLight %d:", index+1);
-    //     if(light_list[index].theta == 0) {
-    //         printf("\nType: Point Light,");
-    //     } else {
-    //         printf("\nType: Spot Light,\nAngular a0: %f,\nDirection: [%f, %f, %f]", 
-    //             light_list[index].angular_a0, 
-    //             light_list[index].direction[0], light_list[index].direction[1],
-    //             light_list[index].direction[2]);
-    //         printf("\nCosine of Theta: %f", light_list[index].cosine);
-    //     }
+        float max_cost = write_heatmap(heatmap_fp, &heat);
 
-    //     printf("\nCenter: [%f, %f, %f],", light_list[index].center[0], 
-    //         light_list[index].center[1], light_list[index].center[2]);
+        fclose(heatmap_fp);
+        free(heat.cost);
 
-    //     printf("\nColor: [%f, %f, %f]", light_list[index].color[0], 
-    //         light_list[index].color[1], light_list[index].color[2]);
+        if(max_cost < 0) {
+            raytrace_fail("Memory allocation for the heatmap image has failed!");
+        }
 
-    //     printf("\nRadial: [%f, %f, %f],", light_list[index].radial[0], 
-    //         light_list[index].radial[1], light_list[index].radial[2]);
+        printf("Heatmap written to %s (most expensive pixel: %.0f)\n", heatmap_file, max_cost);
+    }
 
-    //     printf("\nTheta: %f", light_list[index].theta);
+    if(write_stats) {
 
-    //     printf("\n\n");
+        // OUTPUT.ppm -> OUTPUT.stats.json
+        char stats_file[length_output + strlen(".stats.json") + 1];
+        snprintf(stats_file, sizeof(stats_file), "%.*s.stats.json", length_output - 4, output_file);
 
-    // }
+        FILE *stats_fp = fopen(stats_file, "w");
 
-    int arr_length = width * height;
-    int max_val = 255;
+        if(stats_fp == NULL) {
+            raytrace_fail("Could not open the stats file.");
+        }
 
-    // Allocate the memory for the pixmap.
-    uint8_t *pixmap = malloc(sizeof(uint8_t) * arr_length * 3);
+        write_stats_json(stats_fp, rt_context_stats(context), &times, region_width, region_height,
+                         num_threads);
 
-    if(pixmap == NULL) {
-    printf("Error: Memory allocation for pixmap has failed!");
-    exit(1);
+        fclose(stats_fp);
     }
 
-    printf("\nRaytracing scene with %d objects...\n", num_objects);
+    if(trace_file != NULL) {
 
-    // The image is generated using raytraceing and stored in the pixmap.
-    raytrace(pixmap, camera_width, camera_height, object_list, num_objects, light_list, num_lights,
-        width, height, texture_list);
+        FILE *trace_fp = fopen(trace_file, "w");
 
-    // Close the file since we're done reading from it.
-    
-    FILE *outfile = fopen(output_file, "w");
+        if(trace_fp == NULL) {
+            raytrace_fail("Could not open the trace file.");
+        }
 
-    write_p3(outfile, pixmap, width, height, max_val);
-    printf("\n");
-    printf("File written as P3 format");
-    printf("\n");
+        write_trace_json(trace_fp, &trace);
 
-    // Close the file since we're done writing to it.
-    fclose(outfile);
+        fclose(trace_fp);
+        trace_free(&trace);
+    }
 
     // Free the malloc now that we're done using it.
     free(pixmap);
 
-    for(int i = 0; i < num_textures; i++) {
-
-        free(texture_list[i].pixmap);
-
-    }
+    rt_context_free(context);
+    rt_scene_free(current_scene);
+    rt_texture_pager_free(pager);
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,955 @@
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "rt.h"
+#include "ppmrw.h"
+#include "rendercache.h"
+#include "texpage.h"
+
+// Render server. Listens on a Unix domain socket and keeps parsed scenes and
+// texture pixmaps in memory between jobs, so rendering the same scene again,
+// even at another size, skips the parse and the texture reads. With
+// --render-cache, finished images are kept on disk too, and a request for an
+// image already rendered is answered from there without rendering. With
+// --texture-mem, image textures are paged in tiles under that budget
+// instead of being held whole.
+//
+// Each connection sends one request per line and gets one reply per request:
+//
+//   RENDER width=W height=H scene=PATH [threads=N] [format=p6|p3] [output=PATH]
+//   RENDER width=W height=H inline=BYTES ...   followed by BYTES of scene text
+//   STATS
+//
+//   OK BYTES        followed by BYTES of PPM image, when no output is given
+//   OK path PATH    after writing the image to PATH
+//   OK {json}       for STATS
+//   ERR CODE MESSAGE  where CODE is the rt_status
+//
+// Paths are resolved against the server's working directory and may not
+// contain spaces. threads may be at most the number of CPUs, or
+// --threads-per-job if that is more.
+
+// Accepted connections that can wait for a free worker.
+#define SERVER_QUEUE_SIZE 128
+
+typedef struct {
+
+    char *filename;
+    time_t mtime;
+    off_t size;
+
+    rt_scene *loaded;
+
+    // rt_scene_digest() of loaded, when there is a render cache.
+    uint8_t digest[32];
+
+    // Jobs rendering the scene; only unused entries are evicted.
+    int refs;
+    uint64_t last_used;
+
+} cached_scene;
+
+typedef struct {
+
+    int num_workers;
+    int threads_per_job;
+    int scene_capacity;
+
+    rt_texture_cache *textures;
+
+    // NULL without --texture-mem.
+    rt_texture_pager *pager;
+
+    // directory is NULL without a render cache.
+    render_cache renders;
+
+    pthread_mutex_t scene_lock;
+    cached_scene **scenes;
+    int num_scenes;
+    uint64_t clock;
+    long scene_hits;
+    long scene_misses;
+    long render_hits;
+    long render_misses;
+    long jobs;
+
+    // Accepted connections waiting for a worker, as a ring buffer.
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_ready;
+    int queue[SERVER_QUEUE_SIZE];
+    int queue_head;
+    int queue_count;
+
+} server;
+
+typedef struct {
+
+    server *owner;
+    rt_context *context;
+
+} server_worker;
+
+// Removed when the server is interrupted.
+const char *server_socket_path;
+
+
+void raytraced_fail(char *s) {
+
+    printf("Error: %s\n\n", s);
+    printf("Usage:\n");
+    printf("raytraced [--socket PATH] [--workers N] [--threads-per-job N]\n");
+    printf("          [--scene-cache SCENES] [--texture-cache MB]\n");
+    printf("          [--render-cache DIR] [--render-cache-size MB]\n");
+    printf("          [--texture-mem SIZE]\n\n");
+    exit(1);
+}
+
+void raytraced_stop(int signal_number){
+
+    (void) signal_number;
+    unlink(server_socket_path);
+    _exit(0);
+}
+
+// Drops unused scenes, oldest first, until no more than scene_capacity are
+// cached. Called with scene_lock held.
+void scene_cache_evict(server *owner){
+
+    while(owner->num_scenes > owner->scene_capacity){
+
+        int oldest = -1;
+
+        for(int scene_index = 0; scene_index < owner->num_scenes; scene_index++){
+
+            cached_scene *entry = owner->scenes[scene_index];
+
+            if(entry->refs == 0 && (oldest < 0 || entry->last_used < owner->scenes[oldest]->last_used)){
+
+                oldest = scene_index;
+            }
+        }
+
+        if(oldest < 0){
+
+            return;
+        }
+
+        cached_scene *entry = owner->scenes[oldest];
+
+        rt_scene_free(entry->loaded);
+        free(entry->filename);
+        free(entry);
+
+        owner->num_scenes--;
+        owner->scenes[oldest] = owner->scenes[owner->num_scenes];
+    }
+}
+
+// Returns the entry for filename as it is on disk, or NULL. Called with
+// scene_lock held.
+cached_scene *scene_cache_find(server *owner, const char *filename, struct stat *info){
+
+    for(int scene_index = 0; scene_index < owner->num_scenes; scene_index++){
+
+        cached_scene *entry = owner->scenes[scene_index];
+
+        if(entry->mtime == info->st_mtime && entry->size == info->st_size &&
+           strcmp(entry->filename, filename) == 0){
+
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+// Finds or loads the scene in filename and holds it until
+// scene_cache_release(). An edited file is loaded again.
+rt_status scene_cache_acquire(server *owner, const char *filename, cached_scene **acquired,
+                              rt_error *error){
+
+    struct stat info;
+
+    if(stat(filename, &info) != 0){
+
+        snprintf(error->message, sizeof(error->message), "Could not open the input file %s.", filename);
+
+        return RT_ERROR_IO;
+    }
+
+    pthread_mutex_lock(&owner->scene_lock);
+
+    cached_scene *entry = scene_cache_find(owner, filename, &info);
+
+    if(entry != NULL){
+
+        owner->scene_hits++;
+
+    } else {
+
+        owner->scene_misses++;
+
+        // Load without the lock so jobs on other scenes keep going.
+        pthread_mutex_unlock(&owner->scene_lock);
+
+        // Parsed by as many threads as a job renders with, so one large
+        // scene can't take every CPU from the other workers.
+        rt_load_options load_options = {.textures = owner->textures, .pager = owner->pager,
+                                        .num_threads = owner->threads_per_job};
+        rt_scene *loaded;
+
+        rt_status status = rt_scene_load_file(&loaded, filename, &load_options, error);
+
+        if(status != RT_OK){
+
+            return status;
+        }
+
+        uint8_t digest[32];
+
+        if(owner->renders.directory != NULL){
+
+            rt_scene_digest(loaded, digest);
+        }
+
+        pthread_mutex_lock(&owner->scene_lock);
+
+        // Another job may have loaded the same file in the meantime.
+        entry = scene_cache_find(owner, filename, &info);
+
+        if(entry != NULL){
+
+            rt_scene_free(loaded);
+
+        } else {
+
+            entry = calloc(1, sizeof(cached_scene));
+            cached_scene **scenes = realloc(owner->scenes, sizeof(cached_scene *) * (owner->num_scenes + 1));
+
+            if(scenes != NULL){
+
+                owner->scenes = scenes;
+            }
+
+            if(entry == NULL || scenes == NULL || (entry->filename = strdup(filename)) == NULL){
+
+                pthread_mutex_unlock(&owner->scene_lock);
+
+                free(entry);
+                rt_scene_free(loaded);
+
+                snprintf(error->message, sizeof(error->message), "Memory allocation for the scene cache has failed!");
+
+                return RT_ERROR_NO_MEMORY;
+            }
+
+            entry->mtime = info.st_mtime;
+            entry->size = info.st_size;
+            entry->loaded = loaded;
+            memcpy(entry->digest, digest, sizeof(digest));
+
+            owner->scenes[owner->num_scenes] = entry;
+            owner->num_scenes++;
+        }
+    }
+
+    entry->refs++;
+    entry->last_used = ++owner->clock;
+
+    scene_cache_evict(owner);
+
+    pthread_mutex_unlock(&owner->scene_lock);
+
+    *acquired = entry;
+
+    return RT_OK;
+}
+
+void scene_cache_release(server *owner, cached_scene *entry){
+
+    pthread_mutex_lock(&owner->scene_lock);
+
+    entry->refs--;
+    entry->last_used = ++owner->clock;
+
+    scene_cache_evict(owner);
+
+    pthread_mutex_unlock(&owner->scene_lock);
+}
+
+void reply_error(FILE *out, rt_status status, const char *message){
+
+    fprintf(out, "ERR %d %s\n", status, message);
+}
+
+void handle_stats(server *owner, FILE *out){
+
+    rt_texture_cache_stats texture_stats;
+    rt_texture_cache_get_stats(owner->textures, &texture_stats);
+
+    rt_texture_pager_stats tile_stats = {0};
+
+    if(owner->pager != NULL){
+
+        rt_texture_pager_get_stats(owner->pager, &tile_stats);
+    }
+
+    pthread_mutex_lock(&owner->scene_lock);
+
+    fprintf(out, "OK {\"jobs\": %ld, \"scenes\": %d, \"scene_hits\": %ld, \"scene_misses\": %ld, "
+            "\"textures\": %d, \"texture_bytes\": %zu, \"texture_hits\": %ld, \"texture_misses\": %ld, "
+            "\"render_hits\": %ld, \"render_misses\": %ld, \"tile_bytes\": %zu, \"tile_hits\": %ld, "
+            "\"tile_misses\": %ld, \"tile_evictions\": %ld}\n",
+            owner->jobs, owner->num_scenes, owner->scene_hits, owner->scene_misses,
+            texture_stats.num_textures, texture_stats.bytes, texture_stats.hits, texture_stats.misses,
+            owner->render_hits, owner->render_misses, tile_stats.resident_bytes, tile_stats.hits,
+            tile_stats.misses, tile_stats.evictions);
+
+    pthread_mutex_unlock(&owner->scene_lock);
+}
+
+// Replies with the cached image called name, to output_file if that isn't
+// NULL. Returns false, having done nothing, if there is no such image.
+bool reply_cached(server *owner, const char *name, const char *output_file, FILE *out){
+
+    long length;
+    FILE *cached = render_cache_open(&owner->renders, name, &length);
+
+    pthread_mutex_lock(&owner->scene_lock);
+
+    if(cached != NULL){
+
+        owner->render_hits++;
+        owner->jobs++;
+
+    } else {
+
+        owner->render_misses++;
+    }
+
+    pthread_mutex_unlock(&owner->scene_lock);
+
+    if(cached == NULL){
+
+        return false;
+    }
+
+    if(output_file != NULL){
+
+        FILE *outfile = fopen(output_file, "w");
+
+        if(outfile == NULL){
+
+            reply_error(out, RT_ERROR_IO, "Could not open the output file.");
+
+        } else {
+
+            bool copied = render_cache_copy(cached, outfile);
+
+            if(fclose(outfile) != 0 || !copied){
+
+                reply_error(out, RT_ERROR_IO, "Could not write the output file.");
+
+            } else {
+
+                fprintf(out, "OK path %s\n", output_file);
+            }
+        }
+
+    } else {
+
+        fprintf(out, "OK %ld\n", length);
+        render_cache_copy(cached, out);
+    }
+
+    fclose(cached);
+
+    return true;
+}
+
+// Stores image as the cached image called name once the reply is on its
+// way. A failure only costs the next identical request a render.
+void store_render(server *owner, const char *name, FILE *image, FILE *out){
+
+    if(image != NULL){
+
+        fflush(out);
+        render_cache_store(&owner->renders, name, image);
+        fclose(image);
+    }
+}
+
+// Reads and discards the next length bytes of in. Returns false if the
+// stream ends first.
+bool skip_input(FILE *in, long length){
+
+    char buffer[4096];
+
+    while(length > 0){
+
+        size_t chunk = length < (long) sizeof(buffer) ? (size_t) length : sizeof(buffer);
+
+        if(fread(buffer, 1, chunk, in) != chunk){
+
+            return false;
+        }
+
+        length = length - chunk;
+    }
+
+    return true;
+}
+
+// Runs one RENDER request; arguments is the rest of its line.
+void handle_render(server *owner, rt_context *context, char *arguments, FILE *in, FILE *out){
+
+    int width = 0;
+    int height = 0;
+    int num_threads = owner->threads_per_job;
+    bool use_p3 = false;
+    char *scene_file = NULL;
+    long inline_length = -1;
+    char *output_file = NULL;
+
+    // The first problem with the arguments; reported only once the inline
+    // text, which may be named after it, has been read.
+    const char *argument_error = NULL;
+
+    // A job may use as many threads as the machine has, or as the server
+    // was told to give each job, but no more; each one costs a stack.
+    int max_threads = rt_default_thread_count() > owner->threads_per_job ? rt_default_thread_count() :
+                      owner->threads_per_job;
+
+    char *saveptr;
+
+    for(char *token = strtok_r(arguments, " \n", &saveptr); token != NULL;
+        token = strtok_r(NULL, " \n", &saveptr)){
+
+        char *value = strchr(token, '=');
+
+        if(value == NULL){
+
+            if(argument_error == NULL){
+
+                argument_error = "Expected key=value arguments.";
+            }
+
+            continue;
+        }
+
+        *value++ = '\0';
+
+        if(strcmp(token, "width") == 0){
+
+            width = atoi(value);
+
+        } else if(strcmp(token, "height") == 0){
+
+            height = atoi(value);
+
+        } else if(strcmp(token, "threads") == 0){
+
+            num_threads = atoi(value);
+
+            if((num_threads < 1 || num_threads > max_threads) && argument_error == NULL){
+
+                argument_error = "threads must be from 1 to the number of CPUs or --threads-per-job.";
+            }
+
+        } else if(strcmp(token, "format") == 0 && (strcmp(value, "p3") == 0 || strcmp(value, "p6") == 0)){
+
+            use_p3 = strcmp(value, "p3") == 0;
+
+        } else if(strcmp(token, "scene") == 0){
+
+            scene_file = value;
+
+        } else if(strcmp(token, "inline") == 0){
+
+            inline_length = atol(value);
+
+        } else if(strcmp(token, "output") == 0){
+
+            output_file = value;
+
+        } else if(argument_error == NULL){
+
+            argument_error = "Unknown argument.";
+        }
+    }
+
+    // The inline text has to be consumed even if the request is refused, or
+    // it would be read as the next request.
+    char *scene_text = NULL;
+
+    if(inline_length > 0){
+
+        if(argument_error != NULL){
+
+            if(!skip_input(in, inline_length)){
+
+                reply_error(out, RT_ERROR_IO, "Could not read the inline scene.");
+                return;
+            }
+
+        } else {
+
+            scene_text = malloc(inline_length);
+
+            if(scene_text == NULL){
+
+                bool skipped = skip_input(in, inline_length);
+
+                reply_error(out, skipped ? RT_ERROR_NO_MEMORY : RT_ERROR_IO,
+                            skipped ? "Memory allocation for the inline scene has failed!" : "Could not read the inline scene.");
+                return;
+            }
+
+            if(fread(scene_text, 1, inline_length, in) != (size_t) inline_length){
+
+                free(scene_text);
+                reply_error(out, RT_ERROR_IO, "Could not read the inline scene.");
+                return;
+            }
+        }
+    }
+
+    if(argument_error != NULL){
+
+        reply_error(out, RT_ERROR_INVALID_ARGUMENT, argument_error);
+        return;
+    }
+
+    if(width <= 0 || height <= 0 || (scene_file == NULL) == (scene_text == NULL)){
+
+        free(scene_text);
+        reply_error(out, RT_ERROR_INVALID_ARGUMENT, "Needs a positive width and height and one of scene or inline.");
+        return;
+    }
+
+    rt_error error;
+    cached_scene *entry = NULL;
+    rt_scene *loaded;
+    rt_status status;
+
+    if(scene_file != NULL){
+
+        status = scene_cache_acquire(owner, scene_file, &entry, &error);
+        loaded = entry != NULL ? entry->loaded : NULL;
+
+    } else {
+
+        // Inline scenes are rarely repeated, so only their textures are cached.
+        rt_load_options load_options = {.textures = owner->textures, .pager = owner->pager,
+                                        .num_threads = num_threads};
+
+        status = rt_scene_load_memory(&loaded, scene_text, inline_length, &load_options, &error);
+        free(scene_text);
+    }
+
+    if(status != RT_OK){
+
+        reply_error(out, status, error.message);
+        return;
+    }
+
+    rt_render_options options;
+    rt_render_options_init(&options, width, height);
+
+    options.num_threads = num_threads;
+
+    char cache_name[RENDER_CACHE_NAME_SIZE];
+
+    if(owner->renders.directory != NULL){
+
+        uint8_t scene_digest[32];
+        uint8_t key[32];
+
+        if(entry != NULL){
+
+            memcpy(scene_digest, entry->digest, sizeof(scene_digest));
+
+        } else {
+
+            rt_scene_digest(loaded, scene_digest);
+        }
+
+        rt_render_digest(scene_digest, &options, key);
+        render_cache_name(key, use_p3 ? "p3" : "p6", cache_name);
+
+        if(reply_cached(owner, cache_name, output_file, out)){
+
+            if(entry != NULL){
+
+                scene_cache_release(owner, entry);
+
+            } else {
+
+                rt_scene_free(loaded);
+            }
+
+            return;
+        }
+    }
+
+    uint8_t *pixmap = malloc(sizeof(uint8_t) * width * height * 3);
+
+    if(pixmap == NULL){
+
+        status = RT_ERROR_NO_MEMORY;
+        snprintf(error.message, sizeof(error.message), "Memory allocation for pixmap has failed!");
+
+    } else {
+
+        status = rt_render(context, loaded, &options, pixmap);
+        snprintf(error.message, sizeof(error.message), "%s", rt_context_error(context));
+    }
+
+    if(entry != NULL){
+
+        scene_cache_release(owner, entry);
+
+    } else {
+
+        rt_scene_free(loaded);
+    }
+
+    pthread_mutex_lock(&owner->scene_lock);
+    owner->jobs++;
+    pthread_mutex_unlock(&owner->scene_lock);
+
+    if(status != RT_OK){
+
+        free(pixmap);
+        reply_error(out, status, error.message);
+        return;
+    }
+
+    if(output_file != NULL){
+
+        FILE *outfile = fopen(output_file, "w");
+
+        if(outfile == NULL){
+
+            reply_error(out, RT_ERROR_IO, "Could not open the output file.");
+
+        } else {
+
+            if(use_p3){
+
+                write_p3(outfile, pixmap, width, height, 255);
+
+            } else {
+
+                write_p6(outfile, pixmap, width, height, 255);
+            }
+
+            fclose(outfile);
+
+            fprintf(out, "OK path %s\n", output_file);
+
+            if(owner->renders.directory != NULL){
+
+                store_render(owner, cache_name, fopen(output_file, "rb"), out);
+            }
+        }
+
+    } else {
+
+        // Encode into memory first so the reply can lead with its length.
+        char *image;
+        size_t image_length;
+
+        FILE *image_fp = open_memstream(&image, &image_length);
+
+        if(image_fp == NULL){
+
+            reply_error(out, RT_ERROR_NO_MEMORY, "Memory allocation for the image has failed!");
+
+        } else {
+
+            if(use_p3){
+
+                write_p3(image_fp, pixmap, width, height, 255);
+
+            } else {
+
+                write_p6(image_fp, pixmap, width, height, 255);
+            }
+
+            fclose(image_fp);
+
+            fprintf(out, "OK %zu\n", image_length);
+            fwrite(image, 1, image_length, out);
+
+            if(owner->renders.directory != NULL){
+
+                store_render(owner, cache_name, fmemopen(image, image_length, "rb"), out);
+            }
+
+            free(image);
+        }
+    }
+
+    free(pixmap);
+}
+
+// Serves requests on one connection until the client closes it.
+void serve_connection(server *owner, rt_context *context, int connection){
+
+    FILE *in = fdopen(connection, "r");
+    FILE *out = fdopen(dup(connection), "w");
+
+    if(in == NULL || out == NULL){
+
+        if(in != NULL){
+
+            fclose(in);
+
+        } else {
+
+            close(connection);
+        }
+
+        if(out != NULL){
+
+            fclose(out);
+        }
+
+        return;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+
+    while(getline(&line, &line_capacity, in) > 0){
+
+        if(strncmp(line, "RENDER ", 7) == 0){
+
+            handle_render(owner, context, &line[7], in, out);
+
+        } else if(strcmp(line, "STATS\n") == 0){
+
+            handle_stats(owner, out);
+
+        } else {
+
+            reply_error(out, RT_ERROR_INVALID_ARGUMENT, "Unknown request.");
+        }
+
+        if(fflush(out) != 0){
+
+            break;
+        }
+    }
+
+    free(line);
+    fclose(in);
+    fclose(out);
+}
+
+void *server_worker_main(void *arg){
+
+    server_worker *worker = arg;
+    server *owner = worker->owner;
+
+    for(;;){
+
+        pthread_mutex_lock(&owner->queue_lock);
+
+        while(owner->queue_count == 0){
+
+            pthread_cond_wait(&owner->queue_ready, &owner->queue_lock);
+        }
+
+        int connection = owner->queue[owner->queue_head];
+
+        owner->queue_head = (owner->queue_head + 1) % SERVER_QUEUE_SIZE;
+        owner->queue_count--;
+
+        pthread_mutex_unlock(&owner->queue_lock);
+
+        serve_connection(owner, worker->context, connection);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[]){
+
+    char *socket_path = "raytraced.sock";
+    long texture_cache_mb = 512;
+    long render_cache_mb = 1024;
+    size_t texture_mem = 0;
+
+    server owner = {0};
+
+    owner.num_workers = rt_default_thread_count();
+    owner.threads_per_job = 1;
+    owner.scene_capacity = 16;
+
+    for(int arg = 1; arg < argc; arg++){
+
+        // Every option takes one value.
+        if(arg + 1 >= argc){
+
+            raytraced_fail("Missing option value.");
+        }
+
+        if(strcmp(argv[arg], "--socket") == 0){
+
+            socket_path = argv[++arg];
+
+        } else if(strcmp(argv[arg], "--workers") == 0){
+
+            owner.num_workers = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--threads-per-job") == 0){
+
+            owner.threads_per_job = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--scene-cache") == 0){
+
+            owner.scene_capacity = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--texture-cache") == 0){
+
+            texture_cache_mb = atol(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--render-cache") == 0){
+
+            owner.renders.directory = argv[++arg];
+
+        } else if(strcmp(argv[arg], "--render-cache-size") == 0){
+
+            render_cache_mb = atol(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--texture-mem") == 0){
+
+            if(!parse_memory_size(argv[++arg], &texture_mem)){
+
+                raytraced_fail("--texture-mem needs a size like 512M or 2G.");
+            }
+
+        } else {
+
+            raytraced_fail("Unknown option.");
+        }
+    }
+
+    if(owner.num_workers < 1 || owner.threads_per_job < 1 || owner.scene_capacity < 0 ||
+       texture_cache_mb < 0 || render_cache_mb < 1){
+
+        raytraced_fail("Counts must be positive.");
+    }
+
+    struct sockaddr_un address = {0};
+
+    address.sun_family = AF_UNIX;
+
+    if(strlen(socket_path) >= sizeof(address.sun_path)){
+
+        raytraced_fail("Socket path is too long.");
+    }
+
+    strcpy(address.sun_path, socket_path);
+
+    owner.renders.max_bytes = render_cache_mb * 1024LL * 1024;
+
+    if(owner.renders.directory != NULL && !render_cache_init(&owner.renders)){
+
+        raytraced_fail("Could not create the render cache directory.");
+    }
+
+    owner.textures = rt_texture_cache_create((size_t) texture_cache_mb * 1024 * 1024);
+
+    if(owner.textures == NULL){
+
+        raytraced_fail("Memory allocation for the texture cache has failed!");
+    }
+
+    if(texture_mem != 0 && (owner.pager = rt_texture_pager_create(texture_mem)) == NULL){
+
+        raytraced_fail("Memory allocation for the texture pager has failed!");
+    }
+
+    pthread_mutex_init(&owner.scene_lock, NULL);
+    pthread_mutex_init(&owner.queue_lock, NULL);
+    pthread_cond_init(&owner.queue_ready, NULL);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    // A socket left behind by a previous run would make bind() fail.
+    unlink(socket_path);
+
+    if(listener < 0 || bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+       listen(listener, 64) != 0){
+
+        raytraced_fail("Could not listen on the socket.");
+    }
+
+    server_socket_path = socket_path;
+
+    signal(SIGINT, raytraced_stop);
+    signal(SIGTERM, raytraced_stop);
+
+    // Clients that hang up mid-reply show up as write errors instead.
+    signal(SIGPIPE, SIG_IGN);
+
+    server_worker *workers = malloc(sizeof(server_worker) * owner.num_workers);
+    pthread_t *threads = malloc(sizeof(pthread_t) * owner.num_workers);
+
+    if(workers == NULL || threads == NULL){
+
+        raytraced_fail("Memory allocation for the worker threads has failed!");
+    }
+
+    for(int worker_index = 0; worker_index < owner.num_workers; worker_index++){
+
+        workers[worker_index].owner = &owner;
+        workers[worker_index].context = rt_context_create();
+
+        if(workers[worker_index].context == NULL ||
+           pthread_create(&threads[worker_index], NULL, server_worker_main, &workers[worker_index]) != 0){
+
+            raytraced_fail("Could not start the worker threads.");
+        }
+    }
+
+    printf("Listening on %s with %d workers\n", socket_path, owner.num_workers);
+    fflush(stdout);
+
+    for(;;){
+
+        int connection = accept(listener, NULL, NULL);
+
+        if(connection < 0){
+
+            continue;
+        }
+
+        pthread_mutex_lock(&owner.queue_lock);
+
+        if(owner.queue_count == SERVER_QUEUE_SIZE){
+
+            pthread_mutex_unlock(&owner.queue_lock);
+
+            dprintf(connection, "ERR %d Too many connections waiting.\n", RT_ERROR_NO_MEMORY);
+            close(connection);
+
+            continue;
+        }
+
+        owner.queue[(owner.queue_head + owner.queue_count) % SERVER_QUEUE_SIZE] = connection;
+        owner.queue_count++;
+
+        pthread_cond_signal(&owner.queue_ready);
+        pthread_mutex_unlock(&owner.queue_lock);
+    }
+
+    return 0;
+}
@@ -0,0 +1,1132 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "render.h"
+#include "fastmath.h"
+
+// Width and height of the square tiles handed to render workers.
+const int TILE_SIZE = 32;
+
+// How far, as a fraction of the distance to the light, a shadow ray may stop
+// short of a point on a mesh and still count as reaching it.
+#define MESH_SHADOW_TOLERANCE 1e-3f
+
+float sphere_intersection(float *rd, float *ro, float *center, float radius_squared){
+        
+    float x_diff = ro[0] - center[0];
+    float y_diff = ro[1] - center[1];
+    float z_diff = ro[2] - center[2];      
+
+    //float a = pow(rd[0], 2) + pow(rd[1], 2) + pow(rd[2], 2);
+    float b = 2 * (rd[0] * x_diff + rd[1] * y_diff + rd[2] * z_diff);
+    float c = x_diff * x_diff + y_diff * y_diff + z_diff * z_diff;
+          c = c - radius_squared;
+
+    float discrim = b * b - 4 * c;
+
+    if(discrim >= 0.0){
+
+        float t0 = (-b - sqrt(discrim)) / 2;
+
+        if(t0 > 0.0){
+
+            return t0;
+
+        } else {
+
+            float t1 = (-b + sqrt(discrim)) / 2;
+            return t1;
+        }
+
+    } else {
+        // return -1 to indicate that there is no intersection
+        return -1;
+    }    
+}
+
+
+float plane_intersection(float *rd, float *ro, float *center, float *normal){
+
+    float vd = v3_dot_product(normal, rd);
+
+    if(vd > 0.0){
+
+        return -1;
+
+    } else {
+            
+        float numerator_comp[3] = {0,0,0};       
+        v3_subtract(numerator_comp, center, ro);
+    
+        float vn = v3_dot_product(numerator_comp, normal);
+
+        return vn / vd;   
+    }
+}
+
+
+// Unit normal of the mesh triangle in hit, turned to face against rd since
+// triangles are seen from both sides.
+void mesh_facing_normal(object *mesh_object, const mesh_hit *hit, float *rd, float *normal){
+
+    mesh_normal(mesh_object->mesh.data, hit, normal);
+
+    if(v3_dot_product(normal, rd) > 0){
+
+        v3_scale(normal, -1);
+    }
+}
+
+// The mesh is tested in its own space, where the ray starts at
+// (ro - center) / scale and keeps its direction, so distances come back
+// divided by the scale.
+float mesh_object_intersection(object *mesh_object, float *rd, float *ro, mesh_hit *hit,
+                               render_stats *stats){
+
+    float local_ro[3];
+    v3_from_points(local_ro, mesh_object->center, ro);
+    v3_scale(local_ro, mesh_object->mesh.inv_scale);
+
+    float t = mesh_intersection(mesh_object->mesh.data, local_ro, rd, hit, &stats->triangle_tests);
+
+    return t >= 0 ? t * mesh_object->mesh.scale : -1;
+}
+
+// Dispatches to the intersection test for the object's shape and counts it.
+float object_intersection(object *iter_object, float *rd, float *ro, render_stats *stats){
+
+    if(iter_object->type == Sphere){
+
+        stats->sphere_tests++;
+
+        return sphere_intersection(rd, ro, iter_object->center, iter_object->sphere.radius_squared);
+    }
+
+    if(iter_object->type == Mesh){
+
+        return mesh_object_intersection(iter_object, rd, ro, NULL, stats);
+    }
+
+    stats->plane_tests++;
+
+    return plane_intersection(rd, ro, iter_object->center, iter_object->plane.normal);
+}
+
+
+float radial(float a2, float a1, float a0, float d){
+
+    float rad = a2 * (d*d) + a1*d + a0;
+
+    if(rad == 0){
+
+        return 0;
+
+    }
+    if(d == INFINITY){
+
+        return 1;
+
+    } else {
+
+        return 1 / rad;
+    }
+}
+
+
+float angular(light light, float *v_obj, bool fast_math){
+
+    if(light.theta == 0){
+
+        return 1;
+
+    } else {
+
+        float dot = v3_dot_product(v_obj, light.direction);
+
+        if(dot < light.cosine) {
+
+            return 0;
+
+        } else {
+
+            power_kernel power = fast_math ? light.angular_power_fast : light.angular_power;
+
+            return power(dot, light.angular_a0);
+        }
+    }
+
+}
+
+
+// Wraps a texel coordinate into [0, size) so textures tile instead of reading
+// outside of the pixmap.
+int wrap_texel(float coord, int size, float inv_size){
+
+    float texel = floor(coord);
+
+    texel = texel - size * floor(texel * inv_size);
+
+    int index = (int) texel;
+
+    // Guard against the rounding of texel * inv_size at the upper edge.
+    if(index >= size){
+
+        index = size - 1;
+
+    }
+
+    if(index < 0){
+
+        index = 0;
+
+    }
+
+    return index;
+}
+
+
+// Maps the intersection on hit_object to texture space and finds the texel
+// there.
+void texture_position(texture *obj_texture, object *hit_object, float *intersection, const mesh_hit *hit,
+                      bool fast_math, int *texel_row, int *texel_col){
+
+    float u;
+    float v;
+
+    if(hit_object->type == Sphere && fast_math) {
+
+        float theta = fast_atan2f(-(intersection[2] - hit_object->center[2]),
+                                  intersection[0] - hit_object->center[0]);
+        u = (theta + (float) M_PI) * (float) (0.5 / M_PI);
+        float fi = fast_acosf((-(intersection[1] - hit_object->center[1])) * hit_object->sphere.inv_radius);
+        v = fi * (float) M_1_PI;
+
+        u = u * obj_texture->width;
+        v = v * obj_texture->height;
+
+    } else if(hit_object->type == Sphere) {
+
+        float theta = atan2(-(intersection[2] - hit_object->center[2]), 
+                            intersection[0] - hit_object->center[0]);
+        u = (theta + M_PI) / (2 * M_PI);
+        float fi = acos((-(intersection[1] - hit_object->center[1])) * hit_object->sphere.inv_radius);
+        v = fi / M_PI;
+
+        //printf("\n(sphere)u: %f, v: %f", u, v);
+
+        u = u * obj_texture->width;
+        v = v * obj_texture->height;
+
+    } else if(hit_object->type == Mesh) {
+
+        float uv[2];
+        mesh_uv(hit_object->mesh.data, hit, uv);
+
+        u = uv[0] * obj_texture->width;
+        v = uv[1] * obj_texture->height;
+
+    } else {
+
+        u = v3_dot_product(intersection, hit_object->plane.texture_u);
+        v = v3_dot_product(intersection, hit_object->plane.texture_v);
+
+        u = fast_math ? fast_remainderf(u, 70) : remainder(u, 70.0);
+        v = fast_math ? fast_remainderf(v, 50) : remainder(v, 50.0);
+
+        u = u * 50;
+        v = v * 50;
+
+    }
+
+
+    *texel_row = wrap_texel(obj_texture->height - v, obj_texture->height, obj_texture->inv_height);
+    *texel_col = wrap_texel(u, obj_texture->width, obj_texture->inv_width);
+}
+
+uint8_t *texture_texel(texture *obj_texture, object *hit_object, float *intersection, const mesh_hit *hit,
+                       bool fast_math){
+
+    int texel_row;
+    int texel_col;
+
+    texture_position(obj_texture, hit_object, intersection, hit, fast_math, &texel_row, &texel_col);
+
+    return &obj_texture->pixmap[(texel_row * obj_texture->width + texel_col) * 3];
+}
+
+
+// Writes the color of obj_texture at intersection on hit_object to color,
+// 0 to 255 per channel. Patterns are evaluated relative to the object's
+// position, and scale with a mesh.
+void texture_color(texture *obj_texture, object *hit_object, float *intersection, const mesh_hit *hit,
+                   bool fast_math, float *color){
+
+    if(obj_texture->procedural.kind != NoPattern){
+
+        float local[3];
+        v3_from_points(local, hit_object->center, intersection);
+
+        if(hit_object->type == Mesh){
+
+            v3_scale(local, hit_object->mesh.inv_scale);
+        }
+
+        pattern_color(&obj_texture->procedural, local, color);
+
+        return;
+    }
+
+    if(obj_texture->paged != NULL){
+
+        int texel_row;
+        int texel_col;
+
+        texture_position(obj_texture, hit_object, intersection, hit, fast_math, &texel_row, &texel_col);
+        texture_pager_texel(obj_texture->paged, texel_row, texel_col, color);
+
+        return;
+    }
+
+    uint8_t *texel = texture_texel(obj_texture, hit_object, intersection, hit, fast_math);
+
+    color[0] = texel[0];
+    color[1] = texel[1];
+    color[2] = texel[2];
+}
+
+
+// Fills surface with what the lights shading intersection on lit_object
+// need; the texture, if any, is sampled here once for all of them.
+void shade_point(object *lit_object, material *material_list, texture *texture_list, float *intersection,
+                 float *rd, const mesh_hit *hit, bool fast_math, shade_surface *surface,
+                 render_stats *stats){
+
+    material *lit_material = &material_list[lit_object->material_index];
+
+    surface->sphere = lit_object->type == Sphere;
+
+    for(int axis = 0; axis < 3; axis++){
+
+        surface->center[axis] = lit_object->center[axis];
+        surface->normal[axis] = 0;
+        surface->view[axis] = rd[axis] * -1;
+        surface->specular[axis] = lit_material->specular_color[axis];
+    }
+
+    // Plane normals are already unit length after bake_scene().
+    if(lit_object->type == Plane){
+
+        surface->normal[0] = lit_object->plane.normal[0];
+        surface->normal[1] = lit_object->plane.normal[1];
+        surface->normal[2] = lit_object->plane.normal[2];
+    }
+
+    if(lit_object->type == Mesh){
+
+        mesh_facing_normal(lit_object, hit, rd, surface->normal);
+    }
+
+    if(lit_material->texture_index == -1) {
+
+        surface->diffuse[0] = lit_material->diffuse_color[0];
+        surface->diffuse[1] = lit_material->diffuse_color[1];
+        surface->diffuse[2] = lit_material->diffuse_color[2];
+
+    } else {
+
+        stats->texture_samples++;
+
+        texture_color(&texture_list[lit_material->texture_index], lit_object, intersection, hit, fast_math,
+                      surface->diffuse);
+    }
+
+    surface->shininess = lit_material->shininess;
+    surface->specular_power = fast_math ? lit_material->specular_power_fast : lit_material->specular_power;
+    surface->specular_exponent = lit_material->specular_exponent;
+    surface->specular_fast = fast_math && lit_material->specular_exponent < 0;
+}
+
+void apply_lights(object *object_list, int num_objects, light *light_list, int num_lights,
+                    texture *texture_list, material *material_list, float *intersection,
+                    float *rd, int subject_object_index, const mesh_hit *hit, float *I,
+                    const light_grid *grid, int *last_occluder, bool fast_math, render_stats *stats){
+
+    int num_candidates = num_lights;
+    const int *candidates = grid != NULL ? light_grid_lookup(grid, intersection, &num_candidates) : NULL;
+
+    stats->culled_lights += num_lights - num_candidates;
+
+    light_batch batch;
+    shade_surface surface;
+    bool have_surface = false;
+
+    batch.count = 0;
+
+    for(int candidate = 0; candidate < num_candidates; candidate++){
+
+        int light_index = candidates != NULL ? candidates[candidate] : candidate;
+        light iter_light = light_list[light_index];
+
+        float v_obj[3];
+        v3_from_points(v_obj, iter_light.center, intersection);
+
+        // Lights that can't reach the point, by distance or by cone, are
+        // dropped before their shadow ray is cast.
+        if(grid != NULL && v3_dot_product(v_obj, v_obj) > grid->radius_squared[light_index]){
+
+            stats->culled_lights++;
+
+            continue;
+        }
+
+        v3_normalize(v_obj, v_obj);
+
+        float f_ang = angular(iter_light, v_obj, fast_math);
+
+        if(f_ang == 0){
+
+            stats->culled_lights++;
+
+            continue;
+        }
+
+        float lit_object_t = INFINITY;
+        int lit_object_index = -1;
+        float light_t = -1;
+
+        stats->shadow_rays++;
+
+        // The object that blocked this light last time usually blocks it
+        // for the neighboring pixel too. If it is hit strictly nearer the
+        // light than the subject, the full scan could only find something
+        // other than the subject, so the point is in shadow.
+        int occluder = last_occluder != NULL ? last_occluder[light_index] : -1;
+        float occluder_t = -1;
+        float subject_t = -1;
+
+        if(occluder == subject_object_index){
+
+            occluder = -1;
+        }
+
+        if(occluder >= 0){
+
+            subject_t = object_intersection(&object_list[subject_object_index], v_obj, iter_light.center, stats);
+            occluder_t = object_intersection(&object_list[occluder], v_obj, iter_light.center, stats);
+
+            if(occluder_t >= 0.0 && occluder_t < subject_t){
+
+                stats->shadow_cache_hits++;
+
+                continue;
+            }
+
+            stats->shadow_cache_misses++;
+        }
+
+        for(int object_index = 0; object_index < num_objects; object_index++){
+
+            // On a miss the two objects already tested aren't tested again.
+            if(occluder >= 0 && object_index == occluder){
+
+                light_t = occluder_t;
+
+            } else if(occluder >= 0 && object_index == subject_object_index){
+
+                light_t = subject_t;
+
+            } else {
+
+                light_t = object_intersection(&object_list[object_index], v_obj, iter_light.center, stats);
+            }
+
+            if(light_t >= 0.0){
+                
+                if(light_t < lit_object_t){
+
+                    lit_object_index = object_index;
+                    lit_object_t = light_t;
+                }
+            }
+        }
+
+        if(last_occluder != NULL && lit_object_index >= 0 && lit_object_index != subject_object_index){
+
+            last_occluder[light_index] = lit_object_index;
+        }
+
+        float light_x_diff = intersection[0] - iter_light.center[0];
+        float light_y_diff = intersection[1] - iter_light.center[1];
+        float light_z_diff = intersection[2] - iter_light.center[2];
+
+        float distance;
+
+        if(fast_math){
+
+            distance = sqrtf(light_x_diff * light_x_diff + light_y_diff * light_y_diff +
+                             light_z_diff * light_z_diff);
+
+        } else {
+
+            distance = sqrt(pow(light_x_diff, 2) + pow(light_y_diff, 2) + pow(light_z_diff, 2));
+        }
+
+        // Another triangle of the same mesh can be in the way, so a mesh is
+        // only lit where the shadow ray reaches the point itself.
+        bool reaches_point = object_list[subject_object_index].type != Mesh ||
+                             fabsf(lit_object_t - distance) <= MESH_SHADOW_TOLERANCE * distance;
+
+        if(subject_object_index == lit_object_index && reaches_point){
+
+            // What the lights shade is the same for each of them, so it is
+            // worked out for the first. Lanes past the count are computed
+            // too, so they start out as zeros rather than stack garbage.
+            if(!have_surface){
+
+                memset(&batch, 0, sizeof(batch));
+
+                shade_point(&object_list[subject_object_index], material_list, texture_list, intersection,
+                            rd, hit, fast_math, &surface, stats);
+
+                have_surface = true;
+            }
+
+            int lane = batch.count;
+
+            for(int axis = 0; axis < 3; axis++){
+
+                batch.direction[axis][lane] = v_obj[axis];
+                batch.color[axis][lane] = iter_light.color[axis];
+                batch.radial[axis][lane] = iter_light.radial[axis];
+            }
+
+            batch.distance[lane] = distance;
+            batch.angular[lane] = f_ang;
+            batch.count++;
+
+            if(batch.count == SHADE_BATCH){
+
+                material_list[object_list[subject_object_index].material_index].shade(&batch, &surface, I);
+                batch.count = 0;
+            }
+        }
+    }
+
+    if(batch.count > 0){
+
+        material_list[object_list[subject_object_index].material_index].shade(&batch, &surface, I);
+    }
+}
+
+
+void reflection(object *object_list, int num_objects, light *light_list, int num_lights,
+                    float *intersection, float *rd, int current_object_index, const mesh_hit *hit,
+                    int level, float *returned_color, texture *texture_list,
+                    material *material_list, const light_grid *grid, int *last_occluder,
+                    bool fast_math, render_stats *stats){
+
+    object current_object = object_list[current_object_index];
+    material current_material = material_list[current_object.material_index];
+
+    // Reflected color begins as pure black.
+    float reflected_color[3] = {0, 0, 0};
+
+
+    // Stop recursion after 7 levels of recursion.
+    if(level <= 7){
+
+        if(level > stats->max_depth){
+
+            stats->max_depth = level;
+        }
+
+        // Only spheres, planes and meshes reflect; any other type keeps a zero
+        // normal, which reflects the ray straight on.
+        float normal[3] = {0, 0, 0};
+
+        if(current_object.type == Sphere){
+
+            v3_from_points(normal, current_object.center, intersection);
+
+            v3_normalize(normal, normal);
+
+        }
+
+        // Plane normals are already unit length after bake_scene().
+        if(current_object.type == Plane){
+
+            normal[0] = current_object.plane.normal[0];
+            normal[1] = current_object.plane.normal[1];
+            normal[2] = current_object.plane.normal[2];
+        }
+
+        if(current_object.type == Mesh){
+
+            mesh_facing_normal(&current_object, hit, rd, normal);
+        }
+        
+        float reflection_vector[3];
+        v3_reflect_unit(reflection_vector, rd, normal);
+
+        float t = -1;
+        float smallest_t = INFINITY;
+        int closest_to_object_index = -1;
+
+        stats->reflection_rays++;
+
+        // Find the closest object hit by the reflected ray, if it exists.
+        for(int object_index = 0; object_index < num_objects; object_index++){
+            
+            // Skip over the current object to prevent floating point errors.
+            if(object_index != current_object_index){
+
+                t = object_intersection(&object_list[object_index], reflection_vector, intersection, stats);
+
+                if(t >= 0.0){
+
+                    if(t < smallest_t){
+
+                        smallest_t = t;
+                        closest_to_object_index = object_index;
+                    }
+                }
+            }
+        }
+
+        // Check for an intersection.
+        if(smallest_t < INFINITY){
+
+            // Calculate the intersection of the reflected ray.
+            float new_intersection[3] = {reflection_vector[0], reflection_vector[1], reflection_vector[2]};
+            v3_scale(new_intersection, smallest_t);
+            v3_add(new_intersection, new_intersection, intersection);
+
+            mesh_hit new_hit;
+
+            if(object_list[closest_to_object_index].type == Mesh){
+
+                mesh_object_intersection(&object_list[closest_to_object_index], reflection_vector,
+                                         intersection, &new_hit, stats);
+            }
+
+            // Since there is an intersection, recurse.
+            reflection(object_list, num_objects, light_list, num_lights,
+                        new_intersection, reflection_vector, closest_to_object_index, &new_hit,
+                        level + 1, reflected_color, texture_list, material_list, grid, last_occluder,
+                        fast_math, stats);
+
+        }
+
+        float I[3] = {0, 0, 0};
+
+        // Apply all lights to the current object.
+        apply_lights(object_list, num_objects, light_list, num_lights, texture_list,
+            material_list, intersection, rd, current_object_index, hit, I, grid, last_occluder, fast_math,
+            stats);
+
+        // Calculate the opaque color.
+        v3_scale(I, 1.0 - current_material.reflectivity);
+
+        // Apply the reflectivity to the reflected color.
+        v3_scale(reflected_color, current_material.reflectivity);
+
+        // Add the opaque color to the reflected color and store it in
+        // returned_color
+        v3_add(returned_color, I, reflected_color);
+    }
+}
+
+
+int clamp(int color){
+
+    if(color > 255){
+
+        color = 255;
+
+    }
+
+    if(color < 0){
+
+        color = 0;
+
+    }
+
+    return color;
+}
+
+
+// Everything a render worker needs to trace its share of the frame.
+typedef struct {
+
+    uint8_t *pixmap;
+    int width;
+    int height;
+    float cam_width;
+    float cam_height;
+
+    // x0, y0, x1, y1 of the part of the frame being rendered; pixmap only
+    // holds this region.
+    int region[4];
+
+    object *object_list;
+    int num_objects;
+    light *light_list;
+    int num_lights;
+    texture *texture_list;
+    material *material_list;
+
+    // Which lights can reach where; NULL if it couldn't be built.
+    light_grid *lights_near;
+
+    // Shade with the approximations in fastmath.h.
+    bool fast_math;
+
+    heatmap *heat;
+    trace_log *trace;
+
+    int num_tiles;
+
+    // Index of the next tile to hand out; workers claim tiles until it
+    // passes num_tiles or the render is cancelled.
+    atomic_int next_tile;
+    atomic_int *cancelled;
+
+    const uint8_t *skip_tiles;
+
+    // Serializes calls to progress and tile_done and guards tiles_done.
+    rt_progress_callback progress;
+    rt_tile_callback tile_done;
+    void *user_data;
+    pthread_mutex_t progress_lock;
+    int tiles_done;
+
+} render_job;
+
+typedef struct {
+
+    render_job *job;
+    int worker_index;
+    render_stats stats;
+
+    // Indices of the objects in view of the current tile; NULL if it
+    // couldn't be allocated, and then every object is tested.
+    int *visible;
+
+    // Per light, the object that last shadowed a point from it, or -1;
+    // NULL if it couldn't be allocated.
+    int *last_occluder;
+
+} render_worker;
+
+
+// Writes the indices of the objects a primary ray through pixels x0, y0,
+// x1, y1 could hit into visible, in scene order, and returns how many.
+// The tile's rays fill a pyramid from the camera at the origin, bounded by
+// four planes through the origin and the tile's edges on the viewplane. A
+// sphere, or a mesh's bounding sphere, is dropped when it lies wholly
+// outside one of those planes, and a plane when no ray in the pyramid
+// points towards its front side.
+int cull_tile(render_job *job, int x0, int y0, int x1, int y1, int *visible){
+
+    float pixwidth = job->cam_width / job->width;
+    float pixheight = job->cam_height / job->height;
+
+    // Edges of the tile on the viewplane at z = -1, with y flipped as the
+    // primary rays are.
+    float left = -job->cam_width / 2 + pixwidth * x0;
+    float right = -job->cam_width / 2 + pixwidth * x1;
+    float top = job->cam_height / 2 - pixheight * y0;
+    float bottom = job->cam_height / 2 - pixheight * y1;
+
+    // Inward normals of the left, right, bottom and top sides.
+    float sides[4][3] = {{1, 0, left}, {-1, 0, -right}, {0, 1, bottom}, {0, -1, -top}};
+
+    for(int side = 0; side < 4; side++){
+
+        v3_normalize(sides[side], sides[side]);
+    }
+
+    float corners[4][3] = {{left, bottom, -1}, {right, bottom, -1}, {left, top, -1}, {right, top, -1}};
+
+    int num_visible = 0;
+
+    for(int object_index = 0; object_index < job->num_objects; object_index++){
+
+        object *candidate = &job->object_list[object_index];
+        bool in_view = false;
+
+        if(candidate->type == Sphere){
+
+            in_view = true;
+
+            for(int side = 0; side < 4 && in_view; side++){
+
+                in_view = v3_dot_product(sides[side], candidate->center) >= -candidate->sphere.radius;
+            }
+
+        } else if(candidate->type == Mesh){
+
+            // Meshes are culled by their bounding sphere.
+            in_view = true;
+
+            for(int side = 0; side < 4 && in_view; side++){
+
+                in_view = v3_dot_product(sides[side], candidate->mesh.bound_center) >=
+                          -candidate->mesh.bound_radius;
+            }
+
+        } else {
+
+            // plane_intersection() only returns hits in front of the camera
+            // for rays against the normal, and those rays form a half-space
+            // that either contains a corner of the pyramid or misses it.
+            if(v3_dot_product(candidate->plane.normal, candidate->center) <= 0){
+
+                for(int corner = 0; corner < 4 && !in_view; corner++){
+
+                    in_view = v3_dot_product(candidate->plane.normal, corners[corner]) <= 0;
+                }
+            }
+        }
+
+        if(in_view){
+
+            visible[num_visible] = object_index;
+            num_visible++;
+        }
+    }
+
+    return num_visible;
+}
+
+
+// Traces the pixels with x0 <= col < x1 and y0 <= row < y1 into the pixmap.
+// Only the objects listed in visible, num_visible of them, are tested by
+// primary rays; visible may be NULL to test them all. last_occluder is the
+// calling worker's shadow cache, see apply_lights().
+void render_tile(render_job *job, int x0, int y0, int x1, int y1, const int *visible, int num_visible,
+                 int *last_occluder, render_stats *stats){
+
+    // We assume the camera postion is at [0, 0, 0]
+    float camera_position[] = {0,0,0};
+
+    float viewplane_x;
+    float viewplane_y;
+    float viewplane_z = -1;
+
+    float cam_width = job->cam_width;
+    float cam_height = job->cam_height;
+
+    // This is how large each "window" will be in the frame
+    float pixwidth = cam_width / job->width;
+    float pixheight = cam_height / job->height;
+
+    // The camera is aimed directly down the z-axis.
+    float cam_center_x = 0;
+    float cam_center_y = 0;
+
+    object *object_list = job->object_list;
+    int num_objects = job->num_objects;
+    heatmap *heat = job->heat;
+
+    for(int row_index = y0; row_index < y1; row_index++){
+
+        // y coordinate of viewplane row
+        viewplane_y  = cam_center_y - (cam_height / 2) + (pixheight * (row_index + 0.5));
+
+        int region_width = job->region[2] - job->region[0];
+        int pixmap_index = ((row_index - job->region[1]) * region_width + x0 - job->region[0]) * 3;
+
+        for(int col_index = x0; col_index < x1; col_index++){
+
+            uint64_t pixel_start = heat != NULL ? heatmap_counter(heat, stats) : 0;
+
+            // x coordinate of viewplane column
+            viewplane_x = cam_center_x - (cam_width / 2) + (pixwidth * (col_index + 0.5));
+
+            // direction vector without t scalar
+            // viewplane_y is negated to account for ppm writer that writes
+            // in the negative-y direction.
+            float rd[3] = {viewplane_x, -viewplane_y, viewplane_z};
+            
+            v3_normalize(rd, rd);
+
+            object *closest_object = NULL;
+            float closest_to_camera_t = INFINITY;
+            int closest_to_camera_index;
+            float t;
+
+            stats->primary_rays++;
+            
+            for(int visible_index = 0; visible_index < num_visible; visible_index++){
+
+                int object_index = visible != NULL ? visible[visible_index] : visible_index;
+
+                t = object_intersection(&object_list[object_index], rd, camera_position, stats);
+
+                if(t >= 0.0){
+                    if(t < closest_to_camera_t){
+                        closest_object = &object_list[object_index];
+                        closest_to_camera_t = t;
+                        closest_to_camera_index = object_index;
+                    }
+                }
+
+            }
+
+            float color[3] = {0, 0, 0};
+
+            if(closest_object != NULL){
+
+                float intersection[3] = {rd[0], rd[1], rd[2]};
+                v3_scale(intersection, closest_to_camera_t);
+                v3_add(intersection, intersection, camera_position);
+
+                mesh_hit hit;
+
+                if(closest_object->type == Mesh){
+
+                    mesh_object_intersection(closest_object, rd, camera_position, &hit, stats);
+                }
+
+                reflection(object_list, num_objects, job->light_list, job->num_lights,
+                        intersection, rd, closest_to_camera_index, &hit, 0, color, job->texture_list,
+                        job->material_list, job->lights_near, last_occluder, job->fast_math, stats);
+            }
+
+
+            job->pixmap[pixmap_index] = clamp((int) color[0]); // write R
+            job->pixmap[pixmap_index + 1] = clamp((int) color[1]); // write G
+            job->pixmap[pixmap_index + 2] = clamp((int) color[2]); // write B
+
+            if(heat != NULL){
+
+                heat->cost[pixmap_index / 3] = heatmap_counter(heat, stats) - pixel_start;
+            }
+
+            pixmap_index+=3;
+        }
+    }
+}
+
+void *render_worker_main(void *arg){
+
+    render_worker *worker = arg;
+    render_job *job = worker->job;
+
+    trace_buffer *trace = trace_buffer_for(job->trace, worker->worker_index + 1);
+
+    int tile = atomic_fetch_add(&job->next_tile, 1);
+
+    while(tile < job->num_tiles && !atomic_load(job->cancelled)){
+
+        if(job->skip_tiles != NULL && job->skip_tiles[tile]){
+
+            tile = atomic_fetch_add(&job->next_tile, 1);
+
+            continue;
+        }
+
+        int bounds[4];
+        tile_bounds(job->region, tile, bounds);
+
+        double tile_start = stats_now_ms();
+
+        int num_visible = job->num_objects;
+
+        if(worker->visible != NULL){
+
+            num_visible = cull_tile(job, bounds[0], bounds[1], bounds[2], bounds[3], worker->visible);
+        }
+
+        render_tile(job, bounds[0], bounds[1], bounds[2], bounds[3], worker->visible, num_visible,
+                    worker->last_occluder, &worker->stats);
+
+        trace_event_end(trace, "tile", tile_start, "\"tile\": %d, \"x0\": %d, \"y0\": %d, "
+                        "\"x1\": %d, \"y1\": %d", tile, bounds[0], bounds[1], bounds[2], bounds[3]);
+
+        if(job->progress != NULL || job->tile_done != NULL){
+
+            pthread_mutex_lock(&job->progress_lock);
+
+            job->tiles_done++;
+
+            if(job->tile_done != NULL && job->tile_done(tile, bounds, job->user_data) != 0){
+
+                atomic_store(job->cancelled, 1);
+            }
+
+            if(job->progress != NULL && job->progress(job->tiles_done, job->num_tiles, job->user_data) != 0){
+
+                atomic_store(job->cancelled, 1);
+            }
+
+            pthread_mutex_unlock(&job->progress_lock);
+        }
+
+        tile = atomic_fetch_add(&job->next_tile, 1);
+    }
+
+    return NULL;
+}
+
+int tile_count(const int region[4]){
+
+    int tiles_across = (region[2] - region[0] + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_down = (region[3] - region[1] + TILE_SIZE - 1) / TILE_SIZE;
+
+    return tiles_across * tiles_down;
+}
+
+void tile_bounds(const int region[4], int tile, int bounds[4]){
+
+    int tiles_across = (region[2] - region[0] + TILE_SIZE - 1) / TILE_SIZE;
+
+    bounds[0] = region[0] + (tile % tiles_across) * TILE_SIZE;
+    bounds[1] = region[1] + (tile / tiles_across) * TILE_SIZE;
+    bounds[2] = bounds[0] + TILE_SIZE < region[2] ? bounds[0] + TILE_SIZE : region[2];
+    bounds[3] = bounds[1] + TILE_SIZE < region[3] ? bounds[1] + TILE_SIZE : region[3];
+}
+
+int default_thread_count(){
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return online > 0 ? online : 1;
+}
+
+
+// Takes in all of the information provided by the input file
+// and performs the raytraceing algorithm to generate an image that is then 
+// stored in the given pixmap.
+bool raytrace(uint8_t *pixmap, scene *current_scene, rt_render_options *options,
+              render_stats *stats, atomic_int *cancelled) {
+
+    render_job job;
+
+    job.pixmap = pixmap;
+    job.width = options->width;
+    job.height = options->height;
+    job.cam_width = current_scene->camera_width;
+    job.cam_height = current_scene->camera_height;
+
+    job.object_list = current_scene->object_list;
+    job.num_objects = current_scene->num_objects;
+    job.light_list = current_scene->light_list;
+    job.num_lights = current_scene->num_lights;
+    job.texture_list = current_scene->texture_list;
+    job.material_list = current_scene->material_list;
+
+    job.heat = options->heat;
+    job.trace = options->trace;
+    job.fast_math = options->fast_math;
+
+    light_grid grid;
+    job.lights_near = light_grid_build(&grid, current_scene, options->light_cutoff) ? &grid : NULL;
+
+    // Rays are always aimed through the full frame, so a pixel comes out the
+    // same whichever region it is rendered in.
+    memcpy(job.region, options->region, sizeof(job.region));
+
+    job.num_tiles = tile_count(job.region);
+
+    atomic_init(&job.next_tile, 0);
+    job.cancelled = cancelled;
+    job.skip_tiles = options->skip_tiles;
+
+    job.progress = options->progress;
+    job.tile_done = options->tile_done;
+    job.user_data = options->user_data;
+    pthread_mutex_init(&job.progress_lock, NULL);
+
+    // Skipped tiles count as done.
+    job.tiles_done = 0;
+
+    for(int tile = 0; job.skip_tiles != NULL && tile < job.num_tiles; tile++){
+
+        job.tiles_done += job.skip_tiles[tile] != 0;
+    }
+
+    int num_threads = options->num_threads;
+
+    if(num_threads < 1){
+
+        num_threads = 1;
+    }
+
+    // On the heap, since num_threads comes from the caller. If there is no
+    // room for them the calling thread renders every tile on its own, as
+    // it would if no thread could be started.
+    render_worker *workers = malloc(sizeof(render_worker) * num_threads);
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+    render_worker only_worker;
+
+    if(workers == NULL || threads == NULL){
+
+        free(workers);
+        free(threads);
+
+        workers = &only_worker;
+        threads = NULL;
+        num_threads = 1;
+    }
+
+    for(int worker_index = 0; worker_index < num_threads; worker_index++){
+
+        workers[worker_index].job = &job;
+        workers[worker_index].worker_index = worker_index;
+        memset(&workers[worker_index].stats, 0, sizeof(render_stats));
+        workers[worker_index].visible = malloc(sizeof(int) * (job.num_objects > 0 ? job.num_objects : 1));
+        workers[worker_index].last_occluder = malloc(sizeof(int) * (job.num_lights > 0 ? job.num_lights : 1));
+
+        for(int light_index = 0; workers[worker_index].last_occluder != NULL && light_index < job.num_lights;
+            light_index++){
+
+            workers[worker_index].last_occluder[light_index] = -1;
+        }
+    }
+
+    // Worker 0 runs on the calling thread. If a thread can't be started
+    // the ones already running pick up its tiles.
+    int num_started = 1;
+
+    while(num_started < num_threads &&
+          pthread_create(&threads[num_started], NULL, render_worker_main, &workers[num_started]) == 0){
+
+        num_started++;
+    }
+
+    render_worker_main(&workers[0]);
+
+    for(int worker_index = 0; worker_index < num_started; worker_index++){
+
+        if(worker_index > 0){
+
+            pthread_join(threads[worker_index], NULL);
+        }
+
+        render_stats_merge(stats, &workers[worker_index].stats);
+    }
+
+    for(int worker_index = 0; worker_index < num_threads; worker_index++){
+
+        free(workers[worker_index].visible);
+        free(workers[worker_index].last_occluder);
+    }
+
+    if(workers != &only_worker){
+
+        free(workers);
+        free(threads);
+    }
+
+    pthread_mutex_destroy(&job.progress_lock);
+
+    if(job.lights_near != NULL){
+
+        light_grid_free(&grid);
+    }
+
+    return !atomic_load(cancelled);
+}
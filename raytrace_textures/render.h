@@ -0,0 +1,98 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdatomic.h>
+
+#include "rt.h"
+#include "scene.h"
+#include "lightgrid.h"
+#include "stats.h"
+#include "heatmap.h"
+#include "trace.h"
+
+// Returns the distance along rd to the sphere, or -1 if there is no
+// intersection.
+float sphere_intersection(float *rd, float *ro, float *center, float radius_squared);
+
+// Returns the distance along rd to the plane, or -1 if the plane faces away.
+float plane_intersection(float *rd, float *ro, float *center, float *normal);
+
+// Returns the distance along rd to the mesh object, or -1 if it is missed,
+// and fills hit, which may be NULL, with the triangle found.
+float mesh_object_intersection(object *mesh_object, float *rd, float *ro, mesh_hit *hit,
+                               render_stats *stats);
+
+// Unit normal of the triangle in hit, turned to face against rd.
+void mesh_facing_normal(object *mesh_object, const mesh_hit *hit, float *rd, float *normal);
+
+// Dispatches to the intersection test for the object's shape and counts it.
+float object_intersection(object *iter_object, float *rd, float *ro, render_stats *stats);
+
+float radial(float a2, float a1, float a0, float d);
+
+// Spot light falloff; fast_math picks the light's fast power kernel.
+float angular(light light, float *v_obj, bool fast_math);
+
+int wrap_texel(float coord, int size, float inv_size);
+
+// Maps the intersection on hit_object to the row and column of the texel of
+// obj_texture found there. hit is only read for meshes. fast_math maps
+// spheres and planes with the approximations in fastmath.h.
+void texture_position(texture *obj_texture, object *hit_object, float *intersection, const mesh_hit *hit,
+                      bool fast_math, int *texel_row, int *texel_col);
+
+// Same as texture_position(), returning a pointer to the RGB channels of
+// the texel in the pixmap of obj_texture, which must not be paged.
+uint8_t *texture_texel(texture *obj_texture, object *hit_object, float *intersection, const mesh_hit *hit,
+                       bool fast_math);
+
+// Color of obj_texture, image or pattern, at intersection on hit_object;
+// 0 to 255 per channel.
+void texture_color(texture *obj_texture, object *hit_object, float *intersection, const mesh_hit *hit,
+                   bool fast_math, float *color);
+
+// Adds the light reaching intersection on the subject object to I. Only
+// the lights grid lists for the point are considered (all of them when grid
+// is NULL), and those out of range or outside their cone are skipped
+// before any shadow ray is cast. A shadow ray first tries the object in
+// last_occluder (one per light, -1 for none) and only scans every object
+// when that doesn't block it; the cache is updated with whatever the scan
+// finds. last_occluder may be NULL. hit is where the subject was hit when
+// it is a mesh. fast_math shades with the approximations in fastmath.h
+// instead of libm.
+void apply_lights(object *object_list, int num_objects, light *light_list, int num_lights,
+                    texture *texture_list, material *material_list, float *intersection,
+                    float *rd, int subject_object_index, const mesh_hit *hit, float *I,
+                    const light_grid *grid, int *last_occluder, bool fast_math, render_stats *stats);
+
+void reflection(object *object_list, int num_objects, light *light_list, int num_lights,
+                    float *intersection, float *rd, int current_object_index, const mesh_hit *hit,
+                    int level, float *returned_color, texture *texture_list,
+                    material *material_list, const light_grid *grid, int *last_occluder,
+                    bool fast_math, render_stats *stats);
+
+int clamp(int color);
+
+// Takes in all of the information provided by the input file
+// and performs the raytraceing algorithm to generate an image that is then 
+// stored in the given pixmap. Only options->region, which must be set, is
+// rendered; it is split into tiles that options->num_threads workers claim
+// in turn. options->heat and
+// options->trace may be NULL; otherwise the cost of each pixel and a
+// timeline event per tile are recorded in them. Each worker's counters are
+// merged into stats. Tiles marked in options->skip_tiles are passed over.
+// Workers stop claiming tiles once *cancelled is set, by a callback or
+// another thread; returns false if it was.
+bool raytrace(uint8_t *pixmap, scene *current_scene, rt_render_options *options,
+              render_stats *stats, atomic_int *cancelled);
+
+// Number of tiles region (x0, y0, x1, y1) is rendered in.
+int tile_count(const int region[4]);
+
+// Frame pixels covered by tile of region.
+void tile_bounds(const int region[4], int tile, int bounds[4]);
+
+// Number of online CPUs, the default number of render threads.
+int default_thread_count();
+
+#endif
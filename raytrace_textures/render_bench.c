@@ -0,0 +1,129 @@
+#include <sys/resource.h>
+
+#include "rt.h"
+#include "ppmrw.h"
+
+// End-to-end render benchmark. Parses and loads one scene, then renders it at
+// each requested resolution and prints a JSON line per resolution with the
+// wall time of every phase, ray counts, rays/sec and peak RSS.
+
+
+void render_bench_fail(const char *s) {
+
+    printf("Error: %s\n\n", s);
+    printf("Usage:\n");
+    printf("render_bench INPUT.scene [WIDTHxHEIGHT ...]\n\n");
+    exit(1);
+}
+
+long peak_rss_kb(){
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    // Linux reports ru_maxrss in kilobytes.
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char *argv[]){
+
+    if(argc < 2){
+
+        render_bench_fail("Wrong number of arguments.");
+    }
+
+    char *default_resolutions[] = {"128x128", "256x256", "512x512"};
+    char **resolutions = &argv[2];
+    int num_resolutions = argc - 2;
+
+    if(num_resolutions == 0){
+
+        resolutions = default_resolutions;
+        num_resolutions = 3;
+    }
+
+    int num_threads = rt_default_thread_count();
+
+    rt_scene *current_scene;
+    rt_error error;
+
+    if(rt_scene_load_file(&current_scene, argv[1], NULL, &error) != RT_OK){
+
+        render_bench_fail(error.message);
+    }
+
+    rt_scene_info info;
+    rt_scene_get_info(current_scene, &info);
+
+    rt_context *context = rt_context_create();
+
+    if(context == NULL){
+
+        render_bench_fail("Memory allocation for the render context has failed!");
+    }
+
+    for(int resolution = 0; resolution < num_resolutions; resolution++){
+
+        int width;
+        int height;
+
+        if(sscanf(resolutions[resolution], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0){
+
+            render_bench_fail("Bad resolution; expected WIDTHxHEIGHT.");
+        }
+
+        uint8_t *pixmap = malloc(sizeof(uint8_t) * width * height * 3);
+
+        if(pixmap == NULL){
+
+            render_bench_fail("Memory allocation for pixmap has failed!");
+        }
+
+        rt_render_options options;
+        rt_render_options_init(&options, width, height);
+
+        options.num_threads = num_threads;
+
+        double start = stats_now_ms();
+
+        if(rt_render(context, current_scene, &options, pixmap) != RT_OK){
+
+            render_bench_fail(rt_context_error(context));
+        }
+
+        double render_ms = stats_now_ms() - start;
+
+        render_stats stats = *rt_context_stats(context);
+
+        // Encode to a scratch file so the write phase includes real I/O.
+        FILE *outfile = tmpfile();
+
+        start = stats_now_ms();
+
+        write_p6(outfile, pixmap, width, height, 255);
+        fflush(outfile);
+
+        double write_ms = stats_now_ms() - start;
+
+        fclose(outfile);
+        free(pixmap);
+
+        long total_rays = stats.primary_rays + stats.reflection_rays + stats.shadow_rays;
+
+        printf("{\"scene\": \"%s\", \"width\": %d, \"height\": %d, \"objects\": %d, \"lights\": %d, "
+               "\"textures\": %d, \"threads\": %d, \"parse_ms\": %.3f, \"texture_load_ms\": %.3f, \"render_ms\": %.3f, "
+               "\"write_ms\": %.3f, \"primary_rays\": %ld, \"reflection_rays\": %ld, "
+               "\"shadow_rays\": %ld, \"rays_per_sec\": %.1f, \"peak_rss_kb\": %ld}\n",
+               argv[1], width, height, info.num_objects, info.num_lights,
+               info.num_textures, num_threads, info.parse_ms, info.texture_load_ms, render_ms, write_ms,
+               stats.primary_rays, stats.reflection_rays, stats.shadow_rays,
+               total_rays / (render_ms / 1e3), peak_rss_kb());
+
+        fflush(stdout);
+    }
+
+    rt_context_free(context);
+    rt_scene_free(current_scene);
+
+    return 0;
+}
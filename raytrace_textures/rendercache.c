@@ -0,0 +1,223 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rendercache.h"
+
+typedef struct {
+
+    char name[RENDER_CACHE_NAME_SIZE];
+    long long size;
+    struct timespec used;
+
+} cache_entry;
+
+
+bool render_cache_init(render_cache *cache){
+
+    mode_t mask = umask(0);
+    umask(mask);
+
+    cache->entry_mode = 0644 & ~mask;
+
+    return mkdir(cache->directory, 0777) == 0 || errno == EEXIST;
+}
+
+void render_cache_name(const uint8_t key[32], const char *format, char name[RENDER_CACHE_NAME_SIZE]){
+
+    for(int index = 0; index < 32; index++){
+
+        snprintf(&name[index * 2], 3, "%02x", key[index]);
+    }
+
+    snprintf(&name[64], RENDER_CACHE_NAME_SIZE - 64, ".%s", format);
+}
+
+// True for names made by render_cache_name(), so temporary files and
+// anything else in the directory are left alone.
+bool is_entry_name(const char *name){
+
+    size_t length = strlen(name);
+
+    return length > 65 && length < RENDER_CACHE_NAME_SIZE && strspn(name, "0123456789abcdef") == 64 &&
+           name[64] == '.';
+}
+
+FILE *render_cache_open(const render_cache *cache, const char *name, long *length){
+
+    char path[strlen(cache->directory) + RENDER_CACHE_NAME_SIZE + 2];
+    snprintf(path, sizeof(path), "%s/%s", cache->directory, name);
+
+    FILE *fp = fopen(path, "rb");
+    struct stat info;
+
+    if(fp == NULL){
+
+        return NULL;
+    }
+
+    if(fstat(fileno(fp), &info) != 0){
+
+        fclose(fp);
+
+        return NULL;
+    }
+
+    // The modification time doubles as the last use, for eviction.
+    futimens(fileno(fp), NULL);
+
+    *length = info.st_size;
+
+    return fp;
+}
+
+bool render_cache_copy(FILE *from, FILE *to){
+
+    char buffer[65536];
+    size_t count;
+
+    while((count = fread(buffer, 1, sizeof(buffer), from)) > 0){
+
+        if(fwrite(buffer, 1, count, to) != count){
+
+            return false;
+        }
+    }
+
+    return !ferror(from);
+}
+
+int compare_entries(const void *a, const void *b){
+
+    const cache_entry *first = a;
+    const cache_entry *second = b;
+
+    if(first->used.tv_sec != second->used.tv_sec){
+
+        return first->used.tv_sec < second->used.tv_sec ? -1 : 1;
+    }
+
+    return (first->used.tv_nsec > second->used.tv_nsec) - (first->used.tv_nsec < second->used.tv_nsec);
+}
+
+// Removes the least recently used entries until the rest fit in
+// max_bytes. Entries another process removes meanwhile are skipped.
+void render_cache_evict(const render_cache *cache){
+
+    DIR *directory = opendir(cache->directory);
+
+    if(directory == NULL){
+
+        return;
+    }
+
+    cache_entry *entries = NULL;
+    int num_entries = 0;
+    int capacity = 0;
+    long long total = 0;
+
+    char path[strlen(cache->directory) + RENDER_CACHE_NAME_SIZE + 2];
+    struct dirent *found;
+
+    while((found = readdir(directory)) != NULL){
+
+        struct stat info;
+
+        if(!is_entry_name(found->d_name)){
+
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, found->d_name);
+
+        if(stat(path, &info) != 0){
+
+            continue;
+        }
+
+        if(num_entries == capacity){
+
+            capacity = capacity == 0 ? 64 : capacity * 2;
+
+            cache_entry *grown = realloc(entries, sizeof(cache_entry) * capacity);
+
+            if(grown == NULL){
+
+                break;
+            }
+
+            entries = grown;
+        }
+
+        snprintf(entries[num_entries].name, RENDER_CACHE_NAME_SIZE, "%s", found->d_name);
+        entries[num_entries].size = info.st_size;
+        entries[num_entries].used = info.st_mtim;
+
+        total += info.st_size;
+        num_entries++;
+    }
+
+    closedir(directory);
+
+    if(total > cache->max_bytes){
+
+        qsort(entries, num_entries, sizeof(cache_entry), compare_entries);
+    }
+
+    for(int index = 0; index < num_entries && total > cache->max_bytes; index++){
+
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, entries[index].name);
+
+        unlink(path);
+
+        total -= entries[index].size;
+    }
+
+    free(entries);
+}
+
+bool render_cache_store(const render_cache *cache, const char *name, FILE *image){
+
+    char path[strlen(cache->directory) + RENDER_CACHE_NAME_SIZE + 2];
+    char temporary[strlen(cache->directory) + RENDER_CACHE_NAME_SIZE + 10];
+
+    snprintf(path, sizeof(path), "%s/%s", cache->directory, name);
+    snprintf(temporary, sizeof(temporary), "%s/.%s.XXXXXX", cache->directory, name);
+
+    int fd = mkstemp(temporary);
+
+    if(fd < 0){
+
+        return false;
+    }
+
+    FILE *fp = fdopen(fd, "wb");
+
+    if(fp == NULL){
+
+        close(fd);
+        unlink(temporary);
+
+        return false;
+    }
+
+    // Synced before the rename, so a crash leaves either no entry or a
+    // whole one. mkstemp() makes the file private; entries are readable by
+    // everyone the umask allows, like any other file the user writes.
+    bool stored = render_cache_copy(image, fp) && fflush(fp) == 0 && fchmod(fd, cache->entry_mode) == 0 &&
+                  fsync(fd) == 0;
+
+    if(fclose(fp) != 0 || !stored || rename(temporary, path) != 0){
+
+        unlink(temporary);
+
+        return false;
+    }
+
+    render_cache_evict(cache);
+
+    return true;
+}
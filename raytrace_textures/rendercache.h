@@ -0,0 +1,49 @@
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// Finished images on disk, named by the rt_render_digest() of the render
+// and the format they were written in, so a repeat of a render is a file
+// copy. Entries are written under a temporary name and renamed into place,
+// so a reader never sees half an image, and several processes can share a
+// directory. Each hit touches the file's modification time; once the
+// directory holds more than max_bytes of images the least recently used
+// are removed.
+typedef struct {
+
+    const char *directory;
+    long long max_bytes;
+
+    // Permissions entries are published with: 0644 less the umask.
+    mode_t entry_mode;
+
+} render_cache;
+
+// Room for the hex digest, a dot, the format and the terminator.
+#define RENDER_CACHE_NAME_SIZE 80
+
+// Creates cache->directory if it isn't there yet and notes the umask for
+// the entries. Call once, before any thread uses the cache, as reading the
+// umask briefly changes it. Returns false if the directory can't be made.
+bool render_cache_init(render_cache *cache);
+
+// Writes the entry name for key in format (like "p3" or "png") to name.
+void render_cache_name(const uint8_t key[32], const char *format, char name[RENDER_CACHE_NAME_SIZE]);
+
+// Opens the entry called name for reading and marks it used, or returns
+// NULL if it isn't cached. *length gets its size.
+FILE *render_cache_open(const render_cache *cache, const char *name, long *length);
+
+// Stores the rest of image as the entry called name and evicts entries
+// until the cache fits its budget again. Returns false if it couldn't be
+// stored, which leaves the cache as it was.
+bool render_cache_store(const render_cache *cache, const char *name, FILE *image);
+
+// Copies the rest of from to to. Returns false if either fails.
+bool render_cache_copy(FILE *from, FILE *to);
+
+#endif
@@ -0,0 +1,534 @@
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rt.h"
+#include "scene.h"
+#include "render.h"
+#include "hash.h"
+
+struct rt_scene {
+
+    scene contents;
+
+    double parse_ms;
+    double texture_load_ms;
+
+};
+
+struct rt_context {
+
+    render_stats stats;
+    rt_error error;
+
+    // Set by rt_context_cancel() or the progress callback; cleared when a
+    // render starts.
+    atomic_int cancelled;
+
+};
+
+
+const char *rt_status_string(rt_status status){
+
+    switch(status){
+
+        case RT_OK:
+            return "ok";
+
+        case RT_ERROR_IO:
+            return "I/O error";
+
+        case RT_ERROR_PARSE:
+            return "parse error";
+
+        case RT_ERROR_NO_MEMORY:
+            return "out of memory";
+
+        case RT_ERROR_INVALID_ARGUMENT:
+            return "invalid argument";
+
+        case RT_ERROR_CANCELLED:
+            return "cancelled";
+    }
+
+    return "unknown error";
+}
+
+// Parses, loads and bakes the scene text in fp, which is closed. text, when
+// not NULL, is the same length bytes in memory, so a large scene can be
+// parsed on several threads.
+rt_status load_scene(rt_scene **loaded, FILE *fp, const char *text, size_t length, rt_load_options *options,
+                     rt_error *error){
+
+    rt_scene *new_scene = calloc(1, sizeof(rt_scene));
+
+    if(new_scene == NULL){
+
+        fclose(fp);
+
+        return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+    }
+
+    trace_buffer *main_trace = trace_buffer_for(options != NULL ? options->trace : NULL, 0);
+
+    double phase_start = stats_now_ms();
+
+    rt_status status = get_camera(fp, &new_scene->contents.camera_width,
+                                  &new_scene->contents.camera_height, error);
+
+    if(status == RT_OK){
+
+        long offset = ftell(fp);
+        int num_threads = options != NULL && options->num_threads > 0 ? options->num_threads :
+                          rt_default_thread_count();
+
+        if(text != NULL && offset >= 0 && length - offset >= 2 * PARSE_PART_MIN_BYTES && num_threads > 1){
+
+            status = get_objects_parallel(&text[offset], length - offset, &new_scene->contents, num_threads,
+                                          error);
+
+        } else {
+
+            status = get_objects(fp, &new_scene->contents, error);
+        }
+    }
+
+    fclose(fp);
+
+    new_scene->parse_ms = stats_now_ms() - phase_start;
+    trace_event_end(main_trace, "parse", phase_start, "\"objects\": %d, \"lights\": %d",
+                    new_scene->contents.num_objects, new_scene->contents.num_lights);
+
+    if(status == RT_OK){
+
+        phase_start = stats_now_ms();
+
+        new_scene->contents.texture_cache = options != NULL ? options->textures : NULL;
+        new_scene->contents.texture_pager = options != NULL ? options->pager : NULL;
+
+        status = load_textures(&new_scene->contents, main_trace, error);
+    }
+
+    if(status == RT_OK){
+
+        status = load_meshes(&new_scene->contents, main_trace, error);
+    }
+
+    if(status != RT_OK){
+
+        rt_scene_free(new_scene);
+
+        return status;
+    }
+
+    double bake_start = stats_now_ms();
+
+    bake_scene(&new_scene->contents);
+
+    trace_event_end(main_trace, "bake", bake_start, NULL);
+
+    new_scene->texture_load_ms = stats_now_ms() - phase_start;
+
+    *loaded = new_scene;
+
+    return RT_OK;
+}
+
+rt_status rt_scene_load_file(rt_scene **loaded, const char *filename, rt_load_options *options,
+                             rt_error *error){
+
+    if(loaded == NULL || filename == NULL){
+
+        return set_error(error, RT_ERROR_INVALID_ARGUMENT, "No scene or filename given.");
+    }
+
+    FILE *fp = fopen(filename, "r");
+
+    if(fp == NULL){
+
+        return set_error(error, RT_ERROR_IO, "Could not open the input file %s.", filename);
+    }
+
+    // Files big enough to be parsed in parts are mapped, so every thread
+    // reads its part in place. Smaller ones, or any the map fails for, are
+    // read through fp alone.
+    struct stat info;
+    char *text = NULL;
+    size_t length = 0;
+
+    if(fstat(fileno(fp), &info) == 0 && info.st_size >= 2 * PARSE_PART_MIN_BYTES){
+
+        length = info.st_size;
+        text = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+
+        if(text == MAP_FAILED){
+
+            text = NULL;
+        }
+    }
+
+    rt_status status = load_scene(loaded, fp, text, length, options, error);
+
+    if(text != NULL){
+
+        munmap(text, length);
+    }
+
+    return status;
+}
+
+rt_status rt_scene_load_memory(rt_scene **loaded, const char *text, size_t length,
+                               rt_load_options *options, rt_error *error){
+
+    if(loaded == NULL || text == NULL || length == 0){
+
+        return set_error(error, RT_ERROR_INVALID_ARGUMENT, "No scene text given.");
+    }
+
+    // The parser only reads, so the cast is safe.
+    FILE *fp = fmemopen((void *) text, length, "r");
+
+    if(fp == NULL){
+
+        return set_error(error, RT_ERROR_NO_MEMORY, "Could not open the scene text as a stream.");
+    }
+
+    return load_scene(loaded, fp, text, length, options, error);
+}
+
+void rt_scene_free(rt_scene *loaded){
+
+    if(loaded == NULL){
+
+        return;
+    }
+
+    free_scene(&loaded->contents);
+    free(loaded);
+}
+
+void rt_scene_get_info(rt_scene *loaded, rt_scene_info *info){
+
+    info->camera_width = loaded->contents.camera_width;
+    info->camera_height = loaded->contents.camera_height;
+
+    info->num_objects = loaded->contents.num_objects;
+    info->num_lights = loaded->contents.num_lights;
+    info->num_materials = loaded->contents.num_materials;
+    info->num_textures = loaded->contents.num_textures;
+    info->num_meshes = loaded->contents.num_meshes;
+    info->num_triangles = 0;
+
+    for(int mesh_index = 0; mesh_index < loaded->contents.num_meshes; mesh_index++){
+
+        info->num_triangles += loaded->contents.mesh_list[mesh_index].num_triangles;
+    }
+
+    info->parse_ms = loaded->parse_ms;
+    info->texture_load_ms = loaded->texture_load_ms;
+}
+
+int rt_default_thread_count(){
+
+    return default_thread_count();
+}
+
+// The region options renders, with all zero meaning the whole frame.
+void resolve_region(const rt_render_options *options, int region[4]){
+
+    if(options->region[2] == 0 && options->region[3] == 0){
+
+        region[0] = 0;
+        region[1] = 0;
+        region[2] = options->width;
+        region[3] = options->height;
+
+    } else {
+
+        memcpy(region, options->region, sizeof(int) * 4);
+    }
+}
+
+int rt_tile_count(const rt_render_options *options){
+
+    int region[4];
+    resolve_region(options, region);
+
+    return tile_count(region);
+}
+
+void rt_tile_bounds(const rt_render_options *options, int tile, int bounds[4]){
+
+    int region[4];
+    resolve_region(options, region);
+
+    tile_bounds(region, tile, bounds);
+}
+
+// Floats and ints are hashed one at a time, never as structs, so padding
+// and baked or pointer fields stay out of the digest.
+void digest_floats(sha256_context *context, const float *values, int count){
+
+    sha256_update(context, values, sizeof(float) * count);
+}
+
+void digest_ints(sha256_context *context, const int *values, int count){
+
+    sha256_update(context, values, sizeof(int) * count);
+}
+
+void rt_scene_digest(rt_scene *loaded, uint8_t digest[32]){
+
+    scene *contents = &loaded->contents;
+    sha256_context context;
+
+    sha256_init(&context);
+
+    digest_floats(&context, &contents->camera_width, 1);
+    digest_floats(&context, &contents->camera_height, 1);
+
+    int counts[5] = {contents->num_objects, contents->num_lights, contents->num_materials,
+                     contents->num_textures, contents->num_meshes};
+
+    digest_ints(&context, counts, 5);
+
+    for(int index = 0; index < contents->num_objects; index++){
+
+        const object *current = &contents->object_list[index];
+        int fields[2] = {current->type, current->material_index};
+
+        digest_ints(&context, fields, 2);
+        digest_floats(&context, current->center, 3);
+
+        if(current->type == Sphere){
+
+            digest_floats(&context, &current->sphere.radius, 1);
+
+        } else if(current->type == Plane){
+
+            digest_floats(&context, current->plane.normal, 3);
+
+        } else {
+
+            digest_ints(&context, &current->mesh.mesh_index, 1);
+            digest_floats(&context, &current->mesh.scale, 1);
+        }
+    }
+
+    for(int index = 0; index < contents->num_lights; index++){
+
+        const light *current = &contents->light_list[index];
+
+        digest_floats(&context, &current->theta, 1);
+        digest_floats(&context, current->color, 3);
+        digest_floats(&context, current->center, 3);
+        digest_floats(&context, current->radial, 3);
+
+        // Point lights leave the spot fields unset.
+        if(current->theta != 0){
+
+            digest_floats(&context, &current->angular_a0, 1);
+            digest_floats(&context, current->direction, 3);
+        }
+    }
+
+    for(int index = 0; index < contents->num_materials; index++){
+
+        const material *current = &contents->material_list[index];
+
+        digest_ints(&context, current->diffuse_color, 3);
+        digest_ints(&context, current->specular_color, 3);
+        digest_floats(&context, &current->shininess, 1);
+        digest_floats(&context, &current->reflectivity, 1);
+        digest_ints(&context, &current->texture_index, 1);
+    }
+
+    for(int index = 0; index < contents->num_textures; index++){
+
+        const texture *current = &contents->texture_list[index];
+        int fields[3] = {current->procedural.kind, current->width, current->height};
+
+        digest_ints(&context, fields, 3);
+
+        if(current->procedural.kind != NoPattern){
+
+            digest_floats(&context, &current->procedural.inv_size, 1);
+            digest_floats(&context, &current->procedural.colors[0][0], 6);
+
+        } else if(current->paged != NULL){
+
+            // Straight from disk, so the digest doesn't page the whole
+            // texture through the tiles. Texels that can't be read are
+            // hashed black, as they would render.
+            uint8_t texels[65536];
+            size_t length = (size_t) current->width * current->height * 3;
+
+            for(size_t offset = 0; offset < length; offset += sizeof(texels)){
+
+                size_t part = length - offset < sizeof(texels) ? length - offset : sizeof(texels);
+
+                if(!texture_pager_read(current->paged, offset, part, texels)){
+
+                    memset(texels, 0, part);
+                }
+
+                sha256_update(&context, texels, part);
+            }
+
+        } else {
+
+            sha256_update(&context, current->pixmap, (size_t) current->width * current->height * 3);
+        }
+    }
+
+    for(int index = 0; index < contents->num_meshes; index++){
+
+        const triangle_mesh *current = &contents->mesh_list[index];
+        int fields[3] = {current->num_vertices, current->num_triangles, current->uvs != NULL};
+
+        digest_ints(&context, fields, 3);
+        digest_floats(&context, current->positions, current->num_vertices * 3);
+
+        if(current->uvs != NULL){
+
+            digest_floats(&context, current->uvs, current->num_vertices * 2);
+        }
+
+        sha256_update(&context, current->indices, sizeof(uint32_t) * current->num_triangles * 3);
+    }
+
+    sha256_final(&context, digest);
+}
+
+void rt_render_digest(const uint8_t scene_digest[32], const rt_render_options *options,
+                      uint8_t digest[32]){
+
+    int region[4];
+    resolve_region(options, region);
+
+    int fields[4] = {RT_RENDER_VERSION, options->width, options->height, options->fast_math};
+
+    sha256_context context;
+
+    sha256_init(&context);
+    sha256_update(&context, scene_digest, 32);
+    digest_ints(&context, fields, 4);
+    digest_ints(&context, region, 4);
+    digest_floats(&context, &options->light_cutoff, 1);
+    sha256_final(&context, digest);
+}
+
+void rt_render_options_init(rt_render_options *options, int width, int height){
+
+    options->width = width;
+    options->height = height;
+    options->num_threads = 0;
+    options->light_cutoff = 0;
+    options->fast_math = false;
+
+    for(int i = 0; i < 4; i++){
+
+        options->region[i] = 0;
+    }
+
+    options->progress = NULL;
+    options->tile_done = NULL;
+    options->user_data = NULL;
+    options->skip_tiles = NULL;
+
+    options->heat = NULL;
+    options->trace = NULL;
+}
+
+rt_context *rt_context_create(){
+
+    rt_context *context = calloc(1, sizeof(rt_context));
+
+    if(context != NULL){
+
+        atomic_init(&context->cancelled, 0);
+    }
+
+    return context;
+}
+
+void rt_context_free(rt_context *context){
+
+    free(context);
+}
+
+rt_status rt_render(rt_context *context, rt_scene *loaded, rt_render_options *options,
+                    uint8_t *pixmap){
+
+    if(context == NULL){
+
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+
+    memset(&context->stats, 0, sizeof(render_stats));
+    context->error.status = RT_OK;
+    context->error.message[0] = '\0';
+
+    if(loaded == NULL || options == NULL || pixmap == NULL){
+
+        return set_error(&context->error, RT_ERROR_INVALID_ARGUMENT, "No scene, options or pixmap given.");
+    }
+
+    if(options->width <= 0 || options->height <= 0){
+
+        return set_error(&context->error, RT_ERROR_INVALID_ARGUMENT,
+                         "The width and height must be positive.");
+    }
+
+    rt_render_options resolved = *options;
+    resolve_region(options, resolved.region);
+
+    if(resolved.region[0] < 0 || resolved.region[1] < 0 || resolved.region[0] >= resolved.region[2] ||
+       resolved.region[1] >= resolved.region[3] || resolved.region[2] > resolved.width ||
+       resolved.region[3] > resolved.height){
+
+        return set_error(&context->error, RT_ERROR_INVALID_ARGUMENT,
+                         "The region must be a non-empty part of the frame.");
+    }
+
+    if(options->heat != NULL && (options->heat->width != resolved.region[2] - resolved.region[0] ||
+                                 options->heat->height != resolved.region[3] - resolved.region[1])){
+
+        return set_error(&context->error, RT_ERROR_INVALID_ARGUMENT,
+                         "The heatmap must be the size of the render.");
+    }
+
+    if(resolved.light_cutoff < 0){
+
+        return set_error(&context->error, RT_ERROR_INVALID_ARGUMENT, "The light cutoff can't be negative.");
+    }
+
+    if(resolved.num_threads <= 0){
+
+        resolved.num_threads = default_thread_count();
+    }
+
+    atomic_store(&context->cancelled, 0);
+
+    if(!raytrace(pixmap, &loaded->contents, &resolved, &context->stats, &context->cancelled)){
+
+        return set_error(&context->error, RT_ERROR_CANCELLED, "The render was cancelled.");
+    }
+
+    return RT_OK;
+}
+
+void rt_context_cancel(rt_context *context){
+
+    atomic_store(&context->cancelled, 1);
+}
+
+render_stats *rt_context_stats(rt_context *context){
+
+    return &context->stats;
+}
+
+const char *rt_context_error(rt_context *context){
+
+    return context->error.message;
+}
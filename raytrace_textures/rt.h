@@ -0,0 +1,247 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "heatmap.h"
+#include "trace.h"
+
+// Embeddable interface to the renderer. Scenes and render contexts are
+// opaque handles; nothing here exits the process or prints. Every call that
+// can fail returns an rt_status and, where there is somewhere to put it, a
+// message saying what went wrong.
+//
+// A loaded scene is only read while rendering, so one scene may be rendered
+// by several contexts on different threads at once. A context runs one
+// render at a time.
+
+// Bumped whenever a change to the renderer changes the pixels it produces,
+// so digests from rt_render_digest() made by older builds stop matching.
+#define RT_RENDER_VERSION 2
+
+typedef enum {
+
+    RT_OK,
+    RT_ERROR_IO,
+    RT_ERROR_PARSE,
+    RT_ERROR_NO_MEMORY,
+    RT_ERROR_INVALID_ARGUMENT,
+    RT_ERROR_CANCELLED
+
+} rt_status;
+
+typedef struct {
+
+    rt_status status;
+    char message[256];
+
+} rt_error;
+
+typedef struct rt_scene rt_scene;
+typedef struct rt_context rt_context;
+typedef struct rt_texture_cache rt_texture_cache;
+typedef struct rt_texture_pager rt_texture_pager;
+
+// Called after each finished tile with the number of tiles done so far.
+// Calls are serialized, but may come from any render thread. Returning
+// nonzero cancels the render.
+typedef int (*rt_progress_callback)(int tiles_done, int num_tiles, void *user_data);
+
+// Called after tile, whose pixels x0, y0, x1, y1 (see rt_tile_bounds()) are
+// now final in the pixmap. Serialized with progress and shares its
+// user_data; returning nonzero cancels the render.
+typedef int (*rt_tile_callback)(int tile, const int bounds[4], void *user_data);
+
+typedef struct {
+
+    int width;
+    int height;
+
+    // x0, y0, x1, y1 in pixels, x1 and y1 exclusive. Only this part of the
+    // width x height frame is rendered, with the same pixels as a full
+    // render, and the pixmap and heatmap hold just the region. All zero
+    // renders the whole frame.
+    int region[4];
+
+    // 0 = one per online CPU.
+    int num_threads;
+
+    // Lights are ignored where their radial attenuation falls below this,
+    // so each only reaches a limited distance. 0 keeps every light
+    // everywhere and renders exactly.
+    float light_cutoff;
+
+    // Shade with float approximations of atan2, acos, pow and sqrt (see
+    // fastmath.h) instead of libm. Textured and lit pixels can then differ
+    // from an exact render by a few levels.
+    bool fast_math;
+
+    rt_progress_callback progress;
+    rt_tile_callback tile_done;
+    void *user_data;
+
+    // Optional, rt_tile_count() entries. Tiles marked nonzero are already
+    // in the pixmap, from an earlier render of the same frame, and are
+    // left alone; they count as done for progress.
+    const uint8_t *skip_tiles;
+
+    // Optional; when set they must cover the region and num_threads render
+    // threads respectively.
+    heatmap *heat;
+    trace_log *trace;
+
+} rt_render_options;
+
+typedef struct {
+
+    // All optional. trace gets the parse, texture loads and bake in its
+    // main-thread buffer. With textures, pixmaps are shared with every other
+    // scene loaded through the same cache. With pager, image textures are
+    // not read whole but paged in a tile at a time as renders sample them,
+    // and textures is not used.
+    trace_log *trace;
+    rt_texture_cache *textures;
+    rt_texture_pager *pager;
+
+    // Threads parsing a scene of several MB, split between them a part of
+    // the file each; 0 = one per online CPU. Smaller scenes are parsed on
+    // the calling thread.
+    int num_threads;
+
+} rt_load_options;
+
+typedef struct {
+
+    long hits;
+    long misses;
+    int num_textures;
+    size_t bytes;
+
+} rt_texture_cache_stats;
+
+typedef struct {
+
+    long hits;
+    long misses;
+    long evictions;
+
+    // Tiles that couldn't be read from disk and were rendered black.
+    long read_errors;
+
+    int num_textures;
+    size_t resident_bytes;
+    size_t budget_bytes;
+
+} rt_texture_pager_stats;
+
+typedef struct {
+
+    float camera_width;
+    float camera_height;
+
+    int num_objects;
+    int num_lights;
+    int num_materials;
+    int num_textures;
+    int num_meshes;
+    long num_triangles;
+
+    // How long loading took, split the way write_stats_json() reports it;
+    // reading meshes counts as texture loading.
+    double parse_ms;
+    double texture_load_ms;
+
+} rt_scene_info;
+
+const char *rt_status_string(rt_status status);
+
+// Parses a .scene file, reads its textures and meshes and bakes it for
+// rendering. Large files are mapped into memory and parsed in parallel.
+// Texture and mesh filenames are opened as written, relative to the
+// working directory. options and error may be NULL.
+rt_status rt_scene_load_file(rt_scene **loaded, const char *filename, rt_load_options *options,
+                             rt_error *error);
+
+// Same as rt_scene_load_file() for scene text already in memory.
+rt_status rt_scene_load_memory(rt_scene **loaded, const char *text, size_t length,
+                               rt_load_options *options, rt_error *error);
+
+void rt_scene_free(rt_scene *loaded);
+
+void rt_scene_get_info(rt_scene *loaded, rt_scene_info *info);
+
+// SHA-256 of everything in loaded that decides how it renders: the camera,
+// objects, lights and materials as parsed, the texels of every texture and
+// the geometry of every mesh. Scenes that differ only in formatting,
+// comments or file names get the same digest. Reads all texture and mesh
+// data, so callers rendering a scene repeatedly should keep the result.
+void rt_scene_digest(rt_scene *loaded, uint8_t digest[32]);
+
+// Combines a scene digest with the options that change the image (size,
+// region, light cutoff and fast math) and RT_RENDER_VERSION, giving a key
+// that names one rendered image.
+void rt_render_digest(const uint8_t scene_digest[32], const rt_render_options *options,
+                      uint8_t digest[32]);
+
+// Textures not used by any scene are evicted, least recently used first,
+// once the cache holds more than budget_bytes of pixels. Safe to share
+// between threads. Returns NULL if memory runs out.
+rt_texture_cache *rt_texture_cache_create(size_t budget_bytes);
+
+// Every scene loaded through the cache must be freed first.
+void rt_texture_cache_free(rt_texture_cache *cache);
+
+void rt_texture_cache_get_stats(rt_texture_cache *cache, rt_texture_cache_stats *stats);
+
+// Keeps at most budget_bytes of texture tiles in memory, evicting tiles
+// not sampled since the clock hand last passed them. The memory is
+// reserved up front but only used as tiles are read. Safe to share
+// between threads and scenes. Returns NULL if memory runs out.
+rt_texture_pager *rt_texture_pager_create(size_t budget_bytes);
+
+// Every scene loaded through the pager must be freed first.
+void rt_texture_pager_free(rt_texture_pager *pager);
+
+// Counts tile lookups by render threads since the pager was created.
+void rt_texture_pager_get_stats(rt_texture_pager *pager, rt_texture_pager_stats *stats);
+
+// Number of online CPUs, the number of render threads used when
+// num_threads is 0.
+int rt_default_thread_count();
+
+// Fills options with the defaults for a width x height render.
+void rt_render_options_init(rt_render_options *options, int width, int height);
+
+// Renders split the region into a fixed grid of tiles, numbered row by row,
+// so a tile index means the same pixels in every render with the same
+// width, height and region.
+int rt_tile_count(const rt_render_options *options);
+
+// Frame pixels x0, y0, x1, y1 (exclusive) of tile.
+void rt_tile_bounds(const rt_render_options *options, int tile, int bounds[4]);
+
+// Returns NULL if memory runs out.
+rt_context *rt_context_create();
+
+void rt_context_free(rt_context *context);
+
+// Renders loaded into pixmap, which holds an RGB triple per pixel of the
+// region. On
+// RT_ERROR_CANCELLED the tiles finished before the cancel are filled in.
+rt_status rt_render(rt_context *context, rt_scene *loaded, rt_render_options *options,
+                    uint8_t *pixmap);
+
+// Asks the render running on context, if any, to stop after its current
+// tiles. Safe to call from any thread.
+void rt_context_cancel(rt_context *context);
+
+// Counters of the last render on context.
+render_stats *rt_context_stats(rt_context *context);
+
+// Message for the last failed render on context, or "" after a success.
+const char *rt_context_error(rt_context *context);
+
+#endif
@@ -0,0 +1,1421 @@
+#include <pthread.h>
+#include <stdarg.h>
+
+#include "scene.h"
+#include "stats.h"
+#include "texcache.h"
+#include "fastmath.h"
+
+const int MAX_SIZE = 128;
+
+
+rt_status set_error(rt_error *error, rt_status status, const char *format, ...){
+
+    if(error == NULL){
+
+        return status;
+    }
+
+    error->status = status;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error->message, sizeof(error->message), format, args);
+    va_end(args);
+
+    return status;
+}
+
+// Gets the camera width and height and stores them in the provided pointers,
+// leaving fp at the first object in the list.
+rt_status get_camera(FILE *fp, float *camera_width, float *camera_height, rt_error *error) {
+
+    char string_width[MAX_SIZE + 1];
+    char string_height[MAX_SIZE + 1];
+
+    // Assuming the camera will always be formatted correctly,
+    // we can use an fscanf pattern for parsing the width and height.
+    if(fscanf(fp, "%*s %*s %128s %*s %128s", string_width, string_height) != 2){
+
+        return set_error(error, RT_ERROR_PARSE, "Could not read the camera from the scene file.");
+    }
+
+    float width = atof(string_width);
+    float height = atof(string_height);
+
+    *camera_width = width;
+    *camera_height = height;
+
+    return RT_OK;
+}
+
+// Compares every field that is read from the scene file.
+bool material_equals(material *a, material *b){
+
+    for(int i = 0; i < 3; i++){
+
+        if(a->diffuse_color[i] != b->diffuse_color[i] || a->specular_color[i] != b->specular_color[i]){
+
+            return false;
+        }
+    }
+
+    return a->shininess == b->shininess && a->reflectivity == b->reflectivity &&
+           a->texture_index == b->texture_index;
+}
+
+// FNV-1a over the fields compared by material_equals().
+uint32_t material_hash(material *a){
+
+    float fields[9] = {a->diffuse_color[0], a->diffuse_color[1], a->diffuse_color[2],
+                       a->specular_color[0], a->specular_color[1], a->specular_color[2],
+                       a->shininess, a->reflectivity, a->texture_index};
+
+    uint8_t *bytes = (uint8_t *) fields;
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < sizeof(fields); i++){
+
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Doubles *capacity when *list is full, moving *list if needed. Returns
+// false, leaving the list as it was, if memory runs out.
+bool grow_list(void **list, int count, int *capacity, size_t element_size){
+
+    if(count < *capacity){
+
+        return true;
+    }
+
+    int new_capacity = *capacity == 0 ? 16 : *capacity * 2;
+
+    void *new_list = realloc(*list, new_capacity * element_size);
+
+    if(new_list == NULL){
+
+        return false;
+    }
+
+    *list = new_list;
+    *capacity = new_capacity;
+
+    return true;
+}
+
+// Open-addressed index from material hash to material table slot; keeps
+// deduplication linear in the number of objects.
+typedef struct {
+
+    int *slots;
+    int capacity;
+
+} material_lookup;
+
+// Returns the index of new_material in the material table, adding it if no
+// identical material is already listed, or -1 if memory runs out.
+int add_material(scene *current_scene, material_lookup *index, material *new_material){
+
+    // Keep the load factor at or below one half.
+    if(current_scene->num_materials * 2 >= index->capacity){
+
+        free(index->slots);
+
+        index->capacity = index->capacity == 0 ? 64 : index->capacity * 2;
+        index->slots = malloc(sizeof(int) * index->capacity);
+
+        if(index->slots == NULL){
+
+            index->capacity = 0;
+
+            return -1;
+        }
+
+        for(int slot = 0; slot < index->capacity; slot++){
+
+            index->slots[slot] = -1;
+        }
+
+        for(int material_index = 0; material_index < current_scene->num_materials; material_index++){
+
+            uint32_t slot = material_hash(&current_scene->material_list[material_index]);
+
+            while(index->slots[slot & (index->capacity - 1)] != -1){
+
+                slot++;
+            }
+
+            index->slots[slot & (index->capacity - 1)] = material_index;
+        }
+    }
+
+    uint32_t slot = material_hash(new_material);
+
+    while(index->slots[slot & (index->capacity - 1)] != -1){
+
+        int material_index = index->slots[slot & (index->capacity - 1)];
+
+        if(material_equals(&current_scene->material_list[material_index], new_material)){
+
+            return material_index;
+        }
+
+        slot++;
+    }
+
+    if(!grow_list((void **) &current_scene->material_list, current_scene->num_materials,
+                  &current_scene->material_capacity, sizeof(material))){
+
+        return -1;
+    }
+
+    current_scene->material_list[current_scene->num_materials] = *new_material;
+    index->slots[slot & (index->capacity - 1)] = current_scene->num_materials;
+
+    current_scene->num_materials++;
+
+    return current_scene->num_materials - 1;
+}
+
+// Returns the texture index for filename, adding an unloaded entry the first
+// time a file is referenced so every object using it shares one pixmap.
+// Returns -1 if memory runs out.
+int add_texture(scene *current_scene, char *filename){
+
+    for(int texture_index = 0; texture_index < current_scene->num_textures; texture_index++){
+
+        if(strcmp(current_scene->texture_list[texture_index].filename, filename) == 0){
+
+            return texture_index;
+        }
+    }
+
+    if(!grow_list((void **) &current_scene->texture_list, current_scene->num_textures,
+                  &current_scene->texture_capacity, sizeof(texture))){
+
+        return -1;
+    }
+
+    texture *new_texture = &current_scene->texture_list[current_scene->num_textures];
+
+    new_texture->filename = strdup(filename);
+
+    if(new_texture->filename == NULL){
+
+        return -1;
+    }
+    new_texture->width = 0;
+    new_texture->height = 0;
+    new_texture->pixmap = NULL;
+    new_texture->paged = NULL;
+    new_texture->procedural.kind = NoPattern;
+
+    current_scene->num_textures++;
+
+    return current_scene->num_textures - 1;
+}
+
+// Returns the mesh index for filename, adding an unloaded entry the first
+// time a file is referenced so every object using it shares one copy.
+// Returns -1 if memory runs out.
+int add_mesh(scene *current_scene, char *filename){
+
+    for(int mesh_index = 0; mesh_index < current_scene->num_meshes; mesh_index++){
+
+        if(strcmp(current_scene->mesh_list[mesh_index].filename, filename) == 0){
+
+            return mesh_index;
+        }
+    }
+
+    if(!grow_list((void **) &current_scene->mesh_list, current_scene->num_meshes,
+                  &current_scene->mesh_capacity, sizeof(triangle_mesh))){
+
+        return -1;
+    }
+
+    triangle_mesh *new_mesh = &current_scene->mesh_list[current_scene->num_meshes];
+
+    memset(new_mesh, 0, sizeof(triangle_mesh));
+
+    new_mesh->filename = strdup(filename);
+
+    if(new_mesh->filename == NULL){
+
+        return -1;
+    }
+
+    current_scene->num_meshes++;
+
+    return current_scene->num_meshes - 1;
+}
+
+// Empties every list of current_scene without freeing anything.
+void clear_lists(scene *current_scene){
+
+    current_scene->object_list = NULL;
+    current_scene->light_list = NULL;
+    current_scene->texture_list = NULL;
+    current_scene->material_list = NULL;
+    current_scene->mesh_list = NULL;
+
+    current_scene->num_objects = 0;
+    current_scene->num_lights = 0;
+    current_scene->num_textures = 0;
+    current_scene->num_materials = 0;
+    current_scene->num_meshes = 0;
+
+    current_scene->object_capacity = 0;
+    current_scene->light_capacity = 0;
+    current_scene->texture_capacity = 0;
+    current_scene->material_capacity = 0;
+    current_scene->mesh_capacity = 0;
+}
+
+rt_status get_objects(FILE *fp, scene *current_scene, rt_error *error) {
+
+    char string_buffer[MAX_SIZE + 1];
+
+    material_lookup index = {NULL, 0};
+
+    clear_lists(current_scene);
+
+    while(!feof(fp)){
+
+        // Grab the object's type. Running out of entries ends the list.
+        if(fscanf(fp, " %128[^,] ", string_buffer) != 1){
+
+            if(feof(fp)){
+
+                break;
+            }
+
+            // Prevents infinite loops caused by improper formatting.
+            free(index.slots);
+
+            return set_error(error, RT_ERROR_PARSE, "Improper formatting of scene file.");
+        }
+
+        if(strcmp(string_buffer, "sphere") == 0 || strcmp(string_buffer, "plane") == 0 ||
+           strcmp(string_buffer, "mesh") == 0) {
+
+            object new_object;
+            material new_material;
+
+            // Default the diffuse color to black in case a texture is used instead.
+            new_material.diffuse_color[0] = 0;
+            new_material.diffuse_color[1] = 0;
+            new_material.diffuse_color[2] = 0;
+
+            // Default the texture index to -1 in case a texture is not used.
+            new_material.texture_index = -1;
+
+            // Default the specular color to black in case it isn't listed.
+            new_material.specular_color[0] = 0;
+            new_material.specular_color[1] = 0;
+            new_material.specular_color[2] = 0;
+
+            // ns was hard-coded to 20 before it could be listed.
+            new_material.shininess = 20;
+
+            new_material.reflectivity = 0;
+
+            if(strcmp(string_buffer, "sphere") == 0) {
+
+                new_object.type = Sphere;
+
+            }
+
+            if(strcmp(string_buffer, "plane") == 0) {
+
+                new_object.type = Plane;
+
+            }
+
+            if(strcmp(string_buffer, "mesh") == 0) {
+
+                new_object.type = Mesh;
+
+                // Meshes are placed at the origin at their own size unless
+                // told otherwise.
+                new_object.center[0] = 0;
+                new_object.center[1] = 0;
+                new_object.center[2] = 0;
+                new_object.mesh.mesh_index = -1;
+                new_object.mesh.scale = 1;
+
+            }
+
+            // prime the while-loop.
+            char delim = fgetc(fp);
+
+            // iterate until the end of the line
+            while(delim == ','){
+
+                fscanf(fp, " %128s ", string_buffer);
+
+                if(strcmp(string_buffer, "radius:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_object.sphere.radius = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "diffuse_color:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_material.diffuse_color[0] = floor(255 * atof(string_buffer));
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_material.diffuse_color[1] = floor(255 * atof(string_buffer));
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_material.diffuse_color[2] =  floor(255 * atof(string_buffer));
+
+                }
+
+                else if(strcmp(string_buffer, "specular_color:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_material.specular_color[0] = floor(255 * atof(string_buffer));
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_material.specular_color[1] = floor(255 * atof(string_buffer));
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_material.specular_color[2] = floor(255 * atof(string_buffer));
+
+                }
+
+                else if(strcmp(string_buffer, "position:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_object.center[0] = atof(string_buffer);
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_object.center[1] = atof(string_buffer);
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_object.center[2] = atof(string_buffer);
+
+                }
+                
+                else if(strcmp(string_buffer, "normal:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_object.plane.normal[0] = atof(string_buffer);
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_object.plane.normal[1] = atof(string_buffer);
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_object.plane.normal[2] = atof(string_buffer);
+
+                }
+
+               else if(strcmp(string_buffer, "reflectivity:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_material.reflectivity = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "shininess:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_material.shininess = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "texture:") == 0){
+
+                    fscanf(fp, " %128[^,^\n(]", string_buffer);
+
+                    // A pattern name is followed by its arguments in
+                    // parentheses, which may hold commas of their own.
+                    char args[MAX_SIZE + 1];
+                    args[0] = '\0';
+                    int next = fgetc(fp);
+                    bool is_pattern = next == '(';
+
+                    if(is_pattern && (fscanf(fp, "%128[^)\n]", args) < 0 || fgetc(fp) != ')')){
+
+                        free(index.slots);
+
+                        return set_error(error, RT_ERROR_PARSE, "The texture pattern %s( is not closed.",
+                                         string_buffer);
+                    }
+
+                    if(!is_pattern){
+
+                        ungetc(next, fp);
+                    }
+
+                    // string_buffer contains the filename of the texture; the
+                    // pixmap is read later by load_textures(). A pattern is
+                    // keyed by its full text so identical ones are shared.
+                    char key[2 * MAX_SIZE + 3];
+                    snprintf(key, sizeof(key), is_pattern ? "%s(%s)" : "%s", string_buffer, args);
+
+                    new_material.texture_index = add_texture(current_scene, key);
+
+                    if(new_material.texture_index < 0){
+
+                        free(index.slots);
+
+                        return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+                    }
+
+                    if(is_pattern){
+
+                        texture *new_texture = &current_scene->texture_list[new_material.texture_index];
+                        rt_status status = parse_pattern(string_buffer, args, &new_texture->procedural, error);
+
+                        if(status != RT_OK){
+
+                            free(index.slots);
+
+                            return status;
+                        }
+                    }
+
+                }
+
+                else if(strcmp(string_buffer, "file:") == 0 && new_object.type == Mesh){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    // The triangles are read later by load_meshes().
+                    new_object.mesh.mesh_index = add_mesh(current_scene, string_buffer);
+
+                    if(new_object.mesh.mesh_index < 0){
+
+                        free(index.slots);
+
+                        return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+                    }
+
+                }
+
+                else if(strcmp(string_buffer, "scale:") == 0 && new_object.type == Mesh){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_object.mesh.scale = atof(string_buffer);
+
+                }
+
+                delim = fgetc(fp);
+            }
+
+            if(new_object.type == Mesh && (new_object.mesh.mesh_index < 0 || new_object.mesh.scale <= 0)){
+
+                free(index.slots);
+
+                return set_error(error, RT_ERROR_PARSE, "A mesh needs a file and a positive scale.");
+            }
+
+            new_object.material_index = add_material(current_scene, &index, &new_material);
+
+            if(new_object.material_index < 0 ||
+               !grow_list((void **) &current_scene->object_list, current_scene->num_objects,
+                          &current_scene->object_capacity, sizeof(object))){
+
+                free(index.slots);
+
+                return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+            }
+
+            current_scene->object_list[current_scene->num_objects] = new_object;
+            current_scene->num_objects++;
+
+        }
+
+        else if(strcmp(string_buffer, "light") == 0) {
+
+            light new_light;
+
+            // Default to 0.0 in case 
+            new_light.theta = 0.0;
+            new_light.angular_a0 = 0.0;
+
+            // prime the while-loop.
+            char delim = fgetc(fp);
+
+            // iterate until the end of the line
+            while(delim == ','){
+
+                fscanf(fp, " %128s ", string_buffer);
+
+                if(strcmp(string_buffer, "theta:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.theta = atof(string_buffer);
+
+                    // Only need to calculate cosine if the light is a spotlight.
+                    if(new_light.theta != 0){
+
+                        // convert theta to radians for cosine function
+                        float rad_theta = new_light.theta * M_PI / 180;
+
+                        new_light.cosine = cos(rad_theta);
+                    }
+
+                }
+
+                else if(strcmp(string_buffer, "radial-a0:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.radial[0] = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "radial-a1:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.radial[1] = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "radial-a2:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.radial[2] = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "angular-a0:") == 0){
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.angular_a0 = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "color:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_light.color[0] = atof(string_buffer);
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_light.color[1] = atof(string_buffer);
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.color[2] =  atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "direction:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_light.direction[0] = atof(string_buffer);
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_light.direction[1] = atof(string_buffer);
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.direction[2] = atof(string_buffer);
+
+                }
+
+                else if(strcmp(string_buffer, "position:") == 0){
+
+                    fscanf(fp, " [%128s ", string_buffer);
+
+                    new_light.center[0] = atof(string_buffer);
+
+                    fscanf(fp, " %128s", string_buffer);
+
+                    new_light.center[1] = atof(string_buffer);
+
+                    fscanf(fp, " %128[^,^\n]", string_buffer);
+
+                    new_light.center[2] = atof(string_buffer);
+
+                }
+
+                delim = fgetc(fp);
+            }
+
+            if(!grow_list((void **) &current_scene->light_list, current_scene->num_lights,
+                          &current_scene->light_capacity, sizeof(light))){
+
+                free(index.slots);
+
+                return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+            }
+
+            current_scene->light_list[current_scene->num_lights] = new_light;
+            current_scene->num_lights++;
+
+        }
+
+        else {
+
+            free(index.slots);
+
+            return set_error(error, RT_ERROR_PARSE, "Unknown entry \"%s\" in scene file.", string_buffer);
+        }
+    }
+
+    free(index.slots);
+
+    return RT_OK;
+}
+
+// True if a line starting at text begins a new entry: only whitespace, then
+// an entry type and its comma.
+bool starts_entry(const char *text, const char *end){
+
+    const char *types[] = {"sphere", "plane", "mesh", "light"};
+
+    while(text < end && (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n')){
+
+        text++;
+    }
+
+    for(int type = 0; type < 4; type++){
+
+        size_t length = strlen(types[type]);
+
+        if((size_t) (end - text) > length && memcmp(text, types[type], length) == 0){
+
+            const char *after = text + length;
+
+            while(after < end && (*after == ' ' || *after == '\t')){
+
+                after++;
+            }
+
+            return after < end && *after == ',';
+        }
+    }
+
+    return false;
+}
+
+// Returns the first offset at or after from where a part of text can start:
+// just past a newline that ends an entry, before a line that starts one.
+// A newline right after a comma is inside an entry that continues on the
+// next line. Returns length if there is none.
+size_t next_entry_boundary(const char *text, size_t length, size_t from){
+
+    for(size_t offset = from; offset < length; offset++){
+
+        if(text[offset] != '\n'){
+
+            continue;
+        }
+
+        size_t last = offset;
+
+        while(last > 0 && (text[last - 1] == ' ' || text[last - 1] == '\t' || text[last - 1] == '\r' ||
+                           text[last - 1] == '\n')){
+
+            last--;
+        }
+
+        if((last == 0 || text[last - 1] != ',') && starts_entry(&text[offset + 1], &text[length])){
+
+            return offset + 1;
+        }
+    }
+
+    return length;
+}
+
+// One part of the scene text and the lists get_objects() makes of it.
+typedef struct {
+
+    const char *text;
+    size_t length;
+
+    scene part;
+    rt_status status;
+    rt_error error;
+
+} parse_part;
+
+void *parse_part_main(void *argument){
+
+    parse_part *current = argument;
+
+    // The parser only reads, so the cast is safe.
+    FILE *fp = fmemopen((void *) current->text, current->length, "r");
+
+    if(fp == NULL){
+
+        current->status = set_error(&current->error, RT_ERROR_NO_MEMORY,
+                                    "Could not open the scene text as a stream.");
+
+        return NULL;
+    }
+
+    current->status = get_objects(fp, &current->part, &current->error);
+
+    fclose(fp);
+
+    return NULL;
+}
+
+// join_part() with the new index of each texture, mesh and material of part
+// written to the arrays given.
+bool join_lists(scene *current_scene, material_lookup *index, scene *part, int *texture_indices,
+                int *mesh_indices, int *material_indices){
+
+    for(int texture_index = 0; texture_index < part->num_textures; texture_index++){
+
+        texture *part_texture = &part->texture_list[texture_index];
+        int num_textures = current_scene->num_textures;
+
+        texture_indices[texture_index] = add_texture(current_scene, part_texture->filename);
+
+        if(texture_indices[texture_index] < 0){
+
+            return false;
+        }
+
+        // A pattern's text is its filename, so a new entry only needs the
+        // parsed pattern copied.
+        if(current_scene->num_textures > num_textures){
+
+            current_scene->texture_list[texture_indices[texture_index]].procedural = part_texture->procedural;
+        }
+    }
+
+    for(int mesh_index = 0; mesh_index < part->num_meshes; mesh_index++){
+
+        mesh_indices[mesh_index] = add_mesh(current_scene, part->mesh_list[mesh_index].filename);
+
+        if(mesh_indices[mesh_index] < 0){
+
+            return false;
+        }
+    }
+
+    for(int material_index = 0; material_index < part->num_materials; material_index++){
+
+        material new_material = part->material_list[material_index];
+
+        if(new_material.texture_index >= 0){
+
+            new_material.texture_index = texture_indices[new_material.texture_index];
+        }
+
+        material_indices[material_index] = add_material(current_scene, index, &new_material);
+
+        if(material_indices[material_index] < 0){
+
+            return false;
+        }
+    }
+
+    for(int object_index = 0; object_index < part->num_objects; object_index++){
+
+        if(!grow_list((void **) &current_scene->object_list, current_scene->num_objects,
+                      &current_scene->object_capacity, sizeof(object))){
+
+            return false;
+        }
+
+        object *new_object = &current_scene->object_list[current_scene->num_objects];
+
+        *new_object = part->object_list[object_index];
+        new_object->material_index = material_indices[new_object->material_index];
+
+        if(new_object->type == Mesh){
+
+            new_object->mesh.mesh_index = mesh_indices[new_object->mesh.mesh_index];
+        }
+
+        current_scene->num_objects++;
+    }
+
+    for(int light_index = 0; light_index < part->num_lights; light_index++){
+
+        if(!grow_list((void **) &current_scene->light_list, current_scene->num_lights,
+                      &current_scene->light_capacity, sizeof(light))){
+
+            return false;
+        }
+
+        current_scene->light_list[current_scene->num_lights] = part->light_list[light_index];
+        current_scene->num_lights++;
+    }
+
+    return true;
+}
+
+// Appends the entries of part to current_scene, renumbering its textures,
+// meshes and materials into current_scene's lists, where the same file,
+// pattern or material is only listed once, as get_objects() would have.
+bool join_part(scene *current_scene, material_lookup *index, scene *part){
+
+    int *indices = malloc(sizeof(int) * (part->num_textures + part->num_meshes + part->num_materials + 1));
+
+    if(indices == NULL){
+
+        return false;
+    }
+
+    bool joined = join_lists(current_scene, index, part, indices, &indices[part->num_textures],
+                             &indices[part->num_textures + part->num_meshes]);
+
+    free(indices);
+
+    return joined;
+}
+
+rt_status get_objects_parallel(const char *text, size_t length, scene *current_scene, int num_threads,
+                               rt_error *error){
+
+    clear_lists(current_scene);
+
+    int num_parts = length / PARSE_PART_MIN_BYTES;
+
+    if(num_parts > num_threads){
+
+        num_parts = num_threads;
+    }
+
+    if(num_parts < 1){
+
+        num_parts = 1;
+    }
+
+    parse_part *parts = calloc(num_parts, sizeof(parse_part));
+    pthread_t *threads = calloc(num_parts, sizeof(pthread_t));
+    bool *started = calloc(num_parts, sizeof(bool));
+
+    if(parts == NULL || threads == NULL || started == NULL){
+
+        free(parts);
+        free(threads);
+        free(started);
+
+        return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+    }
+
+    // Even shares of the text, each moved forward to where an entry starts.
+    size_t start = 0;
+
+    for(int part_index = 0; part_index < num_parts; part_index++){
+
+        size_t end = part_index == num_parts - 1 ? length :
+                     next_entry_boundary(text, length, length / num_parts * (part_index + 1));
+
+        if(end < start){
+
+            end = start;
+        }
+
+        parts[part_index].text = &text[start];
+        parts[part_index].length = end - start;
+
+        start = end;
+    }
+
+    // The first part is parsed here, as are any whose thread won't start.
+    for(int part_index = 1; part_index < num_parts; part_index++){
+
+        started[part_index] = parts[part_index].length > 0 &&
+                              pthread_create(&threads[part_index], NULL, parse_part_main, &parts[part_index]) == 0;
+    }
+
+    for(int part_index = 0; part_index < num_parts; part_index++){
+
+        if(started[part_index]){
+
+            pthread_join(threads[part_index], NULL);
+
+        } else if(parts[part_index].length > 0){
+
+            parse_part_main(&parts[part_index]);
+        }
+    }
+
+    // Joined in file order, so every index is the one get_objects() would
+    // give, and the error reported is the first in the file.
+    rt_status status = RT_OK;
+    material_lookup index = {NULL, 0};
+
+    for(int part_index = 0; part_index < num_parts; part_index++){
+
+        parse_part *current = &parts[part_index];
+
+        if(status == RT_OK && current->status != RT_OK){
+
+            status = current->status;
+
+            if(error != NULL){
+
+                *error = current->error;
+            }
+        }
+
+        if(status == RT_OK && !join_part(current_scene, &index, &current->part)){
+
+            status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for the scene has failed!");
+        }
+
+        free_scene(&current->part);
+    }
+
+    free(index.slots);
+    free(parts);
+    free(threads);
+    free(started);
+
+    return status;
+}
+
+// Reads the P3 or P6 image in filename into a new pixmap.
+rt_status read_texture(const char *filename, int *width, int *height, uint8_t **pixmap,
+                       rt_error *error) {
+
+    FILE *texture_fp = fopen(filename, "r");
+
+    if(texture_fp == NULL){
+
+        return set_error(error, RT_ERROR_IO, "Could not open texture %s", filename);
+    }
+
+    char header_num[3];
+
+    int max_val = 0;
+
+    const char *read_error = read_header(texture_fp, header_num, width, height, &max_val);
+
+    if(read_error != NULL){
+
+        fclose(texture_fp);
+
+        return set_error(error, RT_ERROR_PARSE, "Texture %s: %s", filename, read_error);
+    }
+
+    int length = *width * *height * 3;
+
+    uint8_t *new_pixmap = malloc(sizeof(uint8_t) * length);
+
+    if(new_pixmap == NULL){
+
+        fclose(texture_fp);
+
+        return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for texture %s has failed!", filename);
+    }
+
+    if(strcmp(header_num, "P3") == 0) {
+
+        read_error = read_p3(texture_fp, new_pixmap, length);
+
+    } else {
+
+        read_error = read_p6(texture_fp, new_pixmap, length);
+    }
+
+    fclose(texture_fp);
+
+    if(read_error != NULL){
+
+        free(new_pixmap);
+
+        return set_error(error, RT_ERROR_PARSE, "Texture %s: %s", filename, read_error);
+    }
+
+    *pixmap = new_pixmap;
+
+    return RT_OK;
+}
+
+// Reads the pixmap of every texture listed by get_objects(), through the
+// scene's texture cache when it has one, or opens it in the scene's pager.
+rt_status load_textures(scene *current_scene, trace_buffer *trace, rt_error *error) {
+
+    for(int texture_index = 0; texture_index < current_scene->num_textures; texture_index++){
+
+        texture *new_texture = &current_scene->texture_list[texture_index];
+
+        // Procedural textures have nothing to load.
+        if(new_texture->procedural.kind != NoPattern){
+
+            continue;
+        }
+
+        double load_start = stats_now_ms();
+
+        rt_status status;
+
+        if(current_scene->texture_pager != NULL){
+
+            status = texture_pager_open(current_scene->texture_pager, new_texture->filename,
+                                        &new_texture->width, &new_texture->height, &new_texture->paged, error);
+
+        } else if(current_scene->texture_cache != NULL){
+
+            status = texture_cache_acquire(current_scene->texture_cache, new_texture->filename,
+                                           &new_texture->width, &new_texture->height,
+                                           &new_texture->pixmap, error);
+
+        } else {
+
+            status = read_texture(new_texture->filename, &new_texture->width, &new_texture->height,
+                                  &new_texture->pixmap, error);
+        }
+
+        if(status != RT_OK){
+
+            return status;
+        }
+
+        char file[TRACE_ARGS_SIZE];
+        trace_escape(file, sizeof(file), new_texture->filename);
+
+        trace_event_end(trace, "texture_load", load_start, "\"file\": \"%s\", \"width\": %d, "
+                        "\"height\": %d", file, new_texture->width, new_texture->height);
+    }
+
+    return RT_OK;
+}
+
+// Reads the triangles of every mesh listed by get_objects().
+rt_status load_meshes(scene *current_scene, trace_buffer *trace, rt_error *error) {
+
+    for(int mesh_index = 0; mesh_index < current_scene->num_meshes; mesh_index++){
+
+        triangle_mesh *new_mesh = &current_scene->mesh_list[mesh_index];
+
+        double load_start = stats_now_ms();
+
+        rt_status status = read_mesh(new_mesh->filename, new_mesh, error);
+
+        if(status != RT_OK){
+
+            return status;
+        }
+
+        char file[TRACE_ARGS_SIZE];
+        trace_escape(file, sizeof(file), new_mesh->filename);
+
+        trace_event_end(trace, "mesh_load", load_start, "\"file\": \"%s\", \"vertices\": %d, "
+                        "\"triangles\": %d", file, new_mesh->num_vertices, new_mesh->num_triangles);
+    }
+
+    return RT_OK;
+}
+
+void free_scene(scene *current_scene) {
+
+    for(int texture_index = 0; texture_index < current_scene->num_textures; texture_index++){
+
+        texture *iter_texture = &current_scene->texture_list[texture_index];
+
+        free(iter_texture->filename);
+
+        if(current_scene->texture_pager != NULL){
+
+            texture_pager_close(current_scene->texture_pager, iter_texture->paged);
+
+        } else if(current_scene->texture_cache != NULL && iter_texture->procedural.kind == NoPattern){
+
+            texture_cache_release(current_scene->texture_cache, iter_texture->pixmap);
+
+        } else {
+
+            free(iter_texture->pixmap);
+        }
+    }
+
+    for(int mesh_index = 0; mesh_index < current_scene->num_meshes; mesh_index++){
+
+        free(current_scene->mesh_list[mesh_index].filename);
+        free_mesh(&current_scene->mesh_list[mesh_index]);
+    }
+
+    free(current_scene->object_list);
+    free(current_scene->light_list);
+    free(current_scene->texture_list);
+    free(current_scene->material_list);
+    free(current_scene->mesh_list);
+}
+
+
+// The integer kernels square in double and round once at the end, so they
+// give the float pow() would for the exponents they are picked for.
+// Every kernel is a power_kernel, so the ones specialized for an exponent
+// ignore it.
+
+float power_zero(float base, float exponent){
+
+    (void) base;
+    (void) exponent;
+
+    return 1;
+}
+
+float power_one(float base, float exponent){
+
+    (void) exponent;
+
+    return base;
+}
+
+float power_two(float base, float exponent){
+
+    (void) exponent;
+
+    return (double) base * base;
+}
+
+float power_four(float base, float exponent){
+
+    (void) exponent;
+
+    double squared = (double) base * base;
+
+    return squared * squared;
+}
+
+float power_eight(float base, float exponent){
+
+    (void) exponent;
+
+    double squared = (double) base * base;
+    double fourth = squared * squared;
+
+    return fourth * fourth;
+}
+
+float power_sixteen(float base, float exponent){
+
+    (void) exponent;
+
+    double squared = (double) base * base;
+    double fourth = squared * squared;
+    double eighth = fourth * fourth;
+
+    return eighth * eighth;
+}
+
+float power_twenty(float base, float exponent){
+
+    (void) exponent;
+
+    double squared = (double) base * base;
+    double fourth = squared * squared;
+    double sixteenth = fourth * fourth;
+    sixteenth = sixteenth * sixteenth;
+
+    return sixteenth * fourth;
+}
+
+// Repeated squaring for the remaining non-negative integer exponents.
+float power_integer(float base, float exponent){
+
+    int remaining = (int) exponent;
+    double factor = base;
+    double result = 1;
+
+    while(remaining > 0){
+
+        if(remaining & 1){
+
+            result = result * factor;
+
+        }
+
+        factor = factor * factor;
+        remaining = remaining >> 1;
+    }
+
+    return result;
+}
+
+float power_generic(float base, float exponent){
+
+    return pow(base, exponent);
+}
+
+float power_fast(float base, float exponent){
+
+    return fast_powf(base, exponent);
+}
+
+int integer_power_exponent(float exponent){
+
+    // Past this the repeated squaring loop loses to pow().
+    if(exponent < 0 || exponent > 256 || exponent != floor(exponent)){
+
+        return -1;
+    }
+
+    return (int) exponent;
+}
+
+// Picks the cheapest kernel that computes x^exponent exactly as pow() would
+// for the exponents that show up in scene files.
+power_kernel select_power_kernel(float exponent){
+
+    // The kernels for these exponents all square the way power_integer()
+    // does, which is what lets shade kernels use integer_power_exponent().
+    switch(integer_power_exponent(exponent)){
+
+        case -1:
+            return power_generic;
+
+        case 0:
+            return power_zero;
+
+        case 1:
+            return power_one;
+
+        case 2:
+            return power_two;
+
+        case 4:
+            return power_four;
+
+        case 8:
+            return power_eight;
+
+        case 16:
+            return power_sixteen;
+
+        case 20:
+            return power_twenty;
+
+        default:
+            return power_integer;
+    }
+}
+
+power_kernel select_fast_power_kernel(float exponent){
+
+    power_kernel exact = select_power_kernel(exponent);
+
+    return exact == power_generic ? power_fast : exact;
+}
+
+// Precomputes the per-object, per-light and per-texture invariants so the
+// shading path only has to read them. Must run once after load_textures()
+// and load_meshes().
+void bake_scene(scene *current_scene){
+
+    object *object_list = current_scene->object_list;
+    light *light_list = current_scene->light_list;
+    texture *texture_list = current_scene->texture_list;
+    material *material_list = current_scene->material_list;
+
+    int num_objects = current_scene->num_objects;
+    int num_lights = current_scene->num_lights;
+    int num_textures = current_scene->num_textures;
+    int num_materials = current_scene->num_materials;
+
+    for(int material_index = 0; material_index < num_materials; material_index++){
+
+        material *iter_material = &material_list[material_index];
+
+        iter_material->specular_power = select_power_kernel(iter_material->shininess);
+        iter_material->specular_power_fast = select_fast_power_kernel(iter_material->shininess);
+        iter_material->specular_exponent = integer_power_exponent(iter_material->shininess);
+        iter_material->shade = select_shade_kernel();
+    }
+
+    for(int object_index = 0; object_index < num_objects; object_index++){
+
+        object *iter_object = &object_list[object_index];
+
+        if(iter_object->type == Sphere){
+
+            iter_object->sphere.radius_squared = iter_object->sphere.radius * iter_object->sphere.radius;
+            iter_object->sphere.inv_radius = 1 / iter_object->sphere.radius;
+
+        }
+
+        if(iter_object->type == Plane){
+
+            // The texture basis has always been built from the normal as written
+            // in the scene file, so take it before normalizing.
+            float vector_v[3] = {0, 1, 1};
+
+            v3_cross_product(iter_object->plane.texture_u, vector_v, iter_object->plane.normal);
+
+            iter_object->plane.texture_v[0] = vector_v[0];
+            iter_object->plane.texture_v[1] = vector_v[1];
+            iter_object->plane.texture_v[2] = vector_v[2];
+
+            v3_normalize(iter_object->plane.normal, iter_object->plane.normal);
+        }
+
+        if(iter_object->type == Mesh){
+
+            const triangle_mesh *data = &current_scene->mesh_list[iter_object->mesh.mesh_index];
+            const mesh_node *root = &data->nodes[0];
+
+            iter_object->mesh.data = data;
+            iter_object->mesh.inv_scale = 1 / iter_object->mesh.scale;
+
+            // A sphere around the root box, for culling.
+            float half_diagonal[3];
+
+            for(int axis = 0; axis < 3; axis++){
+
+                iter_object->mesh.bound_center[axis] = iter_object->center[axis] +
+                    iter_object->mesh.scale * (root->lo[axis] + root->hi[axis]) / 2;
+                half_diagonal[axis] = (root->hi[axis] - root->lo[axis]) / 2;
+            }
+
+            iter_object->mesh.bound_radius = iter_object->mesh.scale * v3_length(half_diagonal);
+        }
+    }
+
+    for(int light_index = 0; light_index < num_lights; light_index++){
+
+        light *iter_light = &light_list[light_index];
+
+        // Only spot lights use their direction, and it has to be a unit vector
+        // for the dot product in angular() to be compared against the cosine.
+        if(iter_light->theta != 0 && v3_length(iter_light->direction) != 0){
+
+            v3_normalize(iter_light->direction, iter_light->direction);
+        }
+
+        iter_light->angular_power = select_power_kernel(iter_light->angular_a0);
+        iter_light->angular_power_fast = select_fast_power_kernel(iter_light->angular_a0);
+    }
+
+    for(int texture_index = 0; texture_index < num_textures; texture_index++){
+
+        texture *iter_texture = &texture_list[texture_index];
+
+        iter_texture->inv_width = 1.0 / iter_texture->width;
+        iter_texture->inv_height = 1.0 / iter_texture->height;
+    }
+}
@@ -0,0 +1,208 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "v3math.h"
+#include "ppmrw.h"
+#include "trace.h"
+#include "rt.h"
+#include "mesh.h"
+#include "pattern.h"
+#include "shade.h"
+#include "texpage.h"
+
+extern const int MAX_SIZE;
+
+enum shape_type{Sphere, Plane, Mesh}; // 0 = sphere, 1 = plane, 2 = mesh
+
+// Surface properties shared by every object that references them.
+typedef struct {
+
+    int diffuse_color[3];
+    int specular_color[3];
+    float shininess;
+    float reflectivity;
+    int texture_index;
+
+    // Selected by bake_scene() from the shininess, for exact and fast math.
+    power_kernel specular_power;
+    power_kernel specular_power_fast;
+
+    // Baked by bake_scene(): the shininess if the power kernels square an
+    // integer exponent, else -1, and the kernel that shades lights on it.
+    int specular_exponent;
+    shade_kernel shade;
+
+} material;
+
+typedef struct {
+
+    enum shape_type type;
+    int material_index;
+    float center[3];
+
+    union {
+
+        struct {
+            float radius;
+
+            // Baked by bake_scene().
+            float radius_squared;
+            float inv_radius;
+        } sphere;
+
+        struct {
+            float normal[3];
+
+            // Texture basis, baked by bake_scene() from the unnormalized normal.
+            float texture_u[3];
+            float texture_v[3];
+        } plane;
+
+        // Placed at center and scaled uniformly by scale.
+        struct {
+            int mesh_index;
+            float scale;
+
+            // Baked by bake_scene(); the bounding sphere is in world space.
+            float inv_scale;
+            float bound_center[3];
+            float bound_radius;
+            const triangle_mesh *data;
+        } mesh;
+    };
+} object;
+
+typedef struct {
+
+    // theta of 0 = point light.
+    float theta;
+    float color[3];
+    float center[3];
+    float radial[3];
+
+    // Only for spot lights (theta != 0)
+    float angular_a0;
+    float direction[3];
+    float cosine;
+
+    // Selected by bake_scene() from angular_a0, for exact and fast math.
+    power_kernel angular_power;
+    power_kernel angular_power_fast;
+    
+} light;
+
+typedef struct {
+
+    // For a procedural texture the filename is its text in the scene, and
+    // there is no pixmap. A texture loaded through a pager has paged
+    // instead of a pixmap.
+    char *filename;
+    int width;
+    int height;
+    uint8_t *pixmap;
+    paged_texture *paged;
+
+    // NoPattern for an image texture.
+    pattern procedural;
+
+    // Baked by bake_scene().
+    float inv_width;
+    float inv_height;
+
+} texture;
+
+
+// Everything read from a scene file. Each list is sized by its num_ count and
+// has room for its _capacity.
+typedef struct {
+
+    float camera_width;
+    float camera_height;
+
+    object *object_list;
+    light *light_list;
+    texture *texture_list;
+    material *material_list;
+    triangle_mesh *mesh_list;
+
+    int num_objects;
+    int num_lights;
+    int num_textures;
+    int num_materials;
+    int num_meshes;
+
+    int object_capacity;
+    int light_capacity;
+    int texture_capacity;
+    int material_capacity;
+    int mesh_capacity;
+
+    // When set, texture pixmaps are borrowed from it instead of owned.
+    rt_texture_cache *texture_cache;
+
+    // When set, image textures are paged through it instead, and
+    // texture_cache is not used.
+    rt_texture_pager *texture_pager;
+
+} scene;
+
+// Records status and a printf-style message in error, which may be NULL,
+// and returns status.
+rt_status set_error(rt_error *error, rt_status status, const char *format, ...);
+
+// Doubles *capacity when *list is full, moving *list if needed. Returns
+// false, leaving the list as it was, if memory runs out.
+bool grow_list(void **list, int count, int *capacity, size_t element_size);
+
+// Gets the camera width and height and stores them in the provided pointers,
+// leaving fp at the first object in the list.
+rt_status get_camera(FILE *fp, float *camera_width, float *camera_height, rt_error *error);
+
+// Fills current_scene with the objects, lights, materials and texture
+// filenames listed after the camera. The lists grow as needed. On failure
+// whatever was read so far is left for free_scene().
+rt_status get_objects(FILE *fp, scene *current_scene, rt_error *error);
+
+// Scene text is only split between threads in parts of at least this much.
+#define PARSE_PART_MIN_BYTES (1 << 20)
+
+// Same as get_objects() for the entries in text, the rest of a scene file
+// after the camera, on up to num_threads threads. The text is split at
+// lines that start an entry, each part is parsed into lists of its own, and
+// the lists are joined in file order, so every index is the one
+// get_objects() would give.
+rt_status get_objects_parallel(const char *text, size_t length, scene *current_scene, int num_threads,
+                               rt_error *error);
+
+// Reads the P3 or P6 image in filename into a new pixmap.
+rt_status read_texture(const char *filename, int *width, int *height, uint8_t **pixmap,
+                       rt_error *error);
+
+// Reads the pixmap of every texture listed by get_objects(), through
+// texture_cache if the scene has one, or opens it in texture_pager. trace
+// may be NULL; otherwise each texture load is recorded in it.
+rt_status load_textures(scene *current_scene, trace_buffer *trace, rt_error *error);
+
+// Reads every mesh file listed by get_objects(). trace may be NULL;
+// otherwise each mesh load is recorded in it.
+rt_status load_meshes(scene *current_scene, trace_buffer *trace, rt_error *error);
+
+// Frees the lists of a scene filled in by get_objects(), including one that
+// failed part way.
+void free_scene(scene *current_scene);
+
+power_kernel select_power_kernel(float exponent);
+
+// Same as select_power_kernel(), but exponents that would need pow() get
+// fast_powf() instead.
+power_kernel select_fast_power_kernel(float exponent);
+
+// exponent, if select_power_kernel() picks repeated squaring of it, else -1.
+int integer_power_exponent(float exponent);
+
+// Precomputes the per-object, per-light and per-texture invariants so the
+// shading path only has to read them. Must run once after load_textures()
+// and load_meshes().
+void bake_scene(scene *current_scene);
+
+#endif
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "ppmrw.h"
+
+// Writes procedural .scene files for scaling benchmarks: N spheres and
+// planes, M point and spot lights and T generated textures, all placed with
+// a fixed-seed generator so the same options always produce the same scene.
+
+typedef struct {
+
+    int spheres;
+    int planes;
+    int point_lights;
+    int spot_lights;
+    int textures;
+    int texture_size;
+    float reflectivity;
+    uint32_t seed;
+    char *output_file;
+
+} scenegen_options;
+
+
+void scenegen_fail(char *s) {
+
+    printf("Error: %s\n\n", s);
+    printf("Usage:\n");
+    printf("scenegen [--spheres N] [--planes N] [--point-lights M] [--spot-lights M]\n");
+    printf("         [--textures T] [--texture-size PIXELS] [--reflectivity MAX]\n");
+    printf("         [--seed S] OUTPUT.scene\n\n");
+    exit(1);
+}
+
+uint32_t scenegen_seed;
+
+// xorshift32 in [min, max).
+float scenegen_random(float min, float max){
+
+    scenegen_seed ^= scenegen_seed << 13;
+    scenegen_seed ^= scenegen_seed >> 17;
+    scenegen_seed ^= scenegen_seed << 5;
+
+    return min + (max - min) * (scenegen_seed / 4294967296.0f);
+}
+
+// Writes texture texture_index as a P6 file: alternating checkers and
+// gradients so sampled colors vary across the surface.
+void write_texture(char *filename, int texture_index, int size){
+
+    uint8_t *pixmap = malloc(size * size * 3);
+
+    if(pixmap == NULL){
+
+        scenegen_fail("Memory allocation for a texture has failed.");
+    }
+
+    uint8_t base[3] = {scenegen_random(64, 255), scenegen_random(64, 255), scenegen_random(64, 255)};
+
+    for(int row = 0; row < size; row++){
+
+        for(int col = 0; col < size; col++){
+
+            uint8_t *texel = &pixmap[(row * size + col) * 3];
+
+            if(texture_index % 2 == 0){
+
+                int checker = ((row / 16) + (col / 16)) % 2;
+
+                texel[0] = checker ? base[0] : base[0] / 4;
+                texel[1] = checker ? base[1] : base[1] / 4;
+                texel[2] = checker ? base[2] : base[2] / 4;
+
+            } else {
+
+                texel[0] = base[0] * row / size;
+                texel[1] = base[1] * col / size;
+                texel[2] = base[2];
+            }
+        }
+    }
+
+    FILE *fp = fopen(filename, "w");
+
+    if(fp == NULL){
+
+        scenegen_fail("Could not open a texture file for writing.");
+    }
+
+    write_p6(fp, pixmap, size, size, 255);
+
+    fclose(fp);
+    free(pixmap);
+}
+
+// Textures are numbered after the output file: out.scene -> out_tex0.ppm.
+void texture_filename(char *dst, size_t length, char *output_file, int texture_index){
+
+    int stem = strlen(output_file) - strlen(".scene");
+
+    snprintf(dst, length, "%.*s_tex%d.ppm", stem, output_file, texture_index);
+}
+
+void write_material(FILE *fp, scenegen_options *options, int object_index){
+
+    fprintf(fp, ", diffuse_color: [%.3f, %.3f, %.3f]", scenegen_random(0.1, 1),
+            scenegen_random(0.1, 1), scenegen_random(0.1, 1));
+
+    fprintf(fp, ", specular_color: [%.3f, %.3f, %.3f]", scenegen_random(0, 1),
+            scenegen_random(0, 1), scenegen_random(0, 1));
+
+    fprintf(fp, ", reflectivity: %.3f", scenegen_random(0, options->reflectivity));
+
+    // Every other object is textured, cycling through the generated textures.
+    if(options->textures > 0 && object_index % 2 == 0){
+
+        char filename[1024];
+        texture_filename(filename, sizeof(filename), options->output_file,
+                         (object_index / 2) % options->textures);
+
+        fprintf(fp, ", texture: %s", filename);
+    }
+}
+
+int main(int argc, char *argv[]){
+
+    scenegen_options options = {64, 1, 4, 0, 0, 256, 0.5, 1, NULL};
+
+    for(int arg = 1; arg < argc; arg++){
+
+        // Every option takes one value.
+        if(strncmp(argv[arg], "--", 2) == 0 && arg + 1 >= argc){
+
+            scenegen_fail("Missing option value.");
+        }
+
+        if(strcmp(argv[arg], "--spheres") == 0){
+
+            options.spheres = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--planes") == 0){
+
+            options.planes = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--point-lights") == 0){
+
+            options.point_lights = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--spot-lights") == 0){
+
+            options.spot_lights = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--textures") == 0){
+
+            options.textures = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--texture-size") == 0){
+
+            options.texture_size = atoi(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--reflectivity") == 0){
+
+            options.reflectivity = atof(argv[++arg]);
+
+        } else if(strcmp(argv[arg], "--seed") == 0){
+
+            options.seed = strtoul(argv[++arg], NULL, 10);
+
+        } else if(options.output_file == NULL){
+
+            options.output_file = argv[arg];
+
+        } else {
+
+            scenegen_fail("Unknown argument.");
+        }
+    }
+
+    if(options.output_file == NULL || strlen(options.output_file) < 6 ||
+       strcmp(&options.output_file[strlen(options.output_file) - 6], ".scene") != 0){
+
+        scenegen_fail("Bad output argument.");
+    }
+
+    // xorshift never leaves 0, so nudge a zero seed.
+    scenegen_seed = options.seed == 0 ? 1 : options.seed;
+
+    for(int texture_index = 0; texture_index < options.textures; texture_index++){
+
+        char filename[1024];
+        texture_filename(filename, sizeof(filename), options.output_file, texture_index);
+
+        write_texture(filename, texture_index, options.texture_size);
+    }
+
+    FILE *fp = fopen(options.output_file, "w");
+
+    if(fp == NULL){
+
+        scenegen_fail("Could not open the output file.");
+    }
+
+    // A square view plane one unit in front of the camera, so the visible
+    // half-width at depth z is 1.5 * |z|.
+    fprintf(fp, "camera, width: 3.0, height: 3.0\n");
+
+    int object_index = 0;
+
+    for(int sphere = 0; sphere < options.spheres; sphere++){
+
+        float z = scenegen_random(-40, -4);
+        float spread = 1.5 * -z;
+
+        fprintf(fp, "sphere, radius: %.3f, position: [%.3f, %.3f, %.3f]", scenegen_random(0.2, 1.5),
+                scenegen_random(-spread, spread), scenegen_random(-spread, spread), z);
+
+        write_material(fp, &options, object_index++);
+
+        fprintf(fp, "\n");
+    }
+
+    for(int plane = 0; plane < options.planes; plane++){
+
+        // The first plane is the floor; the rest are tilted walls further back.
+        if(plane == 0){
+
+            fprintf(fp, "plane, normal: [0, 1, 0], position: [0, -3, 0]");
+
+        } else {
+
+            fprintf(fp, "plane, normal: [%.3f, %.3f, 1], position: [0, 0, %.3f]",
+                    scenegen_random(-0.5, 0.5), scenegen_random(-0.5, 0.5), scenegen_random(-80, -45));
+        }
+
+        write_material(fp, &options, object_index++);
+
+        fprintf(fp, "\n");
+    }
+
+    for(int light = 0; light < options.point_lights + options.spot_lights; light++){
+
+        float position[3] = {scenegen_random(-20, 20), scenegen_random(2, 20), scenegen_random(-30, 2)};
+
+        fprintf(fp, "light, color: [%.3f, %.3f, %.3f]", scenegen_random(0.5, 2),
+                scenegen_random(0.5, 2), scenegen_random(0.5, 2));
+
+        fprintf(fp, ", radial-a2: 0.01, radial-a1: 0.05, radial-a0: 0.5");
+        fprintf(fp, ", position: [%.3f, %.3f, %.3f]", position[0], position[1], position[2]);
+
+        if(light < options.point_lights){
+
+            fprintf(fp, ", theta: 0");
+
+        } else {
+
+            // Aim spot lights at a random point in the middle of the scene.
+            float target[3] = {scenegen_random(-5, 5), -3, scenegen_random(-25, -5)};
+
+            fprintf(fp, ", theta: %.1f, angular-a0: %.1f, direction: [%.3f, %.3f, %.3f]",
+                    scenegen_random(15, 60), scenegen_random(1, 8), target[0] - position[0],
+                    target[1] - position[1], target[2] - position[2]);
+        }
+
+        fprintf(fp, "\n");
+    }
+
+    fclose(fp);
+
+    return 0;
+}
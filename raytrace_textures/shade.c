@@ -0,0 +1,209 @@
+#include <math.h>
+
+#include "shade.h"
+#include "render.h"
+#include "fastmath.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHADE_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+void shade_lights(const light_batch *batch, const shade_surface *surface, float *I){
+
+    float view[3] = {surface->view[0], surface->view[1], surface->view[2]};
+
+    for(int lane = 0; lane < batch->count; lane++){
+
+        float v_obj[3] = {batch->direction[0][lane], batch->direction[1][lane], batch->direction[2][lane]};
+        float normal[3] = {surface->normal[0], surface->normal[1], surface->normal[2]};
+
+        if(surface->sphere){
+
+            float center[3] = {surface->center[0], surface->center[1], surface->center[2]};
+
+            v3_from_points(normal, center, v_obj);
+            v3_normalize(normal, normal);
+        }
+
+        float L[3] = {v_obj[0], v_obj[1], v_obj[2]};
+
+        v3_scale(L, -1);
+
+        float n_dot_L = v3_dot_product(normal, L);
+
+        float R[3];
+
+        v3_reflect_unit(R, L, normal);
+
+        float R_dot_V = surface->specular_power(v3_dot_product(R, view), surface->shininess);
+
+        float f_rad = radial(batch->radial[2][lane], batch->radial[1][lane], batch->radial[0][lane],
+                             batch->distance[lane]);
+
+        for(int channel = 0; channel < 3; channel++){
+
+            float color = batch->color[channel][lane];
+
+            float diffuse = surface->diffuse[channel] * (color * n_dot_L);
+            float specular = surface->specular[channel] * (color * R_dot_V);
+
+            I[channel] = I[channel] + (diffuse + specular) * f_rad * batch->angular[lane];
+        }
+    }
+}
+
+#ifdef SHADE_AVX2
+
+// Every step matches shade_lights() operation for operation, with no fused
+// multiply-adds, so the two give the same bits.
+__attribute__((target("avx2")))
+void shade_lights_avx2(const light_batch *batch, const shade_surface *surface, float *I){
+
+    __m256 dx = _mm256_loadu_ps(batch->direction[0]);
+    __m256 dy = _mm256_loadu_ps(batch->direction[1]);
+    __m256 dz = _mm256_loadu_ps(batch->direction[2]);
+
+    __m256 nx, ny, nz;
+
+    if(surface->sphere){
+
+        nx = _mm256_sub_ps(dx, _mm256_set1_ps(surface->center[0]));
+        ny = _mm256_sub_ps(dy, _mm256_set1_ps(surface->center[1]));
+        nz = _mm256_sub_ps(dz, _mm256_set1_ps(surface->center[2]));
+
+        // vec3_normalize(): the estimate of 1 / sqrt and one Newton step.
+        __m256 length_squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)),
+                                              _mm256_mul_ps(nz, nz));
+        __m256 y = _mm256_rsqrt_ps(length_squared);
+
+        y = _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(
+                          _mm256_mul_ps(_mm256_set1_ps(0.5f), length_squared), y), y)));
+
+        nx = _mm256_mul_ps(nx, y);
+        ny = _mm256_mul_ps(ny, y);
+        nz = _mm256_mul_ps(nz, y);
+
+    } else {
+
+        nx = _mm256_set1_ps(surface->normal[0]);
+        ny = _mm256_set1_ps(surface->normal[1]);
+        nz = _mm256_set1_ps(surface->normal[2]);
+    }
+
+    __m256 minus_one = _mm256_set1_ps(-1);
+
+    __m256 lx = _mm256_mul_ps(dx, minus_one);
+    __m256 ly = _mm256_mul_ps(dy, minus_one);
+    __m256 lz = _mm256_mul_ps(dz, minus_one);
+
+    __m256 n_dot_l = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, lx), _mm256_mul_ps(ny, ly)),
+                                   _mm256_mul_ps(nz, lz));
+
+    // vec3_reflect(): n * (-2 * n.L) + L.
+    __m256 scale = _mm256_mul_ps(_mm256_set1_ps(-2), n_dot_l);
+
+    __m256 rx = _mm256_add_ps(_mm256_mul_ps(nx, scale), lx);
+    __m256 ry = _mm256_add_ps(_mm256_mul_ps(ny, scale), ly);
+    __m256 rz = _mm256_add_ps(_mm256_mul_ps(nz, scale), lz);
+
+    __m256 r_dot_v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, _mm256_set1_ps(surface->view[0])),
+                                                 _mm256_mul_ps(ry, _mm256_set1_ps(surface->view[1]))),
+                                   _mm256_mul_ps(rz, _mm256_set1_ps(surface->view[2])));
+
+    __m256 specular_power;
+
+    if(surface->specular_exponent >= 0){
+
+        // power_integer(), all lanes at once, in double as it squares.
+        __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(r_dot_v));
+        __m256d high = _mm256_cvtps_pd(_mm256_extractf128_ps(r_dot_v, 1));
+        __m256d low_power = _mm256_set1_pd(1);
+        __m256d high_power = _mm256_set1_pd(1);
+        int remaining = surface->specular_exponent;
+
+        while(remaining > 0){
+
+            if(remaining & 1){
+
+                low_power = _mm256_mul_pd(low_power, low);
+                high_power = _mm256_mul_pd(high_power, high);
+            }
+
+            low = _mm256_mul_pd(low, low);
+            high = _mm256_mul_pd(high, high);
+            remaining = remaining >> 1;
+        }
+
+        specular_power = _mm256_set_m128(_mm256_cvtpd_ps(high_power), _mm256_cvtpd_ps(low_power));
+
+    } else if(surface->specular_fast){
+
+        specular_power = fast_powf_avx2(r_dot_v, _mm256_set1_ps(surface->shininess));
+
+    } else {
+
+        float lanes[SHADE_BATCH];
+        _mm256_storeu_ps(lanes, r_dot_v);
+
+        for(int lane = 0; lane < batch->count; lane++){
+
+            lanes[lane] = surface->specular_power(lanes[lane], surface->shininess);
+        }
+
+        specular_power = _mm256_loadu_ps(lanes);
+    }
+
+    // radial(): 0 where rad is 0, else 1 at infinite distance, else
+    // 1 / rad.
+    __m256 distance = _mm256_loadu_ps(batch->distance);
+    __m256 rad = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(batch->radial[2]),
+                                                           _mm256_mul_ps(distance, distance)),
+                                             _mm256_mul_ps(_mm256_loadu_ps(batch->radial[1]), distance)),
+                               _mm256_loadu_ps(batch->radial[0]));
+
+    __m256 f_rad = _mm256_div_ps(_mm256_set1_ps(1), rad);
+
+    f_rad = _mm256_blendv_ps(f_rad, _mm256_set1_ps(1),
+                             _mm256_cmp_ps(distance, _mm256_set1_ps(INFINITY), _CMP_EQ_OQ));
+    f_rad = _mm256_blendv_ps(f_rad, _mm256_setzero_ps(), _mm256_cmp_ps(rad, _mm256_setzero_ps(), _CMP_EQ_OQ));
+
+    __m256 falloff_angular = _mm256_loadu_ps(batch->angular);
+
+    float added[3][SHADE_BATCH];
+
+    for(int channel = 0; channel < 3; channel++){
+
+        __m256 color = _mm256_loadu_ps(batch->color[channel]);
+
+        __m256 diffuse = _mm256_mul_ps(_mm256_set1_ps(surface->diffuse[channel]), _mm256_mul_ps(color, n_dot_l));
+        __m256 specular = _mm256_mul_ps(_mm256_set1_ps(surface->specular[channel]),
+                                        _mm256_mul_ps(color, specular_power));
+
+        _mm256_storeu_ps(added[channel], _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(diffuse, specular), f_rad),
+                                                       falloff_angular));
+    }
+
+    // Summed one light at a time, in order, as shade_lights() does.
+    for(int lane = 0; lane < batch->count; lane++){
+
+        I[0] = I[0] + added[0][lane];
+        I[1] = I[1] + added[1][lane];
+        I[2] = I[2] + added[2][lane];
+    }
+}
+
+#endif
+
+shade_kernel select_shade_kernel(){
+
+#ifdef SHADE_AVX2
+    if(__builtin_cpu_supports("avx2")){
+
+        return shade_lights_avx2;
+    }
+#endif
+
+    return shade_lights;
+}
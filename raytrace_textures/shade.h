@@ -0,0 +1,78 @@
+#ifndef SHADE_H
+#define SHADE_H
+
+#include <stdbool.h>
+
+// Shading of a point by the lights that reach it, several lights at a time.
+// apply_lights() casts the shadow rays one light at a time and gathers the
+// lights that pass into a light_batch; once it is full, or the lights run
+// out, the batch is handed to the material's shade_kernel. The kernels
+// give exactly the result shading one light at a time would, lights added
+// in batch order.
+
+// Lights shaded per kernel call; one AVX register of floats.
+#define SHADE_BATCH 8
+
+// Computes base^exponent; specialized for the exponent it was selected for.
+typedef float (*power_kernel)(float base, float exponent);
+
+// Lights to shade, one array per field, so a kernel loads a field of every
+// light in the batch at once.
+typedef struct {
+
+    int count;
+
+    // Unit vector from each light to the point, and the distance between.
+    float direction[3][SHADE_BATCH];
+    float distance[SHADE_BATCH];
+
+    // Spot falloff at the point; 1 for point lights.
+    float angular[SHADE_BATCH];
+
+    float color[3][SHADE_BATCH];
+
+    // a0, a1, a2 of the radial falloff.
+    float radial[3][SHADE_BATCH];
+
+} light_batch;
+
+// The point being shaded, the same for every light.
+typedef struct {
+
+    // Spheres take their normal from the light direction and the center;
+    // everything else uses normal.
+    bool sphere;
+    float center[3];
+    float normal[3];
+
+    // Back along the ray that found the point.
+    float view[3];
+
+    // Diffuse color or texel, and specular color, 0 to 255 per channel.
+    float diffuse[3];
+    float specular[3];
+
+    float shininess;
+    power_kernel specular_power;
+
+    // shininess when specular_power is the repeated squaring of an integer
+    // exponent, which kernels may then do themselves; -1 otherwise.
+    int specular_exponent;
+
+    // Whether specular_power is fast_powf(), which kernels may also do
+    // themselves.
+    bool specular_fast;
+
+} shade_surface;
+
+// Adds the light of every light in batch on surface to I.
+typedef void (*shade_kernel)(const light_batch *batch, const shade_surface *surface, float *I);
+
+// One light at a time, in plain float arithmetic.
+void shade_lights(const light_batch *batch, const shade_surface *surface, float *I);
+
+// The fastest kernel the CPU running this supports: eight lights at a time
+// with AVX2 where there is AVX2, shade_lights() everywhere else.
+shade_kernel select_shade_kernel();
+
+#endif
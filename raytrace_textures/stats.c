@@ -0,0 +1,73 @@
+#include <time.h>
+
+#include "stats.h"
+
+double stats_now_ms(){
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+void render_stats_merge(render_stats *dst, render_stats *src){
+
+    dst->primary_rays += src->primary_rays;
+    dst->reflection_rays += src->reflection_rays;
+    dst->shadow_rays += src->shadow_rays;
+
+    dst->sphere_tests += src->sphere_tests;
+    dst->plane_tests += src->plane_tests;
+    dst->triangle_tests += src->triangle_tests;
+
+    dst->texture_samples += src->texture_samples;
+
+    dst->shadow_cache_hits += src->shadow_cache_hits;
+    dst->shadow_cache_misses += src->shadow_cache_misses;
+
+    dst->culled_lights += src->culled_lights;
+
+    if(src->max_depth > dst->max_depth){
+
+        dst->max_depth = src->max_depth;
+    }
+}
+
+void write_stats_json(FILE *fp, render_stats *stats, phase_times *times, int width, int height,
+                      int num_threads){
+
+    long total_rays = stats->primary_rays + stats->reflection_rays + stats->shadow_rays;
+    long shadow_lookups = stats->shadow_cache_hits + stats->shadow_cache_misses;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"width\": %d,\n", width);
+    fprintf(fp, "  \"height\": %d,\n", height);
+    fprintf(fp, "  \"threads\": %d,\n", num_threads);
+    fprintf(fp, "  \"rays\": {\n");
+    fprintf(fp, "    \"primary\": %ld,\n", stats->primary_rays);
+    fprintf(fp, "    \"reflection\": %ld,\n", stats->reflection_rays);
+    fprintf(fp, "    \"shadow\": %ld,\n", stats->shadow_rays);
+    fprintf(fp, "    \"total\": %ld\n", total_rays);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"intersection_tests\": {\n");
+    fprintf(fp, "    \"sphere\": %ld,\n", stats->sphere_tests);
+    fprintf(fp, "    \"plane\": %ld,\n", stats->plane_tests);
+    fprintf(fp, "    \"triangle\": %ld\n", stats->triangle_tests);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"texture_samples\": %ld,\n", stats->texture_samples);
+    fprintf(fp, "  \"shadow_cache\": {\n");
+    fprintf(fp, "    \"hits\": %ld,\n", stats->shadow_cache_hits);
+    fprintf(fp, "    \"misses\": %ld,\n", stats->shadow_cache_misses);
+    fprintf(fp, "    \"hit_rate\": %.3f\n", shadow_lookups > 0 ? (double) stats->shadow_cache_hits / shadow_lookups : 0);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"culled_lights\": %ld,\n", stats->culled_lights);
+    fprintf(fp, "  \"max_depth\": %d,\n", stats->max_depth);
+    fprintf(fp, "  \"time_ms\": {\n");
+    fprintf(fp, "    \"parse\": %.3f,\n", times->parse_ms);
+    fprintf(fp, "    \"texture_load\": %.3f,\n", times->texture_load_ms);
+    fprintf(fp, "    \"render\": %.3f,\n", times->render_ms);
+    fprintf(fp, "    \"encode\": %.3f\n", times->encode_ms);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"rays_per_sec\": %.1f\n", times->render_ms > 0 ? total_rays / (times->render_ms / 1e3) : 0);
+    fprintf(fp, "}\n");
+}
@@ -0,0 +1,53 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+// Counters for one render worker. Each worker owns its own copy and only
+// increments plain fields; render_stats_merge() combines them at the end.
+typedef struct {
+
+    long primary_rays;
+    long reflection_rays;
+    long shadow_rays;
+
+    // Ray-object intersection tests by shape type.
+    long sphere_tests;
+    long plane_tests;
+    long triangle_tests;
+
+    long texture_samples;
+
+    // Shadow rays settled by the per-light last occluder, and ones where
+    // it didn't block and every object was tested.
+    long shadow_cache_hits;
+    long shadow_cache_misses;
+
+    // Light evaluations skipped because the light couldn't reach the hit.
+    long culled_lights;
+
+    // Deepest reflection level reached; primary hits are level 0.
+    int max_depth;
+
+} render_stats;
+
+// Wall time of each phase of a run, in milliseconds.
+typedef struct {
+
+    double parse_ms;
+    double texture_load_ms;
+    double render_ms;
+    double encode_ms;
+
+} phase_times;
+
+// Milliseconds on a monotonic clock, for timing phases.
+double stats_now_ms();
+
+// Adds the counters in src to dst.
+void render_stats_merge(render_stats *dst, render_stats *src);
+
+void write_stats_json(FILE *fp, render_stats *stats, phase_times *times, int width, int height,
+                      int num_threads);
+
+#endif
@@ -0,0 +1,278 @@
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "texcache.h"
+#include "scene.h"
+
+typedef struct {
+
+    char *filename;
+    time_t mtime;
+    off_t size;
+
+    int width;
+    int height;
+    uint8_t *pixmap;
+
+    // Scenes currently holding the pixmap; only unused entries are evicted.
+    int refs;
+    uint64_t last_used;
+
+    // Set while the first scene to ask for the file is reading it.
+    bool loading;
+
+} cached_texture;
+
+struct rt_texture_cache {
+
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;
+
+    cached_texture *entries;
+    int num_entries;
+    int capacity;
+
+    size_t bytes;
+    size_t budget_bytes;
+
+    // Ticks on every use, ordering entries for eviction.
+    uint64_t clock;
+
+    long hits;
+    long misses;
+
+};
+
+
+rt_texture_cache *rt_texture_cache_create(size_t budget_bytes){
+
+    rt_texture_cache *cache = calloc(1, sizeof(rt_texture_cache));
+
+    if(cache == NULL){
+
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->loaded, NULL);
+    cache->budget_bytes = budget_bytes;
+
+    return cache;
+}
+
+void rt_texture_cache_free(rt_texture_cache *cache){
+
+    if(cache == NULL){
+
+        return;
+    }
+
+    for(int entry_index = 0; entry_index < cache->num_entries; entry_index++){
+
+        free(cache->entries[entry_index].filename);
+        free(cache->entries[entry_index].pixmap);
+    }
+
+    free(cache->entries);
+    pthread_mutex_destroy(&cache->lock);
+    pthread_cond_destroy(&cache->loaded);
+    free(cache);
+}
+
+void rt_texture_cache_get_stats(rt_texture_cache *cache, rt_texture_cache_stats *stats){
+
+    pthread_mutex_lock(&cache->lock);
+
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->num_textures = cache->num_entries;
+    stats->bytes = cache->bytes;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Drops unused entries, oldest first, until the cache fits its budget.
+// Called with the lock held.
+void texture_cache_evict(rt_texture_cache *cache){
+
+    while(cache->bytes > cache->budget_bytes){
+
+        int oldest = -1;
+
+        for(int entry_index = 0; entry_index < cache->num_entries; entry_index++){
+
+            cached_texture *entry = &cache->entries[entry_index];
+
+            if(entry->refs == 0 && !entry->loading && (oldest < 0 || entry->last_used < cache->entries[oldest].last_used)){
+
+                oldest = entry_index;
+            }
+        }
+
+        if(oldest < 0){
+
+            return;
+        }
+
+        cached_texture *entry = &cache->entries[oldest];
+
+        cache->bytes -= (size_t) entry->width * entry->height * 3;
+
+        free(entry->filename);
+        free(entry->pixmap);
+
+        cache->num_entries--;
+        *entry = cache->entries[cache->num_entries];
+    }
+}
+
+// Returns the entry for filename as it is on disk, or NULL. Called with the
+// lock held.
+cached_texture *texture_cache_find(rt_texture_cache *cache, const char *filename, struct stat *info){
+
+    for(int entry_index = 0; entry_index < cache->num_entries; entry_index++){
+
+        cached_texture *entry = &cache->entries[entry_index];
+
+        if(entry->mtime == info->st_mtime && entry->size == info->st_size &&
+           strcmp(entry->filename, filename) == 0){
+
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+rt_status texture_cache_acquire(rt_texture_cache *cache, const char *filename, int *width,
+                                int *height, uint8_t **pixmap, rt_error *error){
+
+    struct stat info;
+
+    if(stat(filename, &info) != 0){
+
+        return set_error(error, RT_ERROR_IO, "Could not open texture %s", filename);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    cached_texture *entry = texture_cache_find(cache, filename, &info);
+
+    // Jobs that start together wait for the first one to read the file
+    // rather than each reading their own copy.
+    while(entry != NULL && entry->loading){
+
+        pthread_cond_wait(&cache->loaded, &cache->lock);
+
+        entry = texture_cache_find(cache, filename, &info);
+    }
+
+    if(entry != NULL){
+
+        cache->hits++;
+
+    } else {
+
+        cache->misses++;
+
+        char *new_filename = strdup(filename);
+
+        if(new_filename == NULL || !grow_list((void **) &cache->entries, cache->num_entries,
+                                              &cache->capacity, sizeof(cached_texture))){
+
+            pthread_mutex_unlock(&cache->lock);
+
+            free(new_filename);
+
+            return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for texture %s has failed!",
+                             filename);
+        }
+
+        entry = &cache->entries[cache->num_entries];
+        cache->num_entries++;
+
+        memset(entry, 0, sizeof(cached_texture));
+
+        entry->filename = new_filename;
+        entry->mtime = info.st_mtime;
+        entry->size = info.st_size;
+        entry->loading = true;
+
+        // Read without the lock so jobs using other textures aren't held up.
+        pthread_mutex_unlock(&cache->lock);
+
+        int new_width;
+        int new_height;
+        uint8_t *new_pixmap;
+
+        rt_status status = read_texture(filename, &new_width, &new_height, &new_pixmap, error);
+
+        pthread_mutex_lock(&cache->lock);
+
+        // The list may have moved while unlocked.
+        entry = texture_cache_find(cache, filename, &info);
+
+        if(status != RT_OK){
+
+            free(entry->filename);
+
+            cache->num_entries--;
+            *entry = cache->entries[cache->num_entries];
+
+            pthread_cond_broadcast(&cache->loaded);
+            pthread_mutex_unlock(&cache->lock);
+
+            return status;
+        }
+
+        entry->width = new_width;
+        entry->height = new_height;
+        entry->pixmap = new_pixmap;
+        entry->loading = false;
+
+        cache->bytes += (size_t) new_width * new_height * 3;
+
+        pthread_cond_broadcast(&cache->loaded);
+    }
+
+    entry->refs++;
+    entry->last_used = ++cache->clock;
+
+    *width = entry->width;
+    *height = entry->height;
+    *pixmap = entry->pixmap;
+
+    // The entry is in use, so this only drops others.
+    texture_cache_evict(cache);
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return RT_OK;
+}
+
+void texture_cache_release(rt_texture_cache *cache, uint8_t *pixmap){
+
+    if(pixmap == NULL){
+
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+
+    for(int entry_index = 0; entry_index < cache->num_entries; entry_index++){
+
+        cached_texture *entry = &cache->entries[entry_index];
+
+        if(entry->pixmap == pixmap){
+
+            entry->refs--;
+            entry->last_used = ++cache->clock;
+
+            break;
+        }
+    }
+
+    texture_cache_evict(cache);
+
+    pthread_mutex_unlock(&cache->lock);
+}
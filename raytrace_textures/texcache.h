@@ -0,0 +1,21 @@
+#ifndef TEXCACHE_H
+#define TEXCACHE_H
+
+#include <stdint.h>
+
+#include "rt.h"
+
+// Texture pixmaps shared between scenes. Entries are keyed by filename,
+// modification time and size, so an edited file is read again, and are
+// reference counted by the scenes using them. Unused entries are evicted
+// least recently used first once the cache holds more than its budget.
+
+// Finds or reads filename and lends out its pixmap until
+// texture_cache_release().
+rt_status texture_cache_acquire(rt_texture_cache *cache, const char *filename, int *width,
+                                int *height, uint8_t **pixmap, rt_error *error);
+
+// Returns a pixmap from texture_cache_acquire(). NULL is ignored.
+void texture_cache_release(rt_texture_cache *cache, uint8_t *pixmap);
+
+#endif
@@ -0,0 +1,634 @@
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "texpage.h"
+#include "scene.h"
+
+// Tiles are spread over this many separately locked shards, so render
+// threads reading different tiles rarely wait on each other.
+#define PAGER_SHARDS 16
+
+#define TILE_BYTES (TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * 3)
+
+struct paged_texture {
+
+    rt_texture_pager *pager;
+
+    char *filename;
+    time_t mtime;
+    off_t size;
+
+    int width;
+    int height;
+    int tiles_across;
+
+    // Raw RGB rows of width * 3 bytes from data_offset on: the file itself
+    // for P6, the sidecar for P3.
+    FILE *source;
+    off_t data_offset;
+
+    // Offsets the shards of this texture's tiles from other textures'.
+    int id;
+
+    // Slot holding each tile in its shard, or -1. Guarded by the lock of
+    // the tile's shard.
+    int *tile_slots;
+
+    // Scenes using the texture. Guarded by the pager's lock.
+    int refs;
+
+};
+
+typedef struct {
+
+    // NULL while the slot is free.
+    paged_texture *owner;
+    int tile;
+
+    // Set on every use and cleared as the clock hand passes, so a tile is
+    // only evicted if it went unused for a whole sweep.
+    bool referenced;
+
+    // Set while a thread reads the tile in without the shard's lock. The
+    // slot can't be evicted, and threads that want the tile wait on the
+    // shard's tile_loaded.
+    bool loading;
+
+} tile_slot;
+
+typedef struct {
+
+    pthread_mutex_t lock;
+
+    // Signalled whenever a slot finishes loading.
+    pthread_cond_t tile_loaded;
+
+    tile_slot *slots;
+    uint8_t *texels;
+    int num_slots;
+    int hand;
+    int resident;
+
+    long hits;
+    long misses;
+    long evictions;
+    long read_errors;
+
+} pager_shard;
+
+struct rt_texture_pager {
+
+    // Guards the texture list and the refs of each texture.
+    pthread_mutex_t lock;
+
+    paged_texture **textures;
+    int num_textures;
+    int capacity;
+    int next_id;
+
+    pager_shard shards[PAGER_SHARDS];
+
+};
+
+
+rt_texture_pager *rt_texture_pager_create(size_t budget_bytes){
+
+    rt_texture_pager *pager = calloc(1, sizeof(rt_texture_pager));
+
+    if(pager == NULL){
+
+        return NULL;
+    }
+
+    pthread_mutex_init(&pager->lock, NULL);
+
+    // Every shard needs a slot to read a tile into, however small the budget.
+    size_t slots_per_shard = budget_bytes / TILE_BYTES / PAGER_SHARDS;
+
+    if(slots_per_shard < 1){
+
+        slots_per_shard = 1;
+    }
+
+    bool allocated = true;
+
+    for(int shard_index = 0; shard_index < PAGER_SHARDS; shard_index++){
+
+        pager_shard *shard = &pager->shards[shard_index];
+
+        pthread_mutex_init(&shard->lock, NULL);
+        pthread_cond_init(&shard->tile_loaded, NULL);
+
+        // Texels are only touched as tiles are read, so the budget isn't
+        // taken from the system up front.
+        shard->num_slots = slots_per_shard;
+        shard->slots = calloc(slots_per_shard, sizeof(tile_slot));
+        shard->texels = malloc(slots_per_shard * TILE_BYTES);
+
+        allocated = allocated && shard->slots != NULL && shard->texels != NULL;
+    }
+
+    if(!allocated){
+
+        rt_texture_pager_free(pager);
+
+        return NULL;
+    }
+
+    return pager;
+}
+
+// Closes the source of paged and frees it. Its tiles must already be gone.
+void free_paged_texture(paged_texture *paged){
+
+    if(paged->source != NULL){
+
+        fclose(paged->source);
+    }
+
+    free(paged->filename);
+    free(paged->tile_slots);
+    free(paged);
+}
+
+void rt_texture_pager_free(rt_texture_pager *pager){
+
+    if(pager == NULL){
+
+        return;
+    }
+
+    for(int texture_index = 0; texture_index < pager->num_textures; texture_index++){
+
+        free_paged_texture(pager->textures[texture_index]);
+    }
+
+    for(int shard_index = 0; shard_index < PAGER_SHARDS; shard_index++){
+
+        pthread_mutex_destroy(&pager->shards[shard_index].lock);
+        pthread_cond_destroy(&pager->shards[shard_index].tile_loaded);
+        free(pager->shards[shard_index].slots);
+        free(pager->shards[shard_index].texels);
+    }
+
+    free(pager->textures);
+    pthread_mutex_destroy(&pager->lock);
+    free(pager);
+}
+
+void rt_texture_pager_get_stats(rt_texture_pager *pager, rt_texture_pager_stats *stats){
+
+    memset(stats, 0, sizeof(rt_texture_pager_stats));
+
+    pthread_mutex_lock(&pager->lock);
+
+    stats->num_textures = pager->num_textures;
+
+    pthread_mutex_unlock(&pager->lock);
+
+    for(int shard_index = 0; shard_index < PAGER_SHARDS; shard_index++){
+
+        pager_shard *shard = &pager->shards[shard_index];
+
+        pthread_mutex_lock(&shard->lock);
+
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->read_errors += shard->read_errors;
+        stats->resident_bytes += (size_t) shard->resident * TILE_BYTES;
+        stats->budget_bytes += (size_t) shard->num_slots * TILE_BYTES;
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+// Copies the texels of the P3 image in fp, after its header, into a new
+// unnamed file of raw rows. Returns NULL with fp's problem in *read_error,
+// or NULL alone if the sidecar couldn't be written.
+FILE *write_sidecar(FILE *fp, int width, int height, const char **read_error){
+
+    FILE *sidecar = tmpfile();
+    uint8_t *row = malloc((size_t) width * 3);
+
+    *read_error = NULL;
+
+    if(sidecar == NULL || row == NULL){
+
+        free(row);
+
+        if(sidecar != NULL){
+
+            fclose(sidecar);
+        }
+
+        return NULL;
+    }
+
+    bool written = true;
+
+    for(int row_index = 0; row_index < height && written; row_index++){
+
+        *read_error = read_p3(fp, row, width * 3);
+
+        written = *read_error == NULL && fwrite(row, 3, width, sidecar) == (size_t) width;
+    }
+
+    free(row);
+
+    // Tiles are read with pread(), past the stdio buffer.
+    if(!written || fflush(sidecar) != 0){
+
+        fclose(sidecar);
+
+        return NULL;
+    }
+
+    return sidecar;
+}
+
+// Opens filename and finds where its raw rows start, converting a P3 file
+// to a sidecar first.
+rt_status open_texture_source(paged_texture *paged, struct stat *info, rt_error *error){
+
+    FILE *fp = fopen(paged->filename, "rb");
+
+    if(fp == NULL){
+
+        return set_error(error, RT_ERROR_IO, "Could not open texture %s", paged->filename);
+    }
+
+    char header_num[3];
+    int max_val = 0;
+
+    const char *read_error = read_header(fp, header_num, &paged->width, &paged->height, &max_val);
+
+    if(read_error != NULL){
+
+        fclose(fp);
+
+        return set_error(error, RT_ERROR_PARSE, "Texture %s: %s", paged->filename, read_error);
+    }
+
+    if(strcmp(header_num, "P3") == 0){
+
+        paged->source = write_sidecar(fp, paged->width, paged->height, &read_error);
+        paged->data_offset = 0;
+
+        fclose(fp);
+
+        if(read_error != NULL){
+
+            return set_error(error, RT_ERROR_PARSE, "Texture %s: %s", paged->filename, read_error);
+        }
+
+        if(paged->source == NULL){
+
+            return set_error(error, RT_ERROR_IO, "Could not write the sidecar of texture %s",
+                             paged->filename);
+        }
+
+        return RT_OK;
+    }
+
+    paged->source = fp;
+    paged->data_offset = ftell(fp);
+
+    // The same checks read_p6() makes, without reading the texels.
+    off_t length = paged->data_offset + (off_t) paged->width * paged->height * 3;
+
+    if(info->st_size < length){
+
+        return set_error(error, RT_ERROR_PARSE, "Texture %s: %s", paged->filename,
+                         "The provided input file did not have enough RGB channels.");
+    }
+
+    if(info->st_size > length){
+
+        return set_error(error, RT_ERROR_PARSE, "Texture %s: %s", paged->filename,
+                         "The provided input file had too many RGB channels.");
+    }
+
+    return RT_OK;
+}
+
+rt_status texture_pager_open(rt_texture_pager *pager, const char *filename, int *width, int *height,
+                             paged_texture **paged, rt_error *error){
+
+    struct stat info;
+
+    if(stat(filename, &info) != 0){
+
+        return set_error(error, RT_ERROR_IO, "Could not open texture %s", filename);
+    }
+
+    // Opening a P6 file only reads its header, so holding the lock through
+    // it is cheap; a P3 file holds up other opens while it is converted.
+    pthread_mutex_lock(&pager->lock);
+
+    for(int texture_index = 0; texture_index < pager->num_textures; texture_index++){
+
+        paged_texture *entry = pager->textures[texture_index];
+
+        if(entry->mtime == info.st_mtime && entry->size == info.st_size && strcmp(entry->filename, filename) == 0){
+
+            entry->refs++;
+
+            *width = entry->width;
+            *height = entry->height;
+            *paged = entry;
+
+            pthread_mutex_unlock(&pager->lock);
+
+            return RT_OK;
+        }
+    }
+
+    paged_texture *entry = calloc(1, sizeof(paged_texture));
+
+    if(entry == NULL || (entry->filename = strdup(filename)) == NULL ||
+       !grow_list((void **) &pager->textures, pager->num_textures, &pager->capacity, sizeof(paged_texture *))){
+
+        pthread_mutex_unlock(&pager->lock);
+
+        if(entry != NULL){
+
+            free_paged_texture(entry);
+        }
+
+        return set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for texture %s has failed!", filename);
+    }
+
+    entry->pager = pager;
+    entry->mtime = info.st_mtime;
+    entry->size = info.st_size;
+
+    rt_status status = open_texture_source(entry, &info, error);
+
+    int tiles_down = (entry->height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+
+    entry->tiles_across = (entry->width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+
+    if(status == RT_OK){
+
+        entry->tile_slots = malloc(sizeof(int) * entry->tiles_across * tiles_down);
+
+        if(entry->tile_slots == NULL){
+
+            status = set_error(error, RT_ERROR_NO_MEMORY, "Memory allocation for texture %s has failed!",
+                               filename);
+        }
+    }
+
+    if(status != RT_OK){
+
+        pthread_mutex_unlock(&pager->lock);
+
+        free_paged_texture(entry);
+
+        return status;
+    }
+
+    for(int tile = 0; tile < entry->tiles_across * tiles_down; tile++){
+
+        entry->tile_slots[tile] = -1;
+    }
+
+    entry->id = pager->next_id++;
+    entry->refs = 1;
+
+    pager->textures[pager->num_textures] = entry;
+    pager->num_textures++;
+
+    pthread_mutex_unlock(&pager->lock);
+
+    *width = entry->width;
+    *height = entry->height;
+    *paged = entry;
+
+    return RT_OK;
+}
+
+void texture_pager_close(rt_texture_pager *pager, paged_texture *paged){
+
+    if(paged == NULL){
+
+        return;
+    }
+
+    pthread_mutex_lock(&pager->lock);
+
+    paged->refs--;
+
+    if(paged->refs > 0){
+
+        pthread_mutex_unlock(&pager->lock);
+
+        return;
+    }
+
+    for(int texture_index = 0; texture_index < pager->num_textures; texture_index++){
+
+        if(pager->textures[texture_index] == paged){
+
+            pager->num_textures--;
+            pager->textures[texture_index] = pager->textures[pager->num_textures];
+
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&pager->lock);
+
+    // No scene can sample it any more, so its slots are simply freed.
+    for(int shard_index = 0; shard_index < PAGER_SHARDS; shard_index++){
+
+        pager_shard *shard = &pager->shards[shard_index];
+
+        pthread_mutex_lock(&shard->lock);
+
+        for(int slot = 0; slot < shard->num_slots; slot++){
+
+            if(shard->slots[slot].owner == paged){
+
+                shard->slots[slot].owner = NULL;
+                shard->resident--;
+            }
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    free_paged_texture(paged);
+}
+
+// Returns a slot for a new tile, evicting the first tile the clock hand
+// finds unreferenced if none is free, or -1 if every slot is loading.
+// Called with the shard's lock held.
+int take_slot(pager_shard *shard){
+
+    // Two sweeps: the first may only clear referenced bits.
+    for(int step = 0; step < 2 * shard->num_slots; step++){
+
+        int slot = shard->hand;
+        tile_slot *current = &shard->slots[slot];
+
+        shard->hand = (shard->hand + 1) % shard->num_slots;
+
+        if(current->owner == NULL){
+
+            shard->resident++;
+
+            return slot;
+        }
+
+        if(current->loading){
+
+            continue;
+        }
+
+        if(current->referenced){
+
+            current->referenced = false;
+
+            continue;
+        }
+
+        current->owner->tile_slots[current->tile] = -1;
+        shard->evictions++;
+
+        return slot;
+    }
+
+    return -1;
+}
+
+// Reads tile of paged into slot. A tile that can't be read is left black
+// and false is returned. Called without the shard's lock, with the slot
+// marked loading so nothing else touches its texels.
+bool read_tile(pager_shard *shard, paged_texture *paged, int tile, int slot){
+
+    uint8_t *texels = &shard->texels[(size_t) slot * TILE_BYTES];
+
+    int first_row = tile / paged->tiles_across * TEXTURE_TILE_SIZE;
+    int first_col = tile % paged->tiles_across * TEXTURE_TILE_SIZE;
+    int num_rows = paged->height - first_row < TEXTURE_TILE_SIZE ? paged->height - first_row : TEXTURE_TILE_SIZE;
+    int num_cols = paged->width - first_col < TEXTURE_TILE_SIZE ? paged->width - first_col : TEXTURE_TILE_SIZE;
+
+    for(int row = 0; row < num_rows; row++){
+
+        off_t offset = paged->data_offset + ((off_t) (first_row + row) * paged->width + first_col) * 3;
+        size_t length = (size_t) num_cols * 3;
+
+        if(pread(fileno(paged->source), &texels[row * TEXTURE_TILE_SIZE * 3], length, offset) != (ssize_t) length){
+
+            memset(texels, 0, TILE_BYTES);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void texture_pager_texel(paged_texture *paged, int row, int col, float *color){
+
+    int tile = row / TEXTURE_TILE_SIZE * paged->tiles_across + col / TEXTURE_TILE_SIZE;
+    pager_shard *shard = &paged->pager->shards[(unsigned) (tile + paged->id) % PAGER_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+
+    int slot = paged->tile_slots[tile];
+
+    // Another thread may be reading this tile, or every slot may be busy
+    // loading others; either way, wait for a load to finish and look again.
+    while((slot >= 0 && shard->slots[slot].loading) || (slot < 0 && (slot = take_slot(shard)) < 0)){
+
+        pthread_cond_wait(&shard->tile_loaded, &shard->lock);
+
+        slot = paged->tile_slots[tile];
+    }
+
+    if(paged->tile_slots[tile] == slot){
+
+        shard->hits++;
+
+    } else {
+
+        shard->misses++;
+
+        shard->slots[slot].owner = paged;
+        shard->slots[slot].tile = tile;
+        shard->slots[slot].loading = true;
+        paged->tile_slots[tile] = slot;
+
+        // The read goes without the lock, so threads sampling other tiles
+        // of the shard don't wait on the disk.
+        pthread_mutex_unlock(&shard->lock);
+
+        bool read = read_tile(shard, paged, tile, slot);
+
+        pthread_mutex_lock(&shard->lock);
+
+        if(!read){
+
+            shard->read_errors++;
+        }
+
+        shard->slots[slot].loading = false;
+        pthread_cond_broadcast(&shard->tile_loaded);
+    }
+
+    shard->slots[slot].referenced = true;
+
+    uint8_t *texel = &shard->texels[(size_t) slot * TILE_BYTES +
+                                    ((row % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + col % TEXTURE_TILE_SIZE) * 3];
+
+    color[0] = texel[0];
+    color[1] = texel[1];
+    color[2] = texel[2];
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+bool texture_pager_read(paged_texture *paged, size_t offset, size_t length, uint8_t *rgb){
+
+    return pread(fileno(paged->source), rgb, length, paged->data_offset + (off_t) offset) == (ssize_t) length;
+}
+
+bool parse_memory_size(const char *text, size_t *bytes){
+
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+    int shift = 20;
+
+    if(end == text || text[0] == '-'){
+
+        return false;
+    }
+
+    if(*end == 'K' || *end == 'k'){
+
+        shift = 10;
+        end++;
+
+    } else if(*end == 'M' || *end == 'm'){
+
+        end++;
+
+    } else if(*end == 'G' || *end == 'g'){
+
+        shift = 30;
+        end++;
+    }
+
+    if(*end != '\0' || size == 0 || size > (SIZE_MAX >> shift)){
+
+        return false;
+    }
+
+    *bytes = (size_t) size << shift;
+
+    return true;
+}
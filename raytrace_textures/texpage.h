@@ -0,0 +1,44 @@
+#ifndef TEXPAGE_H
+#define TEXPAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rt.h"
+
+// Image textures kept partly in memory. Each texture is split into square
+// tiles that are read from disk the first time a render samples them, and
+// every texture opened through a pager shares its budget of tile slots.
+// P6 files are read in place; a P3 file is converted once, when it is
+// opened, into a raw sidecar file that tiles are then read from. Textures
+// are shared by every scene that opens the same file, as with
+// rt_texture_cache.
+
+// Texels along each side of a tile.
+#define TEXTURE_TILE_SIZE 64
+
+typedef struct paged_texture paged_texture;
+
+// Opens filename for paging and gets its size, without reading any tiles.
+rt_status texture_pager_open(rt_texture_pager *pager, const char *filename, int *width, int *height,
+                             paged_texture **paged, rt_error *error);
+
+// Returns a texture from texture_pager_open(), dropping its tiles once no
+// scene uses it. NULL is ignored.
+void texture_pager_close(rt_texture_pager *pager, paged_texture *paged);
+
+// Writes the texel at row, col of paged to color, 0 to 255 per channel,
+// reading its tile if it isn't in memory. Safe to call from any number of
+// render threads.
+void texture_pager_texel(paged_texture *paged, int row, int col, float *color);
+
+// Reads length bytes of the texels of paged, row after row, starting
+// offset bytes into the first row, straight from disk without going
+// through the tiles. Returns false if the read fails.
+bool texture_pager_read(paged_texture *paged, size_t offset, size_t length, uint8_t *rgb);
+
+// Parses a memory size like "512M" or "2G" into bytes. K, M and G are
+// powers of 1024; a number without one is in MB.
+bool parse_memory_size(const char *text, size_t *bytes);
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "stats.h"
+
+bool trace_init(trace_log *log, int num_render_threads){
+
+    log->num_buffers = num_render_threads + 1;
+    log->buffers = calloc(log->num_buffers, sizeof(trace_buffer));
+    log->origin_ms = stats_now_ms();
+
+    if(log->buffers == NULL){
+
+        log->num_buffers = 0;
+
+        return false;
+    }
+
+    return true;
+}
+
+void trace_free(trace_log *log){
+
+    for(int buffer_index = 0; buffer_index < log->num_buffers; buffer_index++){
+
+        free(log->buffers[buffer_index].events);
+    }
+
+    free(log->buffers);
+}
+
+trace_buffer *trace_buffer_for(trace_log *log, int buffer_index){
+
+    if(log == NULL || buffer_index >= log->num_buffers){
+
+        return NULL;
+    }
+
+    return &log->buffers[buffer_index];
+}
+
+// Cuts args, which didn't fit, back to the last field that did, so the
+// event stays valid JSON. Commas inside strings don't count.
+void trim_to_field(char *args){
+
+    bool in_string = false;
+    bool escaped = false;
+    int last_field_end = 0;
+
+    for(int i = 0; args[i] != '\0'; i++){
+
+        if(escaped){
+
+            escaped = false;
+
+        } else if(in_string && args[i] == '\\'){
+
+            escaped = true;
+
+        } else if(args[i] == '"'){
+
+            in_string = !in_string;
+
+        } else if(!in_string && args[i] == ','){
+
+            last_field_end = i;
+        }
+    }
+
+    args[last_field_end] = '\0';
+}
+
+void trace_event_end(trace_buffer *buffer, const char *name, double start_ms,
+                     const char *args_format, ...){
+
+    if(buffer == NULL){
+
+        return;
+    }
+
+    double end_ms = stats_now_ms();
+
+    if(buffer->num_events == buffer->capacity){
+
+        int new_capacity = buffer->capacity == 0 ? 256 : buffer->capacity * 2;
+        trace_event *new_events = realloc(buffer->events, sizeof(trace_event) * new_capacity);
+
+        // Losing an event is better than losing the render.
+        if(new_events == NULL){
+
+            return;
+        }
+
+        buffer->events = new_events;
+        buffer->capacity = new_capacity;
+    }
+
+    trace_event *event = &buffer->events[buffer->num_events];
+
+    event->name = name;
+    event->start_ms = start_ms;
+    event->duration_ms = end_ms - start_ms;
+    event->args[0] = '\0';
+
+    if(args_format != NULL){
+
+        va_list args;
+        va_start(args, args_format);
+        int length = vsnprintf(event->args, sizeof(event->args), args_format, args);
+        va_end(args);
+
+        if(length >= (int) sizeof(event->args)){
+
+            trim_to_field(event->args);
+        }
+    }
+
+    buffer->num_events++;
+}
+
+void trace_escape(char *dst, size_t size, const char *text){
+
+    size_t length = 0;
+
+    for(const unsigned char *c = (const unsigned char *) text; *c != '\0'; c++){
+
+        char escape[8];
+
+        if(*c == '"' || *c == '\\'){
+
+            snprintf(escape, sizeof(escape), "\\%c", *c);
+
+        } else if(*c < 0x20){
+
+            snprintf(escape, sizeof(escape), "\\u%04x", *c);
+
+        } else {
+
+            escape[0] = *c;
+            escape[1] = '\0';
+        }
+
+        size_t escape_length = strlen(escape);
+
+        if(length + escape_length >= size){
+
+            // Don't leave the start of a UTF-8 character without its end.
+            size_t start = length;
+
+            while(start > 0 && ((unsigned char) dst[start - 1] & 0xC0) == 0x80){
+
+                start--;
+            }
+
+            if(start > 0 && (unsigned char) dst[start - 1] >= 0xC0){
+
+                unsigned char lead = dst[start - 1];
+                size_t expected = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+
+                if(length - (start - 1) < expected){
+
+                    length = start - 1;
+                }
+            }
+
+            break;
+        }
+
+        memcpy(&dst[length], escape, escape_length);
+        length += escape_length;
+    }
+
+    if(size > 0){
+
+        dst[length] = '\0';
+    }
+}
+
+void write_trace_json(FILE *fp, trace_log *log){
+
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    // Name the tracks so Perfetto shows "main" and "render N" instead of ids.
+    for(int buffer_index = 0; buffer_index < log->num_buffers; buffer_index++){
+
+        if(buffer_index == 0){
+
+            fprintf(fp, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+                    "\"args\": {\"name\": \"main\"}}");
+
+        } else {
+
+            fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                    "\"args\": {\"name\": \"render %d\"}}", buffer_index, buffer_index - 1);
+        }
+    }
+
+    for(int buffer_index = 0; buffer_index < log->num_buffers; buffer_index++){
+
+        trace_buffer *buffer = &log->buffers[buffer_index];
+
+        for(int event_index = 0; event_index < buffer->num_events; event_index++){
+
+            trace_event *event = &buffer->events[event_index];
+
+            // Chrome trace timestamps are in microseconds.
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {%s}}", event->name, buffer_index,
+                    (event->start_ms - log->origin_ms) * 1e3, event->duration_ms * 1e3, event->args);
+        }
+    }
+
+    fprintf(fp, "\n]}\n");
+}
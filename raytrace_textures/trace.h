@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Timeline of a run in the Chrome trace event format, viewable in Perfetto
+// or chrome://tracing. Every thread records into its own buffer so no
+// locking is needed; the buffers are only read when the trace is written.
+
+#define TRACE_ARGS_SIZE 256
+
+typedef struct {
+
+    const char *name;
+
+    // Body of the event's JSON "args" object, e.g. "\"x0\": 0, \"y0\": 32".
+    // Fields that don't fit are dropped whole.
+    char args[TRACE_ARGS_SIZE];
+
+    double start_ms;
+    double duration_ms;
+
+} trace_event;
+
+typedef struct {
+
+    trace_event *events;
+    int num_events;
+    int capacity;
+
+} trace_buffer;
+
+// Buffer 0 belongs to the main thread, buffer i + 1 to render worker i.
+typedef struct {
+
+    trace_buffer *buffers;
+    int num_buffers;
+    double origin_ms;
+
+} trace_log;
+
+// Returns false if memory runs out; the log is then empty but can still be
+// passed to the other calls.
+bool trace_init(trace_log *log, int num_render_threads);
+
+void trace_free(trace_log *log);
+
+// Returns the buffer for the given owner, or NULL when log is NULL so
+// callers can pass the result straight to trace_event_end().
+trace_buffer *trace_buffer_for(trace_log *log, int buffer_index);
+
+// Records an event that started at start_ms (from stats_now_ms()) and ends
+// now. Does nothing when buffer is NULL, and drops the event if memory runs
+// out. args_format may be NULL.
+void trace_event_end(trace_buffer *buffer, const char *name, double start_ms,
+                     const char *args_format, ...);
+
+// Writes text into dst, of size bytes, as the inside of a JSON string for
+// an args_format "%s". Quotes, backslashes and control characters are
+// escaped, and text that doesn't fit is cut before an escape or UTF-8
+// character rather than through it.
+void trace_escape(char *dst, size_t size, const char *text);
+
+void write_trace_json(FILE *fp, trace_log *log);
+
+#endif
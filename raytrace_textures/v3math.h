@@ -1,30 +1,105 @@
+#ifndef V3MATH_H
+#define V3MATH_H
+
 #include <stdio.h>
 #include <math.h>
 #include <stdbool.h>
 #include <assert.h>
 
-void v3_from_points(float *dst, float *a, float *b);
+#include "vec3.h"
+
+// The original float* interface, kept as inline wrappers around vec3.h so
+// existing callers inline across translation units. dst may alias a or b.
+
+// Forms the vector between the heads of vectors a and b.
+// head - tail
+static inline void v3_from_points(float *dst, float *a, float *b){
+
+    vec3_store(dst, vec3_sub(vec3_load(b), vec3_load(a)));
+}
+
+static inline void v3_add(float *dst, float *a, float *b){
+
+    vec3_store(dst, vec3_add(vec3_load(a), vec3_load(b)));
+}
+
+static inline void v3_subtract(float *dst, float *a, float *b){
+
+    vec3_store(dst, vec3_sub(vec3_load(a), vec3_load(b)));
+}
+
+// Dot product formula --> a→b=a1b1+a2b2+a3b3
+static inline float v3_dot_product(float *a, float *b){
+
+    return vec3_dot(vec3_load(a), vec3_load(b));
+}
+
+static inline void v3_cross_product(float *dst, float *a, float *b){
+
+    vec3_store(dst, vec3_cross(vec3_load(a), vec3_load(b)));
+}
+
+// Ex <2,3,4> scaled by s=2 --> <4,6,8>
+static inline void v3_scale(float *dst, float s){
+
+    vec3_store(dst, vec3_scale(vec3_load(dst), s));
+}
+
+static inline float v3_length(float *a){
+
+    return vec3_length(vec3_load(a));
+}
+
+static inline void v3_normalize(float *dst, float *a){
+
+    vec3_store(dst, vec3_normalize(vec3_load(a)));
+}
+
+// Partially calculate the angle between a and b; skipping inverse cosine.
+static inline float v3_angle_quick(float *a, float *b){
+
+    vec3 va = vec3_load(a);
+    vec3 vb = vec3_load(b);
+
+    float angle = vec3_length(va) * vec3_length(vb);
+
+    // Check to make sure neither vector is 0 to prevent dividing by 0.
+    assert(angle != 0);
+
+    return vec3_dot(va, vb) / angle;
+}
+
+// Calculate the angle between a and b
+static inline float v3_angle(float *a, float *b){
 
-void v3_add(float *dst,float *a, float *b);
+    return acos(v3_angle_quick(a, b));
+}
 
-void v3_subtract(float *dst,float *a, float *b);
+// Reflects v about n; n does not need to be unit length.
+static inline void v3_reflect(float *dst, float *v, float *n){
 
-float v3_dot_product(float *a, float *b);
+    vec3_store(dst, vec3_reflect(vec3_load(v), vec3_normalize(vec3_load(n))));
+}
 
-void v3_cross_product(float *dst,float *a, float *b);
+// Reflects v about n, skipping the normalization when n is already unit length.
+static inline void v3_reflect_unit(float *dst, float *v, float *n){
 
-float v3_angle(float *a, float *b);
+    vec3_store(dst, vec3_reflect(vec3_load(v), vec3_load(n)));
+}
 
-float v3_angle_quick(float *a, float *b);
+static inline bool v3_equals(float *a, float *b, float tolerance){
 
-void v3_reflect(float *dst, float *v, float *n);
+    return vec3_equals(vec3_load(a), vec3_load(b), tolerance);
+}
 
-float v3_length(float *a);
+static inline bool float_equals(float a, float b, float tolerance){
 
-void v3_scale(float *dst,float s);
+    if(a - b > tolerance || b - a > tolerance){
 
-void v3_normalize(float *dst, float *a);
+        return false;
+    }
 
-bool v3_equals(float *a, float *b, float tolerance);
+    return true;
+}
 
-bool float_equals(float a, float b, float tolerance);
+#endif
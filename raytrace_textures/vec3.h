@@ -0,0 +1,231 @@
+#ifndef VEC3_H
+#define VEC3_H
+
+#include <math.h>
+#include <stdbool.h>
+
+// Inlinable 3 and 4 component vector math. On x86 each vector lives in one
+// SSE register; the w lane of a vec3 is carried along as 0 and ignored.
+// Everything else falls back to plain float arithmetic with the same results
+// up to rounding. Defining VEC3_NO_SSE picks the plain path on x86 too,
+// which is how vec3_test checks the two against each other.
+
+#if !defined(VEC3_NO_SSE) && (defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP))
+#define VEC3_SSE 1
+#include <xmmintrin.h>
+#endif
+
+typedef union {
+
+#ifdef VEC3_SSE
+    __m128 m;
+#endif
+    float f[4];
+
+} vec4;
+
+typedef vec4 vec3;
+
+
+static inline vec4 vec4_make(float x, float y, float z, float w){
+
+    vec4 r;
+
+#ifdef VEC3_SSE
+    r.m = _mm_setr_ps(x, y, z, w);
+#else
+    r.f[0] = x;
+    r.f[1] = y;
+    r.f[2] = z;
+    r.f[3] = w;
+#endif
+
+    return r;
+}
+
+static inline vec3 vec3_make(float x, float y, float z){
+
+    return vec4_make(x, y, z, 0);
+}
+
+static inline vec3 vec3_splat(float s){
+
+    return vec4_make(s, s, s, 0);
+}
+
+// Loads the three floats at a; a does not need to be aligned or padded.
+static inline vec3 vec3_load(const float *a){
+
+    return vec4_make(a[0], a[1], a[2], 0);
+}
+
+static inline void vec3_store(float *dst, vec3 a){
+
+    dst[0] = a.f[0];
+    dst[1] = a.f[1];
+    dst[2] = a.f[2];
+}
+
+
+static inline vec4 vec4_add(vec4 a, vec4 b){
+
+#ifdef VEC3_SSE
+    a.m = _mm_add_ps(a.m, b.m);
+#else
+    for(int i = 0; i < 4; i++){
+
+        a.f[i] = a.f[i] + b.f[i];
+    }
+#endif
+
+    return a;
+}
+
+static inline vec4 vec4_sub(vec4 a, vec4 b){
+
+#ifdef VEC3_SSE
+    a.m = _mm_sub_ps(a.m, b.m);
+#else
+    for(int i = 0; i < 4; i++){
+
+        a.f[i] = a.f[i] - b.f[i];
+    }
+#endif
+
+    return a;
+}
+
+// Component-wise product.
+static inline vec4 vec4_mul(vec4 a, vec4 b){
+
+#ifdef VEC3_SSE
+    a.m = _mm_mul_ps(a.m, b.m);
+#else
+    for(int i = 0; i < 4; i++){
+
+        a.f[i] = a.f[i] * b.f[i];
+    }
+#endif
+
+    return a;
+}
+
+static inline vec4 vec4_scale(vec4 a, float s){
+
+#ifdef VEC3_SSE
+    a.m = _mm_mul_ps(a.m, _mm_set1_ps(s));
+#else
+    for(int i = 0; i < 4; i++){
+
+        a.f[i] = a.f[i] * s;
+    }
+#endif
+
+    return a;
+}
+
+// a * s + b in one call.
+static inline vec4 vec4_scale_add(vec4 a, float s, vec4 b){
+
+#ifdef VEC3_SSE
+    a.m = _mm_add_ps(_mm_mul_ps(a.m, _mm_set1_ps(s)), b.m);
+#else
+    for(int i = 0; i < 4; i++){
+
+        a.f[i] = a.f[i] * s + b.f[i];
+    }
+#endif
+
+    return a;
+}
+
+#define vec3_add vec4_add
+#define vec3_sub vec4_sub
+#define vec3_mul vec4_mul
+#define vec3_scale vec4_scale
+#define vec3_scale_add vec4_scale_add
+
+
+static inline float vec4_dot(vec4 a, vec4 b){
+
+#ifdef VEC3_SSE
+    __m128 prod = _mm_mul_ps(a.m, b.m);
+    __m128 swapped = _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(prod, swapped);
+    swapped = _mm_movehl_ps(swapped, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, swapped));
+#else
+    return a.f[0] * b.f[0] + a.f[1] * b.f[1] + a.f[2] * b.f[2] + a.f[3] * b.f[3];
+#endif
+}
+
+// Relies on the w lanes being 0, which every vec3 constructor guarantees.
+static inline float vec3_dot(vec3 a, vec3 b){
+
+#ifdef VEC3_SSE
+    return vec4_dot(a, b);
+#else
+    return a.f[0] * b.f[0] + a.f[1] * b.f[1] + a.f[2] * b.f[2];
+#endif
+}
+
+static inline vec3 vec3_cross(vec3 a, vec3 b){
+
+#ifdef VEC3_SSE
+    // (a.yzx * b.zxy) - (a.zxy * b.yzx), keeping w at 0.
+    __m128 a_yzx = _mm_shuffle_ps(a.m, a.m, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b.m, b.m, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a.m, b_yzx), _mm_mul_ps(a_yzx, b.m));
+    a.m = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    return a;
+#else
+    return vec3_make(a.f[1] * b.f[2] - a.f[2] * b.f[1],
+                     a.f[2] * b.f[0] - a.f[0] * b.f[2],
+                     a.f[0] * b.f[1] - a.f[1] * b.f[0]);
+#endif
+}
+
+static inline float vec3_length(vec3 a){
+
+    return sqrtf(vec3_dot(a, a));
+}
+
+// 1 / sqrt(x) from the hardware estimate plus one Newton-Raphson step,
+// which brings the estimate's ~12 bits to within 2 ulp of 1 / sqrtf(x).
+static inline float vec3_rsqrt(float x){
+
+#ifdef VEC3_SSE
+    float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    return y * (1.5f - 0.5f * x * y * y);
+#else
+    return 1 / sqrtf(x);
+#endif
+}
+
+// The zero vector has no direction; the result is then non-finite, as the
+// divide it replaces would have been.
+static inline vec3 vec3_normalize(vec3 a){
+
+    return vec3_scale(a, vec3_rsqrt(vec3_dot(a, a)));
+}
+
+// Reflects v about n, which must already be unit length.
+static inline vec3 vec3_reflect(vec3 v, vec3 n){
+
+    return vec3_scale_add(n, -2 * vec3_dot(n, v), v);
+}
+
+static inline bool vec3_equals(vec3 a, vec3 b, float tolerance){
+
+    for(int i = 0; i < 3; i++){
+
+        if(a.f[i] - b.f[i] > tolerance || b.f[i] - a.f[i] > tolerance){
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif
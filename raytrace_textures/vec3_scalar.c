@@ -0,0 +1,60 @@
+#include "vec3_scalar.h"
+#include "vec3.h"
+
+// Built with VEC3_NO_SSE, so every call below runs the plain float path of
+// vec3.h whatever the rest of the program was compiled for.
+
+void scalar_vec3_add(float *dst, const float *a, const float *b){
+
+    vec3_store(dst, vec3_add(vec3_load(a), vec3_load(b)));
+}
+
+void scalar_vec3_sub(float *dst, const float *a, const float *b){
+
+    vec3_store(dst, vec3_sub(vec3_load(a), vec3_load(b)));
+}
+
+void scalar_vec3_mul(float *dst, const float *a, const float *b){
+
+    vec3_store(dst, vec3_mul(vec3_load(a), vec3_load(b)));
+}
+
+void scalar_vec3_scale(float *dst, const float *a, float s){
+
+    vec3_store(dst, vec3_scale(vec3_load(a), s));
+}
+
+void scalar_vec3_scale_add(float *dst, const float *a, float s, const float *b){
+
+    vec3_store(dst, vec3_scale_add(vec3_load(a), s, vec3_load(b)));
+}
+
+float scalar_vec3_dot(const float *a, const float *b){
+
+    return vec3_dot(vec3_load(a), vec3_load(b));
+}
+
+float scalar_vec4_dot(const float *a, const float *b){
+
+    return vec4_dot(vec4_make(a[0], a[1], a[2], a[3]), vec4_make(b[0], b[1], b[2], b[3]));
+}
+
+void scalar_vec3_cross(float *dst, const float *a, const float *b){
+
+    vec3_store(dst, vec3_cross(vec3_load(a), vec3_load(b)));
+}
+
+float scalar_vec3_length(const float *a){
+
+    return vec3_length(vec3_load(a));
+}
+
+void scalar_vec3_normalize(float *dst, const float *a){
+
+    vec3_store(dst, vec3_normalize(vec3_load(a)));
+}
+
+void scalar_vec3_reflect(float *dst, const float *v, const float *n){
+
+    vec3_store(dst, vec3_reflect(vec3_load(v), vec3_load(n)));
+}
@@ -0,0 +1,19 @@
+#ifndef VEC3_SCALAR_H
+#define VEC3_SCALAR_H
+
+// The vec3.h operations as built without SSE, on plain float arrays so they
+// can be called from code built with it. Only vec3_test uses these.
+
+void scalar_vec3_add(float *dst, const float *a, const float *b);
+void scalar_vec3_sub(float *dst, const float *a, const float *b);
+void scalar_vec3_mul(float *dst, const float *a, const float *b);
+void scalar_vec3_scale(float *dst, const float *a, float s);
+void scalar_vec3_scale_add(float *dst, const float *a, float s, const float *b);
+float scalar_vec3_dot(const float *a, const float *b);
+float scalar_vec4_dot(const float *a, const float *b);
+void scalar_vec3_cross(float *dst, const float *a, const float *b);
+float scalar_vec3_length(const float *a);
+void scalar_vec3_normalize(float *dst, const float *a);
+void scalar_vec3_reflect(float *dst, const float *v, const float *n);
+
+#endif
@@ -0,0 +1,448 @@
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "v3math.h"
+#include "vec3.h"
+#include "vec3_scalar.h"
+
+// Checks that vec3.h gives the same results on its SSE path as on its plain
+// float path. Operations that do the same float arithmetic in the same order
+// must match exactly; dot products sum in a different order and the inverse
+// square root starts from an estimate, so those only have to agree to a few
+// ulp. Then holds the v3_* wrappers in v3math.h to the v3math.c they
+// replaced: exact where the arithmetic is the same, and within a few
+// FLT_EPSILON of the right scale where the inverse square root or the
+// order of a sum changed. Prints each mismatch and exits with 1 if there
+// were any.
+
+#define TEST_INPUTS 100000
+
+int test_failures = 0;
+
+uint32_t test_random_state = 12345;
+
+// Uniform in [-1, 1) times a power of ten from 1e-3 to 1e3.
+float test_random_float(){
+
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 17;
+    test_random_state ^= test_random_state << 5;
+
+    float unit = (test_random_state & 0xFFFFFF) / (float) 0x800000 - 1;
+    int power = (int) (test_random_state >> 24) % 7 - 3;
+
+    return unit * powf(10, power);
+}
+
+void test_random_vector(float *a){
+
+    a[0] = test_random_float();
+    a[1] = test_random_float();
+    a[2] = test_random_float();
+}
+
+void check_exact(const char *name, const float *expected, vec3 actual){
+
+    for(int i = 0; i < 3; i++){
+
+        if(expected[i] != actual.f[i]){
+
+            printf("FAIL %s: component %d is %.9g with SSE, %.9g without\n", name, i, actual.f[i], expected[i]);
+            test_failures++;
+            return;
+        }
+    }
+}
+
+void check_close(const char *name, float expected, float actual, float tolerance){
+
+    if(fabsf(expected - actual) > tolerance){
+
+        printf("FAIL %s: %.9g with SSE, %.9g without\n", name, actual, expected);
+        test_failures++;
+    }
+}
+
+// Tolerance for a sum of products: a few ulp of the largest partial sum.
+float dot_tolerance(const float *a, const float *b, int n){
+
+    float magnitude = 0;
+
+    for(int i = 0; i < n; i++){
+
+        magnitude = magnitude + fabsf(a[i] * b[i]);
+    }
+
+    return 4 * FLT_EPSILON * magnitude;
+}
+
+void test_random_inputs(){
+
+    for(int input = 0; input < TEST_INPUTS; input++){
+
+        float a[4], b[4], expected[3];
+        float s = test_random_float();
+
+        test_random_vector(a);
+        test_random_vector(b);
+        a[3] = test_random_float();
+        b[3] = test_random_float();
+
+        vec3 va = vec3_load(a);
+        vec3 vb = vec3_load(b);
+
+        scalar_vec3_add(expected, a, b);
+        check_exact("vec3_add", expected, vec3_add(va, vb));
+
+        scalar_vec3_sub(expected, a, b);
+        check_exact("vec3_sub", expected, vec3_sub(va, vb));
+
+        scalar_vec3_mul(expected, a, b);
+        check_exact("vec3_mul", expected, vec3_mul(va, vb));
+
+        scalar_vec3_scale(expected, a, s);
+        check_exact("vec3_scale", expected, vec3_scale(va, s));
+
+        scalar_vec3_scale_add(expected, a, s, b);
+        check_exact("vec3_scale_add", expected, vec3_scale_add(va, s, vb));
+
+        scalar_vec3_cross(expected, a, b);
+        check_exact("vec3_cross", expected, vec3_cross(va, vb));
+
+        check_close("vec3_dot", scalar_vec3_dot(a, b), vec3_dot(va, vb), dot_tolerance(a, b, 3));
+
+        check_close("vec4_dot", scalar_vec4_dot(a, b),
+                    vec4_dot(vec4_make(a[0], a[1], a[2], a[3]), vec4_make(b[0], b[1], b[2], b[3])),
+                    dot_tolerance(a, b, 4));
+
+        float length = scalar_vec3_length(a);
+        check_close("vec3_length", length, vec3_length(va), 4 * FLT_EPSILON * length);
+
+        // Unit vectors, so a few ulp of 1 covers every component.
+        scalar_vec3_normalize(expected, a);
+        vec3 normalized = vec3_normalize(va);
+
+        for(int i = 0; i < 3; i++){
+
+            check_close("vec3_normalize", expected[i], normalized.f[i], 4 * FLT_EPSILON);
+        }
+
+        // Reflect about the unit normal both paths agree on, so only the
+        // dot product inside differs.
+        float n[3] = {expected[0], expected[1], expected[2]};
+        scalar_vec3_reflect(expected, b, n);
+        vec3 reflected = vec3_reflect(vb, vec3_load(n));
+
+        for(int i = 0; i < 3; i++){
+
+            check_close("vec3_reflect", expected[i], reflected.f[i],
+                        3 * dot_tolerance(n, b, 3) + 4 * FLT_EPSILON * fabsf(b[i]));
+        }
+    }
+}
+
+// The v3math.c these functions replaced, copied from before vec3.h, so
+// the v3_* wrappers in v3math.h can be held to what callers used to get.
+
+void reference_v3_from_points(float *dst, float *a, float *b){
+
+    for(int i = 0; i < 3; i++){
+
+        dst[i] = b[i] - a[i];
+    }
+}
+
+void reference_v3_add(float *dst, float *a, float *b){
+
+    for(int i = 0; i < 3; i++){
+
+        dst[i] = a[i] + b[i];
+    }
+}
+
+void reference_v3_subtract(float *dst, float *a, float *b){
+
+    for(int i = 0; i < 3; i++){
+
+        dst[i] = a[i] - b[i];
+    }
+}
+
+float reference_v3_dot_product(float *a, float *b){
+
+    float dot_product = 0;
+
+    for(int i = 0; i < 3; i++){
+
+        dot_product += a[i] * b[i];
+    }
+
+    return dot_product;
+}
+
+void reference_v3_cross_product(float *dst, float *a, float *b){
+
+    dst[0] = (a[1] * b[2]) - (a[2] * b[1]);
+    dst[1] = -(a[0] * b[2]) + (a[2] * b[0]);
+    dst[2] = (a[0] * b[1]) - (a[1] * b[0]);
+}
+
+void reference_v3_scale(float *dst, float s){
+
+    for(int i = 0; i < 3; i++){
+
+        dst[i] = dst[i] * s;
+    }
+}
+
+float reference_v3_length(float *a){
+
+    return sqrtf((a[0] * a[0]) + (a[1] * a[1]) + (a[2] * a[2]));
+}
+
+void reference_v3_normalize(float *dst, float *a){
+
+    float mag_a = reference_v3_length(a);
+
+    for(int i = 0; i < 3; i++){
+
+        dst[i] = a[i] / mag_a;
+    }
+}
+
+float reference_v3_angle_quick(float *a, float *b){
+
+    float dot = reference_v3_dot_product(a, b);
+
+    return dot / (reference_v3_length(a) * reference_v3_length(b));
+}
+
+float reference_v3_angle(float *a, float *b){
+
+    return acos(reference_v3_angle_quick(a, b));
+}
+
+void reference_v3_reflect(float *dst, float *v, float *n){
+
+    float temp_vector[] = {0.0, 0.0, 0.0};
+
+    reference_v3_normalize(temp_vector, n);
+
+    float scalar = 2.0 * reference_v3_dot_product(temp_vector, v);
+
+    reference_v3_scale(temp_vector, scalar);
+    reference_v3_subtract(dst, v, temp_vector);
+}
+
+bool reference_v3_equals(float *a, float *b, float tolerance){
+
+    for(int i = 0; i < 3; i++){
+
+        if(a[i] - b[i] > tolerance || b[i] - a[i] > tolerance){
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The largest error seen per wrapper, in units of FLT_EPSILON times the
+// scale it was measured against.
+float worst_error[16];
+const char *worst_name[16];
+int num_worst = 0;
+
+// Fails if actual is further than max_eps * FLT_EPSILON * scale from the
+// old result expected.
+void check_reference(const char *name, float expected, float actual, float scale, float max_eps){
+
+    float error = fabsf(expected - actual) / (FLT_EPSILON * scale);
+    int slot = 0;
+
+    while(slot < num_worst && worst_name[slot] != name){
+
+        slot++;
+    }
+
+    if(slot == num_worst){
+
+        worst_name[slot] = name;
+        worst_error[slot] = 0;
+        num_worst++;
+    }
+
+    worst_error[slot] = fmaxf(worst_error[slot], error);
+
+    if(!(error <= max_eps)){
+
+        printf("FAIL %s: %.9g now, %.9g in v3math.c (%.1f eps of %.9g)\n", name, actual, expected, error, scale);
+        test_failures++;
+    }
+}
+
+void check_reference_vector(const char *name, const float *expected, const float *actual, float scale,
+                            float max_eps){
+
+    for(int i = 0; i < 3; i++){
+
+        check_reference(name, expected[i], actual[i], scale, max_eps);
+    }
+}
+
+void test_v3math(){
+
+    for(int input = 0; input < TEST_INPUTS; input++){
+
+        float a[3], b[3], expected[3], actual[3];
+        float s = test_random_float();
+
+        test_random_vector(a);
+        test_random_vector(b);
+
+        // What changes only in the order of exact operations must match
+        // exactly.
+        reference_v3_from_points(expected, a, b);
+        v3_from_points(actual, a, b);
+        check_reference_vector("v3_from_points", expected, actual, 1, 0);
+
+        reference_v3_add(expected, a, b);
+        v3_add(actual, a, b);
+        check_reference_vector("v3_add", expected, actual, 1, 0);
+
+        reference_v3_subtract(expected, a, b);
+        v3_subtract(actual, a, b);
+        check_reference_vector("v3_subtract", expected, actual, 1, 0);
+
+        reference_v3_cross_product(expected, a, b);
+        v3_cross_product(actual, a, b);
+        check_reference_vector("v3_cross_product", expected, actual, 1, 0);
+
+        memcpy(expected, a, sizeof(expected));
+        memcpy(actual, a, sizeof(actual));
+        reference_v3_scale(expected, s);
+        v3_scale(actual, s);
+        check_reference_vector("v3_scale", expected, actual, 1, 0);
+
+        float tolerance = fabsf(s);
+
+        if(reference_v3_equals(a, b, tolerance) != v3_equals(a, b, tolerance)){
+
+            printf("FAIL v3_equals: differs from v3math.c at tolerance %.9g\n", tolerance);
+            test_failures++;
+        }
+
+        // Sums may be added in another order: measured against the sum
+        // of the magnitudes of the products.
+        float magnitude = fabsf(a[0] * b[0]) + fabsf(a[1] * b[1]) + fabsf(a[2] * b[2]);
+        check_reference("v3_dot_product", reference_v3_dot_product(a, b), v3_dot_product(a, b), magnitude, 2);
+
+        float length = reference_v3_length(a);
+        check_reference("v3_length", length, v3_length(a), length, 2);
+
+        // Unit vectors, so against 1; the inverse square root is where
+        // the error comes from.
+        reference_v3_normalize(expected, a);
+        v3_normalize(actual, a);
+        check_reference_vector("v3_normalize", expected, actual, 1, 4);
+
+        float cosine = reference_v3_angle_quick(a, b);
+        check_reference("v3_angle_quick", cosine, v3_angle_quick(a, b), 1, 4);
+
+        // acos() stretches an error in the cosine by 1 / sin, which is
+        // largest next to 0 and pi. A cosine rounded past 1 gives NaN, old
+        // or new, so those next to it aren't compared.
+        if(fabsf(cosine) < 1 - 8 * FLT_EPSILON){
+
+            float sine = sqrtf(1 - cosine * cosine);
+            check_reference("v3_angle", reference_v3_angle(a, b), v3_angle(a, b), 1 / sine, 8);
+        }
+
+        // Reflection of b about a: the error in the normal is scaled by b.
+        float b_length = reference_v3_length(b);
+
+        reference_v3_reflect(expected, b, a);
+        v3_reflect(actual, b, a);
+        check_reference_vector("v3_reflect", expected, actual, b_length, 16);
+
+        float n[3];
+        reference_v3_normalize(n, a);
+        reference_v3_reflect(expected, b, n);
+        v3_reflect_unit(actual, b, n);
+        check_reference_vector("v3_reflect_unit", expected, actual, b_length, 16);
+    }
+
+    for(int slot = 0; slot < num_worst; slot++){
+
+        printf("%s: at most %.2f eps from v3math.c\n", worst_name[slot], worst_error[slot]);
+    }
+}
+
+void test_edge_cases(){
+
+    float zero[3] = {0, 0, 0};
+    float axes[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    float expected[3];
+
+    // The zero vector has no direction; both paths must say so rather
+    // than one of them returning a finite vector.
+    scalar_vec3_normalize(expected, zero);
+    vec3 normalized = vec3_normalize(vec3_load(zero));
+
+    for(int i = 0; i < 3; i++){
+
+        if(isfinite(expected[i]) || isfinite(normalized.f[i])){
+
+            printf("FAIL vec3_normalize of zero: component %d is %.9g with SSE, %.9g without\n",
+                   i, normalized.f[i], expected[i]);
+            test_failures++;
+        }
+    }
+
+    check_close("vec3_length of zero", scalar_vec3_length(zero), vec3_length(vec3_load(zero)), 0);
+
+    for(int axis = 0; axis < 3; axis++){
+
+        scalar_vec3_normalize(expected, axes[axis]);
+        normalized = vec3_normalize(vec3_load(axes[axis]));
+
+        for(int i = 0; i < 3; i++){
+
+            check_close("vec3_normalize of an axis", expected[i], normalized.f[i], 2 * FLT_EPSILON);
+        }
+
+        // The w lane must stay 0 or vec3_dot() would pick it up.
+        vec3 crossed = vec3_cross(vec3_load(axes[axis]), vec3_load(axes[(axis + 1) % 3]));
+        scalar_vec3_cross(expected, axes[axis], axes[(axis + 1) % 3]);
+        check_exact("vec3_cross of axes", expected, crossed);
+
+        if(crossed.f[3] != 0){
+
+            printf("FAIL vec3_cross: w lane is %.9g\n", crossed.f[3]);
+            test_failures++;
+        }
+    }
+}
+
+int main(){
+
+#ifndef VEC3_SSE
+    printf("vec3.h has no SSE path on this target; comparing the plain path with itself\n");
+#endif
+
+    test_random_inputs();
+    test_v3math();
+    test_edge_cases();
+
+    if(test_failures > 0){
+
+        printf("vec3_test: %d failures\n", test_failures);
+        return 1;
+    }
+
+    printf("vec3_test: ok\n");
+    return 0;
+}